@@ -0,0 +1,150 @@
+#include "blkdev.h"
+#include "emu.h"
+#include <cassert>
+#include <cstring>
+#include <fcntl.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+struct BlkDev {
+    int fd;
+    uint8_t *map;
+    uint64_t size;          // bytes in the backing file
+    uint32_t sector;        // BLK_SECTOR register
+    uint64_t window;        // byte offset of the mapped window
+    uint32_t status;
+};
+
+static void blk_map_file(BlkDev *blk) {
+    // private mapping: guest writes never reach the file
+    blk->map = (uint8_t *)mmap(NULL, blk->size, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_NORESERVE, blk->fd, 0);
+    assert(blk->map != MAP_FAILED);
+}
+
+static uint32_t blk_nsectors(BlkDev *blk) {
+    return (blk->size + BLK_SECTOR_SIZE - 1) / BLK_SECTOR_SIZE;
+}
+
+static void blk_command(BlkDev *blk, uint32_t cmd) {
+    switch (cmd) {
+    case BLK_CMD_MAP:
+        if (blk->sector < blk_nsectors(blk)) {
+            blk->window = (uint64_t)blk->sector * BLK_SECTOR_SIZE;
+            blk->status = BLK_STATUS_OK;
+        }
+        else {
+            blk->status = BLK_STATUS_ERR;
+        }
+        break;
+    default:
+        blk->status = BLK_STATUS_ERR;
+        break;
+    }
+}
+
+static uint32_t blk_read(void *opaque, uint32_t offset) {
+    BlkDev *blk = (BlkDev *)opaque;
+    if (offset >= BLK_REG_SIZE) {
+        // zero-copy window, bytes past the end of file read as zero
+        uint64_t pos = blk->window + offset - BLK_REG_SIZE;
+        if (pos + 4 <= blk->size) {
+            return *(uint32_t *)(blk->map + pos);
+        }
+        uint32_t data = 0;
+        if (pos < blk->size) {
+            memcpy(&data, blk->map + pos, blk->size - pos);
+        }
+        return data;
+    }
+
+    switch (offset) {
+    case BLK_SECTOR:    return blk->sector;
+    case BLK_NSECTORS:  return blk_nsectors(blk);
+    case BLK_WINDOW:    return BLK_WINDOW_SIZE;
+    case BLK_STATUS:    return blk->status;
+    default:            return 0;
+    }
+}
+
+static void blk_write(void *opaque, uint32_t offset, uint32_t data, uint32_t mask) {
+    BlkDev *blk = (BlkDev *)opaque;
+    if (offset >= BLK_REG_SIZE) {
+        uint64_t pos = blk->window + offset - BLK_REG_SIZE;
+        for (int i = 0; i < 4; i++) {
+            if ((mask >> i & 1) && pos + i < blk->size) {
+                blk->map[pos + i] = data >> (i * 8);
+            }
+        }
+        return;
+    }
+
+    switch (offset) {
+    case BLK_SECTOR:
+        blk->sector = data;
+        break;
+    case BLK_CMD:
+        blk_command(blk, data);
+        break;
+    default:
+        break;
+    }
+}
+
+static void blk_reset(void *opaque) {
+    BlkDev *blk = (BlkDev *)opaque;
+    // drop the private copy left by the previous run
+    munmap(blk->map, blk->size);
+    blk_map_file(blk);
+    blk->sector = 0;
+    blk->window = 0;
+    blk->status = BLK_STATUS_OK;
+}
+
+static void blk_free(void *opaque) {
+    BlkDev *blk = (BlkDev *)opaque;
+    munmap(blk->map, blk->size);
+    close(blk->fd);
+    delete blk;
+}
+
+void init_blkdev(const char *spec) {
+    std::string path = spec;
+    uint32_t base = BLK_BASE;
+    size_t at = path.rfind('@');
+    if (at != std::string::npos) {
+        base = strtoul(spec + at + 1, NULL, 0);
+        path.resize(at);
+    }
+
+    BlkDev *blk = new BlkDev();
+    blk->fd = open(path.c_str(), O_RDONLY);
+    if (blk->fd < 0) {
+        printf("[Error] Cannot open block image %s\n", path.c_str());
+        exit(1);
+    }
+    struct stat st;
+    fstat(blk->fd, &st);
+    blk->size = st.st_size;
+    if (blk->size == 0) {
+        printf("[Error] Block image %s is empty\n", path.c_str());
+        exit(1);
+    }
+    blk_map_file(blk);
+
+    Device dev = {};
+    strcpy(dev.name, "blk");
+    dev.base = base;
+    dev.size = BLK_REG_SIZE + BLK_WINDOW_SIZE;
+    dev.opaque = blk;
+    dev.read = blk_read;
+    dev.write = blk_write;
+    dev.reset = blk_reset;
+    dev.free = blk_free;
+    if (register_device(&dev) < 0) {
+        exit(1);
+    }
+    printf("[Info] Block image %s: %u sectors at 0x%08x\n", path.c_str(), blk_nsectors(blk), base);
+}
@@ -1,92 +1,199 @@
 #include "device.h"
 #include "emu.h"
+#include <algorithm>
 #include <cassert>
 #include <cstdint>
 #include <cstring>
 #include <memory.h>
 #include <cstdio>
 #include <cstdlib>
+#include <dlfcn.h>
+#include <string>
 #include <sys/time.h>
 
-typedef void (*call_back_func)(uint32_t offset, int operation);
-
-struct Device {
-    char name[10];
-    paddr_t device_base;
-    uintptr_t data_ptr;
-    call_back_func callback;
-};
-
-int dev_idx = 0;
-Device dev[DEV_NUM];
-
 int is_device(paddr_t addr) {
+    int dev_idx = emu->devices.dev_idx;
+    Device *dev = emu->devices.dev;
     for (int i = 0; i < dev_idx; i++) {
-        if ((addr >= dev[i].device_base) && (addr < dev[i].device_base + 16)) {
+        if ((addr >= dev[i].base) && (addr - dev[i].base < dev[i].size)) {
             return i;
         }
     }
     return -1;
 }
 
+static uint32_t replay_read(paddr_t addr) {
+    DeviceCtx *ctx = &emu->devices;
+    MmioRecord rec;
+    if (fread(&rec, sizeof(rec), 1, ctx->mmio_replay) != 1) {
+        printf("[Error] MMIO replay log ends at read of 0x%08x\n", addr);
+        emu->trap(TRAP_REPLAY_ERR, addr);
+        return 0;
+    }
+    if (rec.addr != addr) {
+        printf("[Error] MMIO replay expects read of 0x%08x, got 0x%08x\n", rec.addr, addr);
+        emu->trap(TRAP_REPLAY_ERR, addr);
+    }
+    return rec.data;
+}
+
 uint32_t device_read(paddr_t addr) {
+    DeviceCtx *ctx = &emu->devices;
+    Device *dev = ctx->dev;
+    ctx->read_byte = addr & 0x3;
+    addr &= ~0x3u;
     int idx = is_device(addr);
     if (idx == -1) {
         return 0;
     }
-    uint32_t offset = addr - dev[idx].device_base;
-    dev[idx].callback(offset, 0); // read operation
+    if (ctx->mmio_replay) {
+        return replay_read(addr);
+    }
+    if (dev[idx].read == nullptr) {
+        emu->trap(TRAP_MEM_ERR, addr);
+        return 0;
+    }
 
-    uint32_t data = *(uint32_t *)(dev[idx].data_ptr + offset);
+    uint32_t data = dev[idx].read(dev[idx].opaque, addr - dev[idx].base);
+    if (ctx->mmio_record) {
+        MmioRecord rec = {addr, data};
+        fwrite(&rec, sizeof(rec), 1, ctx->mmio_record);
+    }
     return data;
 }
 
 uint32_t device_write(paddr_t addr, uint32_t data, uint32_t mask) {
+    Device *dev = emu->devices.dev;
     int idx = is_device(addr);
     if (idx == -1) {
         return 0;
     }
-    uint32_t offset = addr - dev[idx].device_base;
+    if (dev[idx].write == nullptr) {
+        emu->trap(TRAP_MEM_ERR, addr);
+        return 0;
+    }
+
+    dev[idx].write(dev[idx].opaque, addr - dev[idx].base, data, mask);
+    return data;
+}
+
+// Only reached when some device is due, see Emulator::step()
+void device_tick(uint64_t cycles) {
+    DeviceCtx *ctx = &emu->devices;
+    uint64_t next_tick = UINT64_MAX;
+    for (int i = 0; i < ctx->tick_num; i++) {
+        Device *dev = &ctx->dev[ctx->tick_dev[i]];
+        if (cycles >= ctx->tick_due[i]) {
+            dev->tick(dev->opaque, cycles);
+            ctx->tick_due[i] = cycles + dev->tick_interval;
+        }
+        next_tick = std::min(next_tick, ctx->tick_due[i]);
+    }
+    ctx->next_tick = next_tick;
+}
 
-    uint32_t *data_ptr = (uint32_t *)(dev[idx].data_ptr + offset);
-    uint32_t real_mask = 0;
-    for (int i = 0; i < 4; i++) {
-        if (mask & 1) {
-            real_mask |= 0xff << (i * 8);
+int register_device(const Device *dev) {
+    DeviceCtx *ctx = &emu->devices;
+    if (ctx->dev_idx == DEV_NUM || dev->size == 0) {
+        printf("[Error] Cannot register device %.*s\n", DEVICE_NAME_LEN, dev->name);
+        return -1;
+    }
+    for (int i = 0; i < ctx->dev_idx; i++) {
+        Device *other = &ctx->dev[i];
+        if (dev->base < other->base + other->size && other->base < dev->base + dev->size) {
+            printf("[Error] Device %.*s overlaps %s\n", DEVICE_NAME_LEN, dev->name, other->name);
+            return -1;
         }
-        mask >>= 1;
     }
-    uint32_t real_data = *data_ptr & (~real_mask) | data & real_mask;
-    *data_ptr = real_data;
 
-    dev[idx].callback(offset, 1); // write operation
-    return real_data;
+    int idx = ctx->dev_idx++;
+    ctx->dev[idx] = *dev;
+    ctx->dev[idx].name[DEVICE_NAME_LEN - 1] = '\0';
+
+    if (dev->tick) {
+        uint64_t interval = dev->tick_interval ? dev->tick_interval : 1;
+        ctx->dev[idx].tick_interval = interval;
+        ctx->tick_dev[ctx->tick_num] = idx;
+        ctx->tick_due[ctx->tick_num] = interval;
+        ctx->tick_num++;
+        ctx->next_tick = std::min(ctx->next_tick, interval);
+    }
+    return idx;
+}
+
+static uint64_t host_get_cycles() {
+    return emu->get_cycles();
+}
+
+static void host_access_error(uint32_t addr) {
+    emu->trap(TRAP_MEM_ERR, addr);
+}
+
+static const DeviceHost device_host = {
+    DEVICE_API_VERSION,
+    register_device,
+    host_get_cycles,
+    host_access_error,
+};
+
+// spec is <path>[:<arg>]
+void load_device_plugin(const char *spec) {
+    std::string path = spec;
+    const char *arg = nullptr;
+    size_t colon = path.find(':');
+    if (colon != std::string::npos) {
+        arg = spec + colon + 1;
+        path.resize(colon);
+    }
+
+    void *handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (handle == nullptr) {
+        printf("[Error] Cannot load device %s: %s\n", path.c_str(), dlerror());
+        exit(1);
+    }
+    device_init_func init = (device_init_func)dlsym(handle, DEVICE_INIT_SYMBOL);
+    if (init == nullptr || init(&device_host, arg) != 0) {
+        printf("[Error] Fail to initialize device %s\n", path.c_str());
+        exit(1);
+    }
+    emu->devices.plugins.push_back(handle);
 }
 
 // serial
-static uint8_t *serial_base = nullptr;
-void serial_handler(uint32_t offset, int operation) {
-    if (operation != 1) {
-        emu->trap(TRAP_MEM_ERR, SERIAL_BASE + offset);
-        return;
+static uint32_t serial_read(void *opaque, uint32_t offset) {
+    // RBR in byte 0 of word 0, LSR in byte 1 of word 4; only a read that
+    // starts at RBR takes a byte off the RX queue
+    if (offset == (UART_RBR & ~0x3)) {
+        if (emu->devices.read_byte != (UART_RBR & 0x3)) {
+            return 0;
+        }
+        int c = uart_getc();
+        return c < 0 ? 0 : c;
+    }
+    if (offset == (UART_LSR & ~0x3)) {
+        uint32_t lsr = UART_LSR_THRE | UART_LSR_TEMT | (uart_rx_ready() ? UART_LSR_DR : 0);
+        return lsr << ((UART_LSR & 0x3) * 8);
+    }
+    return 0;
+}
+
+static void serial_write(void *opaque, uint32_t offset, uint32_t data, uint32_t mask) {
+    if (offset == UART_RBR && (mask & 1)) {
+        uart_putc(data & 0xff);
     }
-    putchar(serial_base[offset]);
-    fflush(stdout);
 }
 
 void init_serial() {
-    serial_base = (uint8_t *)malloc(8);
-    strcpy(dev[dev_idx].name, "serial");
-    dev[dev_idx].device_base = SERIAL_BASE;
-    dev[dev_idx].data_ptr = (uintptr_t)serial_base;
-    dev[dev_idx].callback = serial_handler;
-    dev_idx++;
+    Device dev = {};
+    strcpy(dev.name, "serial");
+    dev.base = SERIAL_BASE;
+    dev.size = SERIAL_SIZE;
+    dev.read = serial_read;
+    dev.write = serial_write;
+    register_device(&dev);
 }
 
 // timer
-uint32_t *rtc_base = nullptr;
-
-uint64_t boot_time = 0;
 uint64_t gettime(){
     struct timeval tv;
 
@@ -94,34 +201,114 @@ uint64_t gettime(){
 
     uint64_t t = tv.tv_sec * 1000000 + tv.tv_usec;
 
+    uint64_t &boot_time = emu->devices.boot_time;
     if (boot_time == 0)
         boot_time = t;
     return t - boot_time;
 }
 
-void rtc_handler(uint32_t offset, int operation){
-    assert(operation == 0); // only read
-    if (offset == 0){
+static uint32_t rtc_read(void *opaque, uint32_t offset) {
+    DeviceCtx *ctx = &emu->devices;
+    if (offset == 0) {
         uint64_t t = gettime();
-        rtc_base[0] = (uint32_t)(t & 0xffffffff);
-        rtc_base[1] = (uint32_t)(t >> 32);
+        ctx->rtc_hi = (uint32_t)(t >> 32);
+        return (uint32_t)(t & 0xffffffff);
     }
+    if (offset == 4) {
+        return ctx->rtc_hi;
+    }
+    return 0;
+}
+
+static void rtc_reset(void *opaque) {
+    emu->devices.boot_time = 0;
+    emu->devices.rtc_hi = 0;
+    gettime();
 }
 
 void init_timer(){
     gettime();
-    rtc_base = (uint32_t *)malloc(8);
-    strcpy(dev[dev_idx].name, "rtc");
-    dev[dev_idx].device_base = RTC_BASE;
-    dev[dev_idx].data_ptr = (uintptr_t)rtc_base;
-    dev[dev_idx].callback = rtc_handler;
-    dev_idx++;
+    Device dev = {};
+    strcpy(dev.name, "rtc");
+    dev.base = RTC_BASE;
+    dev.size = RTC_SIZE;
+    dev.read = rtc_read;
+    dev.reset = rtc_reset;
+    register_device(&dev);
 }
 
-void init_device() {
+void init_device(const std::vector<const char *> &plugins) {
+    DeviceCtx *ctx = &emu->devices;
     init_serial();
     init_timer();
-    for (int i = 0; i < dev_idx; i++) {
-        printf("[Info] Device %s: 0x%08x\n", dev[i].name, dev[i].device_base);
+    for (const char *spec : plugins) {
+        load_device_plugin(spec);
+    }
+    for (int i = 0; i < ctx->dev_idx; i++) {
+        printf("[Info] Device %s: 0x%08x - 0x%08x%s\n", ctx->dev[i].name, ctx->dev[i].base,
+            ctx->dev[i].base + ctx->dev[i].size - 1, ctx->dev[i].tick ? ", tick" : "");
+    }
+}
+
+void init_mmio_log(const char *record, const char *replay) {
+    DeviceCtx *ctx = &emu->devices;
+    MmioLogHeader header = {MMIO_LOG_MAGIC, MMIO_LOG_VERSION};
+    if (record) {
+        ctx->mmio_record = fopen(record, "wb");
+        assert(ctx->mmio_record);
+        fwrite(&header, sizeof(header), 1, ctx->mmio_record);
+        printf("[Info] Record MMIO reads to %s\n", record);
+    }
+    if (replay) {
+        ctx->mmio_replay = fopen(replay, "rb");
+        assert(ctx->mmio_replay);
+        MmioLogHeader file_header;
+        int ret = fread(&file_header, sizeof(file_header), 1, ctx->mmio_replay);
+        assert(ret == 1 && file_header.magic == header.magic && file_header.version == header.version);
+        printf("[Info] Replay MMIO reads from %s\n", replay);
+    }
+}
+
+void close_mmio_log() {
+    DeviceCtx *ctx = &emu->devices;
+    if (ctx->mmio_record) {
+        fclose(ctx->mmio_record);
+        ctx->mmio_record = nullptr;
     }
-}
\ No newline at end of file
+    if (ctx->mmio_replay) {
+        fclose(ctx->mmio_replay);
+        ctx->mmio_replay = nullptr;
+    }
+}
+
+void reset_device() {
+    DeviceCtx *ctx = &emu->devices;
+    for (int i = 0; i < ctx->dev_idx; i++) {
+        if (ctx->dev[i].reset) {
+            ctx->dev[i].reset(ctx->dev[i].opaque);
+        }
+    }
+    ctx->next_tick = UINT64_MAX;
+    for (int i = 0; i < ctx->tick_num; i++) {
+        ctx->tick_due[i] = ctx->dev[ctx->tick_dev[i]].tick_interval;
+        ctx->next_tick = std::min(ctx->next_tick, ctx->tick_due[i]);
+    }
+}
+
+void free_device() {
+    DeviceCtx *ctx = &emu->devices;
+    for (int i = 0; i < ctx->dev_idx; i++) {
+        if (ctx->dev[i].free) {
+            ctx->dev[i].free(ctx->dev[i].opaque);
+        }
+    }
+    for (void *handle : ctx->plugins) {
+        dlclose(handle);
+    }
+    ctx->plugins.clear();
+    free_uart();
+    close_mmio_log();
+    ctx->dev_idx = 0;
+    ctx->tick_num = 0;
+    ctx->next_tick = UINT64_MAX;
+}
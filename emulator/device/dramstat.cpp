@@ -0,0 +1,181 @@
+#include "dramstat.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+
+static int log2i(uint64_t x) {
+    int n = 0;
+    while (x > 1) {
+        x >>= 1;
+        n++;
+    }
+    return n;
+}
+
+// key = value pairs of a DRAMsim3 ini, sections and comments ignored
+static std::map<std::string, std::string> read_ini(const char *path) {
+    std::map<std::string, std::string> kv;
+    FILE *fp = path ? fopen(path, "r") : nullptr;
+    if (fp == nullptr) {
+        return kv;
+    }
+    char line[256];
+    while (fgets(line, sizeof(line), fp)) {
+        char *eq = strchr(line, '=');
+        if (line[0] == ';' || line[0] == '#' || line[0] == '[' || eq == nullptr) {
+            continue;
+        }
+        *eq = '\0';
+        char key[128], value[128];
+        if (sscanf(line, "%127s", key) == 1 && sscanf(eq + 1, "%127s", value) == 1) {
+            kv[key] = value;
+        }
+    }
+    fclose(fp);
+    return kv;
+}
+
+static uint64_t ini_int(std::map<std::string, std::string> &kv, const char *key, uint64_t dflt) {
+    auto it = kv.find(key);
+    return it == kv.end() ? dflt : strtoull(it->second.c_str(), NULL, 0);
+}
+
+// Same derivation as dramsim3::Config
+static void decode_geometry(DramGeometry *geo, const char *config_file) {
+    auto kv = read_ini(config_file);
+    uint64_t bankgroups = ini_int(kv, "bankgroups", 1);
+    uint64_t banks_per_group = ini_int(kv, "banks_per_group", 1);
+    uint64_t rows = ini_int(kv, "rows", 1 << 16);
+    uint64_t columns = ini_int(kv, "columns", 1 << 10);
+    uint64_t device_width = ini_int(kv, "device_width", 8);
+    uint64_t bl = ini_int(kv, "BL", 8);
+    uint64_t channels = ini_int(kv, "channels", 1);
+    uint64_t channel_size = ini_int(kv, "channel_size", 1024);
+    uint64_t bus_width = ini_int(kv, "bus_width", 64);
+
+    uint64_t devices_per_rank = std::max<uint64_t>(bus_width / device_width, 1);
+    uint64_t bank_bytes = rows * columns * device_width / 8;
+    uint64_t rank_megs = bank_bytes * bankgroups * banks_per_group * devices_per_rank >> 20;
+    uint64_t ranks = rank_megs ? channel_size / rank_megs : 1;
+    ranks = std::min<uint64_t>(std::max<uint64_t>(ranks, 1), DRAM_MAX_RANKS);
+
+    geo->ranks = ranks;
+    geo->banks = bankgroups * banks_per_group;
+    geo->shift = log2i(bus_width / 8 * bl);
+    geo->width[DRAM_CH] = log2i(channels);
+    geo->width[DRAM_RA] = log2i(ranks);
+    geo->width[DRAM_BG] = log2i(bankgroups);
+    geo->width[DRAM_BA] = log2i(banks_per_group);
+    geo->width[DRAM_RO] = log2i(rows);
+    geo->width[DRAM_CO] = log2i(columns) - log2i(bl);
+
+    // fields listed from MSB to LSB, two letters each
+    auto it = kv.find("address_mapping");
+    std::string mapping = it == kv.end() ? "chrobabgraco" : it->second;
+    static const char *names[DRAM_FIELDS] = {"ch", "ra", "bg", "ba", "ro", "co"};
+    int pos = 0;
+    for (int i = (int)mapping.size() - 2; i >= 0; i -= 2) {
+        for (int f = 0; f < DRAM_FIELDS; f++) {
+            if (mapping.compare(i, 2, names[f]) == 0) {
+                geo->pos[f] = pos;
+                pos += geo->width[f];
+            }
+        }
+    }
+
+    if (geo->ranks * geo->banks > DRAM_MAX_BANKS) {
+        printf("[Warn] DRAM stats track only %d of %d banks\n", DRAM_MAX_BANKS, geo->ranks * geo->banks);
+    }
+}
+
+static inline uint32_t field(const DramGeometry *geo, uint32_t addr, int f) {
+    return (addr >> geo->shift >> geo->pos[f]) & ((1u << geo->width[f]) - 1);
+}
+
+// flat bank index across ranks
+static inline uint32_t bank_of(const DramGeometry *geo, uint32_t addr) {
+    uint32_t rank = field(geo, addr, DRAM_RA);
+    uint32_t bank = field(geo, addr, DRAM_BG) << geo->width[DRAM_BA] | field(geo, addr, DRAM_BA);
+    return (rank * geo->banks + bank) % DRAM_MAX_BANKS;
+}
+
+void dram_stat_init(DramStats *st, const char *config_file) {
+    decode_geometry(&st->geo, config_file);
+    dram_stat_reset(st);
+}
+
+void dram_stat_reset(DramStats *st) {
+    DramGeometry geo = st->geo;
+    *st = DramStats();
+    st->geo = geo;
+    for (int i = 0; i < DRAM_MAX_BANKS; i++) {
+        st->open_row[i] = -1;
+    }
+}
+
+void dram_stat_req(DramStats *st, bool is_write, uint32_t id, bool accepted, uint64_t cycles, DramReqInfo *info) {
+    id %= DRAM_MAX_IDS;
+    if (!accepted) {
+        st->rejects[is_write]++;
+        if (!st->pending[is_write][id]) {
+            st->pending[is_write][id] = true;
+            st->pending_since[is_write][id] = cycles;
+        }
+        return;
+    }
+
+    st->reqs[is_write]++;
+    info->issue_cycle = cycles;
+    if (st->pending[is_write][id]) {
+        info->issue_cycle = st->pending_since[is_write][id];
+        st->queue_cycles[is_write] += cycles - st->pending_since[is_write][id];
+        st->pending[is_write][id] = false;
+    }
+    info->accept_cycle = cycles;
+
+    uint32_t bank = bank_of(&st->geo, info->addr);
+    int64_t row = field(&st->geo, info->addr, DRAM_RO);
+    if (st->open_row[bank] == row) {
+        st->row_hits++;
+    }
+    st->open_row[bank] = row;
+    st->bank_reqs[bank]++;
+}
+
+void dram_stat_rsp(DramStats *st, bool is_write, uint64_t cycles, const DramReqInfo *info) {
+    uint64_t service = cycles - info->accept_cycle;
+    st->service_cycles[is_write] += service;
+    st->service_max[is_write] = std::max(st->service_max[is_write], service);
+
+    uint32_t rank = field(&st->geo, info->addr, DRAM_RA) % DRAM_MAX_RANKS;
+    uint32_t bank = bank_of(&st->geo, info->addr);
+    st->bank_busy[bank] += service;
+    st->rank_busy[rank] += service;
+}
+
+// Same "name: value" lines as the PerfBox counters, see scripts/topdown.py
+void dram_stat_dump(DramStats *st, uint64_t cycles, FILE *fp) {
+    static const char *dir[2] = {"read", "write"};
+    fprintf(fp, "dram_cycles: %lu\n", cycles);
+    for (int w = 0; w < 2; w++) {
+        fprintf(fp, "dram_%s_reqs: %lu\n", dir[w], st->reqs[w]);
+        fprintf(fp, "dram_%s_rejects: %lu\n", dir[w], st->rejects[w]);
+        fprintf(fp, "dram_%s_queue_tot: %lu\n", dir[w], st->queue_cycles[w]);
+        fprintf(fp, "dram_%s_service_tot: %lu\n", dir[w], st->service_cycles[w]);
+        fprintf(fp, "dram_%s_service_max: %lu\n", dir[w], st->service_max[w]);
+    }
+    fprintf(fp, "dram_row_hits: %lu\n", st->row_hits);
+
+    int banks = std::min(st->geo.ranks * st->geo.banks, DRAM_MAX_BANKS);
+    for (int i = 0; i < banks; i++) {
+        if (st->bank_reqs[i]) {
+            fprintf(fp, "dram_bank%d_reqs: %lu\n", i, st->bank_reqs[i]);
+            fprintf(fp, "dram_bank%d_busy: %lu\n", i, st->bank_busy[i]);
+        }
+    }
+    for (int i = 0; i < st->geo.ranks; i++) {
+        fprintf(fp, "dram_rank%d_busy: %lu\n", i, st->rank_busy[i]);
+    }
+}
@@ -3,37 +3,67 @@
 #include "cosimulation.h"
 #include "device.h"
 #include "emu.h"
+#include "memtrace.h"
 #include <cstdint>
 #include <iostream>
+#include <sys/mman.h>
 
-uint8_t pmem[MEMSIZE];
-uint8_t mrom[MROM_SIZE];
-uint8_t sram[SRAM_SIZE];
-uint8_t flash[FLASH_SIZE];
-
-CoDRAMsim3 *dram = nullptr;
-
-const char *config_file = nullptr;
-const char *out_dir = nullptr;
-
-long init_mem(char *img){
-    std::cout << "[INFO] Initialize memory" << std::endl;
+static uint8_t *alloc_guest(size_t size) {
+    // untouched pages are never backed, so idle instances stay cheap
+    void *p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    assert(p != MAP_FAILED);
+    return (uint8_t *)p;
+}
 
-    // Initialize the DRAMSim3
+static const char *dram_config() {
+    const char *config_file = nullptr;
 #ifdef DRAMSIM3_CONFIG
 config_file = DRAMSIM3_CONFIG;
 #endif
+    return config_file;
+}
+
+static CoDRAMsim3 *new_dram(const char *dram_outdir) {
+    const char *config_file = dram_config();
+    const char *out_dir = nullptr;
+
+    // Initialize the DRAMSim3
 
 #ifdef DRAMSIM3_OUTDIR
 out_dir = DRAMSIM3_OUTDIR;
 #endif
+    if (dram_outdir != nullptr) {
+        out_dir = dram_outdir;
+    }
     std::cout << "DRAMSIM3 config: " << config_file << std::endl;
     std::cout << "DRAMSIM3 outdir: " << out_dir << std::endl;
-    dram = new ComplexCoDRAMsim3(config_file, out_dir, 0);
+    dram_stat_init(&emu->mem.dram_stats, config_file);
+    return new ComplexCoDRAMsim3(config_file, out_dir, 0);
+}
+
+long init_mem(char *img){
+    std::cout << "[INFO] Initialize memory" << std::endl;
+
+    MemoryCtx *mem = &emu->mem;
+    mem->pmem = alloc_guest(MEMSIZE);
+    mem->mrom = alloc_guest(MROM_SIZE);
+    mem->sram = alloc_guest(SRAM_SIZE);
+    mem->flash = alloc_guest(FLASH_SIZE);
 
+    return load_image(img);
+}
+
+// Not needed until the first cycle after reset, see Emulator::Emulator()
+void init_dram(const char *dram_outdir) {
+    emu->mem.dram = new_dram(dram_outdir);
+}
+
+long load_image(char *img) {
+    MemoryCtx *mem = &emu->mem;
     if (img == nullptr) {
         printf("Use default image.\n");
         memcpy(guest2host(PC_RSTVEC), default_inst, sizeof(default_inst));
+        mark_dirty(mem, PC_RSTVEC);
         return 8;
     }
 
@@ -50,13 +80,67 @@ out_dir = DRAMSIM3_OUTDIR;
     int ret = fread(guest2host(PC_RSTVEC), size, 1, fp);
     assert(ret == 1);
 
+    for (uint32_t off = 0; off < size; off += PAGE_SIZE) {
+        mark_dirty(mem, PC_RSTVEC + off);
+    }
+
     fclose(fp);
     return size;
 }
 
+// Outstanding requests belong to the previous run: let the model answer
+// them and drop the responses, which empties its queues without parsing
+// the config again. DRAMsim3 keeps writing its own stats to the first outdir.
+void reset_dram() {
+    MemoryCtx *mem = &emu->mem;
+    CoDRAMsim3 *dram = mem->dram;
+    while (mem->dram_inflight) {
+        dram->tick();
+        for (bool is_write : {false, true}) {
+            CoDRAMResponse *rsp;
+            while ((rsp = is_write ? dram->check_write_response() : dram->check_read_response())) {
+                delete static_cast<dramsim3_meta *>(rsp->req->meta);
+                delete rsp;
+                mem->dram_inflight--;
+            }
+        }
+    }
+    dram_stat_init(&mem->dram_stats, dram_config());
+}
+
+// Zero every dirty page, and the same pages in REF if asked
+void clear_dirty_mem(bool sync_ref) {
+    static uint8_t zero_page[PAGE_SIZE] = {};
+    MemoryCtx *mem = &emu->mem;
+    for (uint32_t i = 0; i < PMEM_PAGES / 64; i++) {
+        uint64_t bits = mem->dirty[i];
+        while (bits) {
+            uint32_t page = i * 64 + __builtin_ctzl(bits);
+            bits &= bits - 1;
+            paddr_t addr = MEMBASE + (page << PAGE_SHIFT);
+            memset(guest2host(addr), 0, PAGE_SIZE);
+            if (sync_ref) {
+                ref_memcpy(&emu->diff, addr, zero_page, PAGE_SIZE, DIFFTEST_TO_REF);
+            }
+        }
+        mem->dirty[i] = 0;
+    }
+}
+
+void free_mem() {
+    MemoryCtx *mem = &emu->mem;
+    delete mem->dram;
+    memtrace_close(mem->mem_trace);
+    munmap(mem->pmem, MEMSIZE);
+    munmap(mem->mrom, MROM_SIZE);
+    munmap(mem->sram, SRAM_SIZE);
+    munmap(mem->flash, FLASH_SIZE);
+    *mem = MemoryCtx();
+}
+
 uint8_t* guest2host(paddr_t paddr){
     if (in_pmem(paddr))
-        return pmem + paddr - MEMBASE;
+        return emu->mem.pmem + paddr - MEMBASE;
     emu->trap(TRAP_MEM_ERR, paddr);
     return nullptr;
 }
@@ -78,13 +162,14 @@ uint32_t host_write(void *addr, uint32_t data, uint32_t mask){
     return real_data;
 }
 
+// addr keeps its byte offset for the devices, memory reads the whole word
 uint32_t pmem_read(paddr_t addr) {
     if (is_device(addr) != -1) {
         return device_read(addr);
     }
 
     uint32_t res = 0;
-    uint8_t *p = guest2host(addr);
+    uint8_t *p = guest2host(addr & ~0x3u);
 
     if (p != nullptr) {
         res = host_read(p);
@@ -103,6 +188,7 @@ uint32_t pmem_write(paddr_t addr, uint32_t data, uint32_t mask) {
 
     if (p != nullptr) {
         res = host_write(p, data, mask);
+        mark_dirty(&emu->mem, addr);
     }
 
     return res;
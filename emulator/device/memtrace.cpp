@@ -0,0 +1,30 @@
+#include "memtrace.h"
+#include <cassert>
+
+#define MEMTRACE_BUF_SIZE (1 << 20)
+
+FILE *memtrace_open(const char *path) {
+    FILE *fp = fopen(path, "wb");
+    assert(fp);
+    setvbuf(fp, NULL, _IOFBF, MEMTRACE_BUF_SIZE);
+    MemTraceHeader header = {MEMTRACE_MAGIC, MEMTRACE_VERSION};
+    fwrite(&header, sizeof(header), 1, fp);
+    printf("[Info] Record memory transactions to %s\n", path);
+    return fp;
+}
+
+void memtrace_write(FILE *fp, uint64_t cycle, uint32_t addr, uint64_t latency, uint8_t id, bool is_write) {
+    MemTraceRecord rec;
+    rec.cycle = cycle;
+    rec.addr = addr;
+    rec.latency = latency > UINT16_MAX ? UINT16_MAX : latency;
+    rec.id = id;
+    rec.is_write = is_write;
+    fwrite(&rec, sizeof(rec), 1, fp);
+}
+
+void memtrace_close(FILE *fp) {
+    if (fp) {
+        fclose(fp);
+    }
+}
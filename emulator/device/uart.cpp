@@ -0,0 +1,150 @@
+#include "uart.h"
+#include "emu.h"
+#include <cassert>
+#include <chrono>
+#include <unistd.h>
+
+// stdin is shared by the whole process, so its reader is too
+static std::mutex stdin_lock;
+static std::deque<uint8_t> stdin_queue;
+static std::once_flag stdin_once;
+
+static void stdin_reader() {
+    uint8_t c;
+    while (read(STDIN_FILENO, &c, 1) == 1) {
+        std::lock_guard<std::mutex> guard(stdin_lock);
+        stdin_queue.push_back(c);
+    }
+}
+
+// caller holds uart->lock
+static void flush_locked(UartCtx *uart) {
+    if (uart->len == 0) {
+        return;
+    }
+    fwrite(uart->buf, 1, uart->len, stdout);
+    fflush(stdout);
+    if (uart->capture) {
+        fwrite(uart->buf, 1, uart->len, uart->capture);
+    }
+    uart->len = 0;
+}
+
+static void flusher_loop(UartCtx *uart) {
+    std::unique_lock<std::mutex> guard(uart->lock);
+    while (!uart->stop) {
+        uart->cv.wait_for(guard, std::chrono::milliseconds(uart->flush_ms));
+        flush_locked(uart);
+    }
+}
+
+void init_uart(const char *capture, const char *input, uint64_t flush_ms) {
+    UartCtx *uart = &emu->devices.uart;
+    uart->len = 0;
+    uart->stop = false;
+
+    if (capture) {
+        uart->capture = fopen(capture, "w");
+        assert(uart->capture);
+        printf("[Info] Capture UART output to %s\n", capture);
+    }
+
+    if (input) {
+        if (input[0] == '-' && input[1] == '\0') {
+            uart->use_stdin = true;
+            std::call_once(stdin_once, []() { std::thread(stdin_reader).detach(); });
+        }
+        else {
+            FILE *fp = fopen(input, "rb");
+            assert(fp);
+            int c;
+            while ((c = fgetc(fp)) != EOF) {
+                uart->input.push_back(c);
+            }
+            fclose(fp);
+        }
+    }
+
+    uart->flush_ms = flush_ms;
+    if (flush_ms) {
+        uart->flusher = std::thread(flusher_loop, uart);
+    }
+}
+
+// Batch mode: the next image captures into its own file
+void uart_reopen(const char *capture) {
+    UartCtx *uart = &emu->devices.uart;
+    std::lock_guard<std::mutex> guard(uart->lock);
+    flush_locked(uart);
+    if (uart->capture) {
+        fclose(uart->capture);
+    }
+    uart->capture = fopen(capture, "w");
+    assert(uart->capture);
+    printf("[Info] Capture UART output to %s\n", capture);
+}
+
+void uart_putc(char c) {
+    UartCtx *uart = &emu->devices.uart;
+    std::lock_guard<std::mutex> guard(uart->lock);
+    uart->buf[uart->len++] = c;
+    if (c == '\n' || uart->len == UART_BUF_SIZE) {
+        flush_locked(uart);
+    }
+}
+
+// output written so far goes out first, a prompt shows before its input is read
+int uart_getc() {
+    UartCtx *uart = &emu->devices.uart;
+    uart_flush();
+    if (uart->use_stdin) {
+        std::lock_guard<std::mutex> guard(stdin_lock);
+        if (stdin_queue.empty()) {
+            return -1;
+        }
+        int c = stdin_queue.front();
+        stdin_queue.pop_front();
+        return c;
+    }
+    if (uart->input.empty()) {
+        return -1;
+    }
+    int c = uart->input.front();
+    uart->input.pop_front();
+    return c;
+}
+
+bool uart_rx_ready() {
+    UartCtx *uart = &emu->devices.uart;
+    uart_flush();
+    if (uart->use_stdin) {
+        std::lock_guard<std::mutex> guard(stdin_lock);
+        return !stdin_queue.empty();
+    }
+    return !uart->input.empty();
+}
+
+void uart_flush() {
+    UartCtx *uart = &emu->devices.uart;
+    std::lock_guard<std::mutex> guard(uart->lock);
+    flush_locked(uart);
+}
+
+void free_uart() {
+    UartCtx *uart = &emu->devices.uart;
+    if (uart->flusher.joinable()) {
+        {
+            std::lock_guard<std::mutex> guard(uart->lock);
+            uart->stop = true;
+        }
+        uart->cv.notify_all();
+        uart->flusher.join();
+    }
+    uart_flush();
+    if (uart->capture) {
+        fclose(uart->capture);
+        uart->capture = nullptr;
+    }
+    uart->input.clear();
+    uart->use_stdin = false;
+}
@@ -4,41 +4,248 @@
 #include "svdpi.h"
 #include <cstddef>
 #include <cassert>
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
 #include <dlfcn.h>
+#include <sys/mman.h>
 
-void (*ref_difftest_memcpy)(paddr_t addr, void *buf, int n, bool direction) = NULL;
-void (*ref_difftest_regcpy)(void *dut, bool direction) = NULL;
-void (*ref_difftest_exec)(uint32_t n) = NULL;
-void (*ref_difftest_init)(int port) = NULL;
+// number of REF copies loaded by this process
+static std::atomic<int> ref_instances(0);
 
-const char *diff_ref_so = nullptr; 
-
-void init_difftest(long img_size, int port) {
+void init_difftest(const char *ref_so, const char *img, long img_size, int port) {
     
-    assert(diff_ref_so != NULL);
+    assert(ref_so != NULL);
+
+    DifftestCtx *ctx = &emu->diff;
+
+    if (strcmp(ref_so, "builtin") == 0) {
+        ctx->builtin = refcore_init(img, img_size);
+        if (img == nullptr) {
+            ref_memcpy(ctx, PC_RSTVEC, guest2host(PC_RSTVEC), img_size, DIFFTEST_TO_REF);
+        }
+        return;
+    }
 
+    // The REF keeps its state in library globals, so every instance after
+    // the first one gets a private copy in a new link-map namespace.
     void *handle;
-    handle = dlopen(diff_ref_so, RTLD_LAZY);
-    assert(handle);
+    if (ref_instances++ == 0) {
+        handle = dlopen(ref_so, RTLD_LAZY);
+    }
+    else {
+        handle = dlmopen(LM_ID_NEWLM, ref_so, RTLD_LAZY);
+    }
+    if (handle == nullptr) {
+        printf("[Error] Cannot load REF copy %d of %s: %s\n", ref_instances.load(), ref_so, dlerror());
+        exit(1);
+    }
+    ctx->handle = handle;
+
+    ctx->ref_difftest_memcpy = (void (*)(paddr_t, void *, int, bool))dlsym(handle, "difftest_memcpy");
+    assert(ctx->ref_difftest_memcpy);
+
+    ctx->ref_difftest_regcpy = (void (*)(void *, bool))dlsym(handle, "difftest_regcpy");
+    assert(ctx->ref_difftest_regcpy);
 
-    ref_difftest_memcpy = (void (*)(paddr_t, void *, int, bool))dlsym(handle, "difftest_memcpy");
-    assert(ref_difftest_memcpy);
+    ctx->ref_difftest_exec = (void (*)(uint32_t n))dlsym(handle, "difftest_exec");
+    assert(ctx->ref_difftest_exec);
 
-    ref_difftest_regcpy = (void (*)(void *, bool))dlsym(handle, "difftest_regcpy");
-    assert(ref_difftest_regcpy);
+    ctx->ref_difftest_init = (void (*)(int))dlsym(handle, "difftest_init");
+    assert(ctx->ref_difftest_init);
 
-    ref_difftest_exec = (void (*)(uint32_t n))dlsym(handle, "difftest_exec");
-    assert(ref_difftest_exec);
+    ctx->port = port;
+    ctx->ref_difftest_init(port);
+    ctx->ref_difftest_memcpy(PC_RSTVEC, guest2host(PC_RSTVEC), img_size, DIFFTEST_TO_REF);
+}
+
+// Bring REF back to the reset state with a freshly loaded image
+void reset_difftest(const char *img, long img_size) {
+    DifftestCtx *ctx = &emu->diff;
+    ctx->store_num = 0;
+    if (ctx->builtin) {
+        refcore_reset(ctx->builtin, img, img_size);
+        if (img == nullptr) {
+            ref_memcpy(ctx, PC_RSTVEC, guest2host(PC_RSTVEC), img_size, DIFFTEST_TO_REF);
+        }
+        return;
+    }
+
+    // regcpy only covers GPRs and pc, the REF init resets its CSRs too
+    CPUState reset_state = {};
+    reset_state.pc = PC_RSTVEC;
+    ctx->ref_difftest_init(ctx->port);
+    ctx->ref_difftest_memcpy(PC_RSTVEC, guest2host(PC_RSTVEC), img_size, DIFFTEST_TO_REF);
+    ctx->ref_difftest_regcpy(&reset_state, DIFFTEST_TO_REF);
+}
 
-    void (*ref_difftest_init)(int) = (void (*)(int))dlsym(handle, "difftest_init");
-    assert(ref_difftest_init);
+void init_shadow_mem(long img_size, uint64_t hash_interval) {
+    DifftestCtx *ctx = &emu->diff;
+    ctx->hash_interval = hash_interval;
+    if (ctx->shadow != nullptr) {
+        munmap(ctx->shadow, MEMSIZE);
+        ctx->shadow = nullptr;
+    }
+    if (hash_interval == 0) {
+        return;
+    }
 
-    ref_difftest_init(port);
-    ref_difftest_memcpy(PC_RSTVEC, guest2host(PC_RSTVEC), img_size, DIFFTEST_TO_REF);
+    void *p = mmap(NULL, MEMSIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    assert(p != MAP_FAILED);
+    ctx->shadow = (uint8_t *)p;
+    memcpy(ctx->shadow + PC_RSTVEC - MEMBASE, guest2host(PC_RSTVEC), img_size);
+    ctx->next_hash = hash_interval;
+}
+
+void free_difftest() {
+    DifftestCtx *ctx = &emu->diff;
+    if (ctx->shadow != nullptr) {
+        munmap(ctx->shadow, MEMSIZE);
+        ctx->shadow = nullptr;
+    }
+    if (ctx->builtin != nullptr) {
+        refcore_free(ctx->builtin);
+        ctx->builtin = nullptr;
+    }
+    if (ctx->handle != nullptr) {
+        dlclose(ctx->handle);
+        ref_instances--;
+    }
+    ctx->handle = nullptr;
+}
+
+void init_diff_scope() {
+    svScope scope = svGetScopeFromName("TOP.SimTop.difftest.messager");
+    assert(scope);
+    emu->diff.messager_scope = scope;
 }
 
 void diff_step() {
-    ref_difftest_exec(1);
+    DifftestCtx *ctx = &emu->diff;
+    ref_exec(ctx, 1);
+    if (ctx->builtin && ctx->builtin->error) {
+        printf("[Error] Builtin REF cannot execute instruction at 0x%08x\n", ctx->builtin->pc);
+        emu->trap(TRAP_DIFF_ERR, ctx->builtin->pc);
+    }
+}
+
+void diff_record_store(const diff_infos *infos) {
+    DifftestCtx *ctx = &emu->diff;
+    assert(ctx->store_num < COMMIT_WIDTH);
+    ctx->stores[ctx->store_num++] = {infos->pc, infos->mem_addr, infos->mem_data, infos->mem_mask};
+
+    if (ctx->shadow && in_pmem(infos->mem_addr)) {
+        uint8_t *p = ctx->shadow + infos->mem_addr - MEMBASE;
+        for (int i = 0; i < 4; i++) {
+            if (infos->mem_mask >> i & 1) {
+                p[i] = infos->mem_data >> (i * 8);
+            }
+        }
+    }
+}
+
+// stores of one cycle closer than this are fetched from REF in one memcpy
+#define STORE_SPAN_MAX 64
+
+// Compare the bytes written by this cycle's stores with REF memory, after
+// REF has executed the same instructions
+void diff_check_stores() {
+    DifftestCtx *ctx = &emu->diff;
+    int n = ctx->store_num;
+    if (n == 0) {
+        return;
+    }
+    ctx->store_num = 0;
+
+    paddr_t lo = ctx->stores[0].addr, hi = lo + 4;
+    for (int i = 1; i < n; i++) {
+        lo = std::min(lo, (paddr_t)ctx->stores[i].addr);
+        hi = std::max(hi, (paddr_t)ctx->stores[i].addr + 4);
+    }
+    uint8_t span[STORE_SPAN_MAX];
+    bool batched = hi - lo <= STORE_SPAN_MAX;
+    if (batched) {
+        ref_memcpy(ctx, lo, span, hi - lo, DIFFTEST_TO_DUT);
+    }
+
+    for (int i = 0; i < n; i++) {
+        StoreCommit *st = &ctx->stores[i];
+        // bytes overwritten later in the same cycle are checked there
+        uint32_t mask = st->mask;
+        for (int j = i + 1; j < n; j++) {
+            if (ctx->stores[j].addr == st->addr) {
+                mask &= ~ctx->stores[j].mask;
+            }
+        }
+        if ((mask & 0xf) == 0) {
+            continue;
+        }
+
+        uint32_t ref_data;
+        if (batched) {
+            memcpy(&ref_data, span + st->addr - lo, 4);
+        }
+        else {
+            ref_memcpy(ctx, st->addr, &ref_data, 4, DIFFTEST_TO_DUT);
+        }
+
+        uint32_t byte_mask = 0;
+        for (int b = 0; b < 4; b++) {
+            if (mask >> b & 1) {
+                byte_mask |= 0xff << (b * 8);
+            }
+        }
+        if ((st->data & byte_mask) != (ref_data & byte_mask)) {
+            printf("[Error] Store at 0x%08x, mask 0x%x: NPC: 0x%08x, REF: 0x%08x\n",
+                st->addr, mask & 0xf, st->data & byte_mask, ref_data & byte_mask);
+            printf("[AT   ] Store PC: 0x%08x\n", st->pc);
+            emu->trap(TRAP_DIFF_ERR, st->addr);
+            return;
+        }
+    }
+}
+
+static uint64_t page_hash(const uint8_t *page) {
+    // FNV-1a over 64-bit words
+    const uint64_t *w = (const uint64_t *)page;
+    uint64_t h = 0xcbf29ce484222325UL;
+    for (int i = 0; i < PAGE_SIZE / 8; i++) {
+        h = (h ^ w[i]) * 0x100000001b3UL;
+    }
+    return h;
+}
+
+// Hash every page touched so far in the shadow and in REF; untouched pages
+// still hold zero on both sides
+void diff_check_mem_hash() {
+    DifftestCtx *ctx = &emu->diff;
+    MemoryCtx *mem = &emu->mem;
+    static thread_local uint8_t ref_page[PAGE_SIZE];
+
+    ctx->next_hash = emu->get_cycles() + ctx->hash_interval;
+    for (uint32_t i = 0; i < PMEM_PAGES / 64; i++) {
+        uint64_t bits = mem->dirty[i];
+        while (bits) {
+            uint32_t page = i * 64 + __builtin_ctzl(bits);
+            bits &= bits - 1;
+            paddr_t addr = MEMBASE + (page << PAGE_SHIFT);
+            uint8_t *shadow_page = ctx->shadow + (page << PAGE_SHIFT);
+            ref_memcpy(ctx, addr, ref_page, PAGE_SIZE, DIFFTEST_TO_DUT);
+            if (page_hash(shadow_page) == page_hash(ref_page)) {
+                continue;
+            }
+
+            uint32_t off = 0;
+            while (off < PAGE_SIZE && shadow_page[off] == ref_page[off]) {
+                off++;
+            }
+            printf("[Error] Memory hash of page 0x%08x differs, first at 0x%08x: NPC: 0x%02x, REF: 0x%02x\n",
+                addr, addr + off, shadow_page[off], ref_page[off]);
+            emu->trap(TRAP_DIFF_ERR, addr + off);
+            return;
+        }
+    }
 }
 
 // get commit diff_info from NPC
@@ -47,9 +254,7 @@ int get_diff_infos(diff_infos *infos, int req_idx) {
     svLogicVecVal pc, inst, rf_waddr, rf_wdata, mem_addr, mem_data, mem_mask, idx;
     idx.aval = req_idx;
 
-    svScope scope = svGetScopeFromName("TOP.SimTop.difftest.messager");
-    assert(scope);
-    svSetScope(scope);
+    svSetScope(emu->diff.messager_scope);
 
     set_diff_idx(&idx);
 
@@ -0,0 +1,180 @@
+#include "refcore.h"
+#include "difftest.h"
+#include "emu.h"
+#include <cassert>
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+static inline int32_t sext(uint32_t x, int bits) {
+    return (int32_t)(x << (32 - bits)) >> (32 - bits);
+}
+
+#define BITS(x, hi, lo) (((x) >> (lo)) & ((1u << ((hi) - (lo) + 1)) - 1))
+
+static RefOp decode_op(uint32_t raw) {
+    uint32_t opcode = BITS(raw, 6, 0);
+    uint32_t funct3 = BITS(raw, 14, 12);
+    uint32_t funct7 = BITS(raw, 31, 25);
+
+    switch (opcode) {
+    case 0x37: return REF_LUI;
+    case 0x17: return REF_AUIPC;
+    case 0x6f: return REF_JAL;
+    case 0x67: return funct3 == 0 ? REF_JALR : REF_INVALID;
+    case 0x63: {
+        static const RefOp ops[8] = {REF_BEQ, REF_BNE, REF_INVALID, REF_INVALID,
+            REF_BLT, REF_BGE, REF_BLTU, REF_BGEU};
+        return ops[funct3];
+    }
+    case 0x03: {
+        static const RefOp ops[8] = {REF_LB, REF_LH, REF_LW, REF_INVALID,
+            REF_LBU, REF_LHU, REF_INVALID, REF_INVALID};
+        return ops[funct3];
+    }
+    case 0x23: {
+        static const RefOp ops[8] = {REF_SB, REF_SH, REF_SW, REF_INVALID,
+            REF_INVALID, REF_INVALID, REF_INVALID, REF_INVALID};
+        return ops[funct3];
+    }
+    case 0x13:
+        switch (funct3) {
+        case 0: return REF_ADDI;
+        case 2: return REF_SLTI;
+        case 3: return REF_SLTIU;
+        case 4: return REF_XORI;
+        case 6: return REF_ORI;
+        case 7: return REF_ANDI;
+        case 1: return funct7 == 0x00 ? REF_SLLI : REF_INVALID;
+        case 5: return funct7 == 0x00 ? REF_SRLI : funct7 == 0x20 ? REF_SRAI : REF_INVALID;
+        }
+        break;
+    case 0x33:
+        if (funct7 == 0x01) {
+            static const RefOp ops[8] = {REF_MUL, REF_MULH, REF_MULHSU, REF_MULHU,
+                REF_DIV, REF_DIVU, REF_REM, REF_REMU};
+            return ops[funct3];
+        }
+        if (funct7 == 0x00) {
+            static const RefOp ops[8] = {REF_ADD, REF_SLL, REF_SLT, REF_SLTU,
+                REF_XOR, REF_SRL, REF_OR, REF_AND};
+            return ops[funct3];
+        }
+        if (funct7 == 0x20) {
+            return funct3 == 0 ? REF_SUB : funct3 == 5 ? REF_SRA : REF_INVALID;
+        }
+        break;
+    case 0x73:
+        switch (funct3) {
+        case 1: return REF_CSRRW;
+        case 2: return REF_CSRRS;
+        case 3: return REF_CSRRC;
+        case 0:
+            if (raw == 0x00000073) return REF_ECALL;
+            if (raw == 0x00100073) return REF_EBREAK;
+            if (raw == 0x30200073) return REF_MRET;
+            break;
+        }
+        break;
+    }
+    return REF_INVALID;
+}
+
+void refcore_decode(RefInst *inst, uint32_t pc, uint32_t raw) {
+    inst->pc = pc;
+    inst->raw = raw;
+    inst->op = decode_op(raw);
+    inst->rd = BITS(raw, 11, 7);
+    inst->rs1 = BITS(raw, 19, 15);
+    inst->rs2 = BITS(raw, 24, 20);
+
+    switch (BITS(raw, 6, 0)) {
+    case 0x37: case 0x17:   // U
+        inst->imm = raw & 0xfffff000;
+        break;
+    case 0x6f:              // J
+        inst->imm = sext(BITS(raw, 31, 31) << 20 | BITS(raw, 19, 12) << 12 |
+            BITS(raw, 20, 20) << 11 | BITS(raw, 30, 21) << 1, 21);
+        break;
+    case 0x63:              // B
+        inst->imm = sext(BITS(raw, 31, 31) << 12 | BITS(raw, 7, 7) << 11 |
+            BITS(raw, 30, 25) << 5 | BITS(raw, 11, 8) << 1, 13);
+        break;
+    case 0x23:              // S
+        inst->imm = sext(BITS(raw, 31, 25) << 5 | BITS(raw, 11, 7), 12);
+        break;
+    case 0x73:              // csr number
+        inst->imm = BITS(raw, 31, 20);
+        break;
+    default:                // I
+        inst->imm = sext(BITS(raw, 31, 20), 12);
+        break;
+    }
+}
+
+// Fresh memory holding only the image. The image file is mapped privately,
+// so its pages are shared with the page cache until REF writes them.
+static void map_guest(RefCore *ref, const char *img, long img_size) {
+    void *p = mmap(ref->mem, MEMSIZE, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | (ref->mem ? MAP_FIXED : 0), -1, 0);
+    assert(p != MAP_FAILED);
+    ref->mem = (uint8_t *)p;
+
+    if (img == nullptr) {
+        return;
+    }
+    int fd = open(img, O_RDONLY);
+    assert(fd >= 0);
+    p = mmap(ref->mem + PC_RSTVEC - MEMBASE, img_size, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_FIXED, fd, 0);
+    assert(p != MAP_FAILED);
+    close(fd);
+}
+
+RefCore *refcore_init(const char *img, long img_size) {
+    RefCore *ref = new RefCore();
+    refcore_reset(ref, img, img_size);
+    printf("[Info] Use builtin REF\n");
+    return ref;
+}
+
+void refcore_reset(RefCore *ref, const char *img, long img_size) {
+    map_guest(ref, img, img_size);
+    memset(ref->gpr, 0, sizeof(ref->gpr));
+    memset(ref->icache, 0, sizeof(ref->icache));
+    ref->pc = PC_RSTVEC;
+    ref->mstatus = 0x1800;
+    ref->mtvec = 0;
+    ref->mepc = 0;
+    ref->mcause = 0;
+    ref->error = false;
+}
+
+void refcore_free(RefCore *ref) {
+    munmap(ref->mem, MEMSIZE);
+    delete ref;
+}
+
+void refcore_memcpy(RefCore *ref, paddr_t addr, void *buf, int n, bool direction) {
+    uint8_t *p = ref_guest(ref, addr, n);
+    assert(p);
+    if (direction == DIFFTEST_TO_REF) {
+        memcpy(p, buf, n);
+    }
+    else {
+        memcpy(buf, p, n);
+    }
+}
+
+void refcore_regcpy(RefCore *ref, void *dut, bool direction) {
+    CPUState *state = (CPUState *)dut;
+    if (direction == DIFFTEST_TO_REF) {
+        memcpy(ref->gpr, state->gpr, sizeof(ref->gpr));
+        ref->pc = state->pc;
+    }
+    else {
+        memcpy(state->gpr, ref->gpr, sizeof(ref->gpr));
+        state->pc = ref->pc;
+    }
+}
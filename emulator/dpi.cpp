@@ -2,6 +2,10 @@
 #include "cosimulation.h"
 #include "dpi.h"
 #include "emu.h"
+#include "memtrace.h"
+#include "telemetry.h"
+#include <algorithm>
+#include <cstdio>
 #include <memory.h>
 
 // C Env
@@ -16,7 +20,7 @@ extern "C" void halt(int reason) {
 }
 
 extern "C" int mem_read(int paddr) {
-    int res = pmem_read(paddr & (~0x3u));
+    int res = pmem_read(paddr);
     return res;
 }
 
@@ -25,33 +29,60 @@ extern "C" void mem_write(int paddr, const svBitVecVal* mask, int data) {
 }
 
 extern "C" svBit mem_req(int address, int id, svBit is_write) {
+    CoDRAMsim3 *dram = emu->mem.dram;
     if (dram == NULL) {
         assert(0);
     }
-    if (dram->will_accept(address, is_write)) {
+    bool accepted = dram->will_accept(address, is_write);
+    DramReqInfo info = {(uint32_t)address, 0, 0};
+    dram_stat_req(&emu->mem.dram_stats, is_write, id, accepted, emu->get_cycles(), &info);
+    if (accepted) {
         auto req = new CoDRAMRequest();
         auto meta = new dramsim3_meta;
         req->address = address;
         req->is_write = is_write;
         meta->id = id;
+        meta->info = info;
         req->meta = meta;
         dram->add_request(req);
+        emu->mem.dram_inflight++;
         return true;
     }
     return false;
 }
 
 extern "C" long long mem_rsp(svBit is_write) {
+    CoDRAMsim3 *dram = emu->mem.dram;
     if (dram == NULL) {
         assert(0);
     }
     auto rsp = is_write ? dram->check_write_response() : dram->check_read_response();
     if (rsp) {
         auto meta = static_cast<dramsim3_meta *>(rsp->req->meta);
+        uint64_t cycles = emu->get_cycles();
+        dram_stat_rsp(&emu->mem.dram_stats, is_write, cycles, &meta->info);
+        if (emu->mem.mem_trace) {
+            memtrace_write(emu->mem.mem_trace, meta->info.issue_cycle, meta->info.addr,
+                cycles - meta->info.issue_cycle, meta->id, is_write);
+        }
         uint64_t response = meta->id | (1UL << 32);
+        emu->mem.dram_inflight--;
         delete meta;
         delete rsp;
         return response;
     }
     return 0;
+}
+
+// One call per PerfBox counter on a cycle with perf_ctrl_dump set
+extern "C" void perf_sample(int idx, const char *name, long long value) {
+    TelemetryCtx *tm = &emu->telemetry;
+    if (idx >= TELEMETRY_COUNTERS) {
+        return;
+    }
+    TelemetryCounter *c = &tm->samples[idx];
+    snprintf(c->name, sizeof(c->name), "%s", name);
+    c->value = value;
+    tm->nsamples = std::max(tm->nsamples, (uint32_t)idx + 1);
+    tm->sample_cycles = emu->get_cycles();
 }
\ No newline at end of file
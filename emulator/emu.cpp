@@ -2,26 +2,71 @@
 #include "VSimTop__Dpi.h"
 #include "common.h"
 #include "device.h"
+#include "blkdev.h"
+#include "archhash.h"
+#include "memtrace.h"
+#include "cmttrace.h"
+#include "telemetry.h"
 #include "difftest.h"
 #include "isa.h"
 #include "lightsss.h"
 #include "trace.h"
 #include "svdpi.h"
 #include "verilated.h"
+#if VM_TRACE
 #include "verilated_fst_c.h"
+#endif
 #include <cassert>
+#include <thread>
 #include <getopt.h>
 #include <cstddef>
 #include <memory.h>
 #include <csignal>
 #include <iostream>
 
+volatile sig_atomic_t sigint_received = 0;
+
 void handle_interrupt(int signum) {
     if (signum == SIGINT) {
-        emu->trap(TRAP_SIG_INT, 0);
+        sigint_received = 1;
+    }
+}
+
+static void read_batch_list(const char *list, std::vector<char *> *images) {
+    FILE *fp = fopen(list, "r");
+    if (fp == nullptr) {
+        printf("[Error] Cannot open batch list %s\n", list);
+        exit(1);
+    }
+    char line[4096];
+    while (fgets(line, sizeof(line), fp)) {
+        char *p = line + strspn(line, " \t");
+        p[strcspn(p, "\r\n")] = '\0';
+        if (*p == '\0' || *p == '#') {
+            continue;
+        }
+        images->push_back(strdup(p));
     }
+    fclose(fp);
 }
 
+enum {
+    OPT_UART_LOG = 256,
+    OPT_UART_INPUT,
+    OPT_UART_FLUSH,
+    OPT_MMIO_RECORD,
+    OPT_MMIO_REPLAY,
+    OPT_DEVICE,
+    OPT_BLK,
+    OPT_MEM_HASH,
+    OPT_HASH_STREAM,
+    OPT_TRACE_FROM,
+    OPT_MEM_TRACE,
+    OPT_COMMIT_TRACE,
+    OPT_WARMUP,
+    OPT_TELEMETRY,
+};
+
 EmuArgs parse_args(int argc, const char *argv[]) {
     EmuArgs args;
 
@@ -32,12 +77,31 @@ EmuArgs parse_args(int argc, const char *argv[]) {
         {"dump-trace", no_argument, NULL, 't'},
         {"difftest", required_argument, NULL, 'd'},
         {"fork-debug", no_argument, NULL, 'f'},
+        {"host-prof", no_argument, NULL, 'p'},
+        {"heartbeat", required_argument, NULL, 'H'},
+        {"output-dir", required_argument, NULL, 'o'},
+        {"jobs", required_argument, NULL, 'j'},
+        {"batch", required_argument, NULL, 'b'},
+        {"uart-log", required_argument, NULL, OPT_UART_LOG},
+        {"uart-input", required_argument, NULL, OPT_UART_INPUT},
+        {"uart-flush-ms", required_argument, NULL, OPT_UART_FLUSH},
+        {"mmio-record", required_argument, NULL, OPT_MMIO_RECORD},
+        {"mmio-replay", required_argument, NULL, OPT_MMIO_REPLAY},
+        {"device", required_argument, NULL, OPT_DEVICE},
+        {"blk", required_argument, NULL, OPT_BLK},
+        {"mem-hash", required_argument, NULL, OPT_MEM_HASH},
+        {"hash-stream", required_argument, NULL, OPT_HASH_STREAM},
+        {"trace-from", required_argument, NULL, OPT_TRACE_FROM},
+        {"mem-trace", required_argument, NULL, OPT_MEM_TRACE},
+        {"commit-trace", required_argument, NULL, OPT_COMMIT_TRACE},
+        {"warmup-inst", required_argument, NULL, OPT_WARMUP},
+        {"telemetry", required_argument, NULL, OPT_TELEMETRY},
         {0, 0, NULL, 0}
     };
 
     int opt;
 
-    while ((opt = getopt_long(argc, (char *const *)argv, "-c:i:d:wtf", table, NULL)) != -1) {
+    while ((opt = getopt_long(argc, (char *const *)argv, "-c:i:d:o:j:b:wtfpH:", table, NULL)) != -1) {
         switch (opt) {
             case 'c':
                 args.max_cycles = strtoull(optarg, NULL, 0);
@@ -46,44 +110,135 @@ EmuArgs parse_args(int argc, const char *argv[]) {
                 args.max_inst = strtoull(optarg, NULL, 0);
                 break;
             case 'w':
+#if VM_TRACE
                 args.dump_wave = true;
+#else
+                printf("[Warn] Waveform is not built into this model, -w is ignored\n");
+#endif
                 break;
             case 't':
                 args.dump_trace = true;
                 break;
             case 'd':{
                 args.enable_diff = true;
-                diff_ref_so = optarg;
+                args.diff_ref_so = optarg;
                 break;
             }
             case 'f':{
                 args.enable_fork = true;
                 break;
             }
+            case 'p':
+                args.host_prof = true;
+                break;
+            case 'H':
+                args.heartbeat_interval = strtoull(optarg, NULL, 0);
+                break;
+            case 'o':
+                args.output_dir = optarg;
+                break;
+            case 'j':
+                args.jobs = strtoull(optarg, NULL, 0);
+                break;
+            case 'b':
+                args.batch = true;
+                read_batch_list(optarg, &args.images);
+                break;
+            case OPT_UART_LOG:
+                args.uart_log = optarg;
+                break;
+            case OPT_UART_INPUT:
+                args.uart_input = optarg;
+                break;
+            case OPT_UART_FLUSH:
+                args.uart_flush_ms = strtoull(optarg, NULL, 0);
+                break;
+            case OPT_MMIO_RECORD:
+                args.mmio_record = optarg;
+                break;
+            case OPT_MMIO_REPLAY:
+                args.mmio_replay = optarg;
+                break;
+            case OPT_DEVICE:
+                args.device_plugins.push_back(optarg);
+                break;
+            case OPT_BLK:
+                args.blk_image = optarg;
+                break;
+            case OPT_MEM_HASH:
+                args.mem_hash_interval = strtoull(optarg, NULL, 0);
+                break;
+            case OPT_HASH_STREAM:
+                args.hash_interval = strtoull(optarg, NULL, 0);
+                break;
+            case OPT_TRACE_FROM:
+                args.trace_from = strtoull(optarg, NULL, 0);
+                break;
+            case OPT_MEM_TRACE:
+                args.mem_trace = optarg;
+                break;
+            case OPT_COMMIT_TRACE:
+                args.commit_trace = optarg;
+                break;
+            case OPT_WARMUP:
+                args.warmup_inst = strtoull(optarg, NULL, 0);
+                break;
+            case OPT_TELEMETRY:
+                args.telemetry_interval = strtoull(optarg, NULL, 0);
+                break;
             case 1:{
                 args.image = optarg;
+                args.images.push_back(optarg);
                 break;
             }
             default:
-                printf("Usage: %s [OPTION...] IMAGE\n", argv[0]);
+                printf("Usage: %s [OPTION...] IMAGE...\n", argv[0]);
                 printf("\t-c <max-cycles>         Run <max-cycles> cycles.\n");
                 printf("\t-i <max-inst>           Run <max-inst> instructions.\n");
                 printf("\t-w                      Dump waveform.\n");
                 printf("\t-t                      Dump trace.\n");
-                printf("\t-d <ref-so>             Enable diff.\n");
+                printf("\t-d <ref-so>             Enable diff, 'builtin' for the in-process REF.\n");
+                printf("\t-f                      Enable fork debug.\n");
+                printf("\t-p                      Report host time breakdown at exit.\n");
+                printf("\t-H <ms>                 Print a progress heartbeat to stderr every <ms>.\n");
+                printf("\t-o <dir>                Put waveform, trace and DRAMsim3 outputs in <dir>.\n");
+                printf("\t-j <jobs>               Run several images on <jobs> threads, one DUT each.\n");
+                printf("\t-b <list>               Run the images listed in <list>, reusing the DUT between them.\n");
+                printf("\t--uart-log <file>       Also write UART output to <file>.\n");
+                printf("\t--uart-input <file>     Feed UART input from <file>, or stdin for '-'.\n");
+                printf("\t--uart-flush-ms <ms>    Flush UART output from a background thread every <ms>.\n");
+                printf("\t--mmio-record <file>    Record every device read to <file>.\n");
+                printf("\t--mmio-replay <file>    Answer device reads from a recorded <file>.\n");
+                printf("\t--device <so>[:<arg>]   Load a device plugin, may be given several times.\n");
+                printf("\t--blk <file>[@<base>]   Attach <file> as a block device, at 0x%08x by default.\n", BLK_BASE);
+                printf("\t--mem-hash <cycles>     Compare a hash of all written memory with REF every <cycles>.\n");
+                printf("\t--hash-stream <instrs>  Write an arch state hash every <instrs> to archhash.log.\n");
+                printf("\t--trace-from <instr>    Trace every commit from instr <instr> on to trace-window.log.\n");
+                printf("\t--mem-trace <file>      Record every DRAM transaction to <file> for memreplay.\n");
+                printf("\t--commit-trace <file>   Record the commit stream to <file> for uarchsim.\n");
+                printf("\t--warmup-inst <n>       Start measurement after <n> instrs, see also the ROI markers.\n");
+                printf("\t--telemetry <cycles>    Publish live counters to /dev/shm every <cycles>, see telemon.py.\n");
                 exit(0);
         }
     }
 
     assert(!(args.enable_fork && args.dump_wave));
+    assert(!(args.enable_fork && args.images.size() > 1));
+    assert(!(args.batch && args.dump_wave));
+    assert(!(args.mmio_record && args.mmio_replay));
+    // a fork child would rewrite the logs from its snapshot
+    assert(!(args.enable_fork && (args.hash_interval || args.trace_from != (uint64_t)-1 ||
+        args.mem_trace || args.commit_trace)));
     return args;
 }
 
-Emulator::Emulator(int argc, const char *argv[])
-    : cycles(0), state(EMU_RUN), inst_count(0), nocmt_cycles(0) {
+Emulator::Emulator(const EmuArgs &emu_args)
+    : args(emu_args), cycles(0), state(EMU_RUN), inst_count(0), nocmt_cycles(0) {
+    emu = this;
     signal(SIGINT, handle_interrupt);
-    
-    args = parse_args(argc, argv);
+
+    prof.enable = args.host_prof;
+    prof.startup_begin();
 
     pc_rstvec = PC_RSTVEC;
 
@@ -97,19 +252,43 @@ Emulator::Emulator(int argc, const char *argv[])
 
     // context
     contx = new VerilatedContext;
+    Verilated::threadContextp(contx);
 
     // dut
     dut_ptr = new DUT_TOP(contx);
+    prof.startup_mark("model");
+
+    // DPI scopes of this model
+    rat_scope = svGetScopeFromName("TOP.SimTop.core.backend.rat.peeker");
+    assert(rat_scope);
+    rf_scope = svGetScopeFromName("TOP.SimTop.core.backend.regfile.peeker");
+    assert(rf_scope);
+    perf_scope = svGetScopeFromName("TOP.SimTop.perfBox.perf_ctrl_helper");
+    init_diff_scope();
 
     // device
-    init_device();
+    init_device(args.device_plugins);
+    if (args.blk_image) {
+        init_blkdev(args.blk_image);
+    }
+    uint64_t uart_flush_ms = args.uart_flush_ms;
+    if (uart_flush_ms && args.enable_fork) {
+        // the flusher thread would not survive fork()
+        printf("[Warn] UART flush thread is disabled with fork debug\n");
+        uart_flush_ms = 0;
+    }
+    std::string uart_log = args.uart_log ? output_path(args.uart_log) : "";
+    init_uart(args.uart_log ? uart_log.c_str() : nullptr, args.uart_input, uart_flush_ms);
+    std::string mmio_record = args.mmio_record ? output_path(args.mmio_record) : "";
+    init_mmio_log(args.mmio_record ? mmio_record.c_str() : nullptr, args.mmio_replay);
+    if (args.mem_trace) {
+        mem.mem_trace = memtrace_open(output_path(args.mem_trace).c_str());
+    }
+    prof.startup_mark("device");
 
     // wave
     if (args.dump_wave) {
-        Verilated::traceEverOn(true);
-        tfp = new VerilatedFstC;
-        dut_ptr->trace(tfp, 99);
-        tfp->open("waveform");
+        open_wave();
     }
 
     // lightSSS
@@ -120,28 +299,50 @@ Emulator::Emulator(int argc, const char *argv[])
 
     // memory
     long img_size = init_mem(args.image);
-    
-    // difftest
-    if (args.enable_diff) {
-        printf("[Info] Enable difftest.\n");
-        init_difftest(img_size, 1234);
-    }
+    prof.startup_mark("memory");
+
+    // DRAMsim3 and REF are not touched by the DUT under reset, so they
+    // are set up on a helper thread while reset runs
+    double loader_ms = 0;
+    std::thread loader([this, img_size, &loader_ms] {
+        emu = this;
+        struct timespec begin, end;
+        clock_gettime(CLOCK_MONOTONIC, &begin);
+        init_dram(args.output_dir);
+        if (args.enable_diff) {
+            printf("[Info] Enable difftest.\n");
+            init_difftest(args.diff_ref_so, args.image, img_size, 1234);
+            init_shadow_mem(img_size, args.mem_hash_interval);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        loader_ms = (end.tv_sec - begin.tv_sec) * 1e3 + (end.tv_nsec - begin.tv_nsec) / 1e6;
+    });
 
     // trace
     if (args.dump_trace) {
         printf("[Info] Enable trace dump.\n");
         trace_init();
     }
+    open_commit_logs();
+    if (args.telemetry_interval) {
+        telemetry_open(&telemetry, args.telemetry_interval, args.image);
+    }
 
     printf("Start simulation...\n");
 
     // reset
     printf("Reset DUT...\n");
     reset_ncycles(args.reset_cycles);
-    
+    prof.startup_mark("reset");
+
+    loader.join();
+    prof.startup_mark("wait-loader");
+    prof.startup_add("loader(dram+ref)", loader_ms);
+    prof.dump_startup();
 }
 
 Emulator::~Emulator() {
+    uart_flush();
     printf("-----------------------------------------------\n");
     switch (state) {
         case EMU_HIT_GOOD:
@@ -162,8 +363,7 @@ Emulator::~Emulator() {
     }
 
     if (args.dump_wave) {
-        tfp->close();
-        delete tfp;
+        close_wave();
     }
 
     if (args.enable_fork && !is_fork_child()) {
@@ -181,17 +381,39 @@ Emulator::~Emulator() {
     }
 
     if (args.dump_trace) {
-        trace_dump();
+        std::string trace_path = args.output_dir ? output_path("trace.log") : "./build/trace.log";
+        trace_dump(trace_path.c_str());
+    }
+
+    archhash_close(cycles);
+    cmttrace_close(cmt_trace);
+    cmt_trace = nullptr;
+    trace_window_close();
+
+    if (telemetry.page) {
+        telemetry_publish(&telemetry, cycles, inst_count, state);
+        telemetry_close(&telemetry);
     }
 
     dut_ptr->final();
 
     delete dut_ptr;
-    delete dram;
+    delete contx;
+    dram_stat_dump(roi_dram(), roi_cycles(), stderr);
+    free_mem();
+    free_device();
+    if (args.enable_diff) {
+        free_difftest();
+    }
 
     printf("===============================================\n");
-    printf("Total Cycles: %ld, Total Instrs: %ld\nIPC: %.5lf\n",
-        cycles, inst_count, (double)inst_count / cycles);
+    printf("Total Cycles: %ld, Total Instrs: %ld\n", cycles, inst_count);
+    if (roi.moved) {
+        printf("ROI Cycles: %ld, ROI Instrs: %ld\n", roi_cycles(), roi_insts());
+    }
+    printf("IPC: %.5lf\n", (double)roi_insts() / roi_cycles());
+
+    prof.dump();
 }
 
 inline void Emulator::reset_ncycles(size_t cycles) {
@@ -201,13 +423,13 @@ inline void Emulator::reset_ncycles(size_t cycles) {
 
         dut_ptr->eval();
         if (args.dump_wave) {
-            tfp->dump(2 * i);
+            wave_dump(2 * i);
         }
 
         dut_ptr->clock = 0;
         dut_ptr->eval();
         if (args.dump_wave) {
-            tfp->dump(2 * i + 1);
+            wave_dump(2 * i + 1);
         }
     }
     dut_ptr->clock = 1;
@@ -222,13 +444,19 @@ inline void Emulator::single_cycle() {
         return;
     }
 
-    dram->tick();
+    uint64_t t = prof.begin();
+    mem.dram->tick();
+    prof.end(PROF_DRAM, t);
 
+    t = prof.begin();
     dut_ptr->clock = 1;
     dut_ptr->eval();
+    prof.end(PROF_EVAL, t);
 
     if (args.dump_wave) {
-        tfp->dump(2 * cycles + 2 * args.reset_cycles);
+        t = prof.begin();
+        wave_dump(2 * cycles + 2 * args.reset_cycles);
+        prof.end(PROF_WAVE, t);
     }
 
     if (contx->gotFinish()) {
@@ -236,17 +464,28 @@ inline void Emulator::single_cycle() {
         return;
     }
 
+    t = prof.begin();
     dut_ptr->clock = 0;
     dut_ptr->eval();
+    prof.end(PROF_EVAL, t);
 
     if (args.dump_wave) {
-        tfp->dump(2 * cycles + 1 + 2 * args.reset_cycles);
+        t = prof.begin();
+        wave_dump(2 * cycles + 1 + 2 * args.reset_cycles);
+        prof.end(PROF_WAVE, t);
     }
 
     cycles++;
+
+    if (cycles >= devices.next_tick) {
+        device_tick(cycles);
+    }
 }
 
 void Emulator::trap(TrapCode trap_code, uint32_t trap_info) {
+    // keep guest output ahead of the status messages below
+    uart_flush();
+
     switch (trap_code) {
         case TRAP_MEM_ERR: {
             printf("[Error] Memory access error at address: 0x%08x\n", trap_info);
@@ -309,6 +548,11 @@ void Emulator::trap(TrapCode trap_code, uint32_t trap_info) {
             state = EMU_HIT_BAD;
             break;
         }
+        case TRAP_REPLAY_ERR: {
+            printf("[Error] MMIO replay diverged at address: 0x%08x\n", trap_info);
+            state = EMU_HIT_BAD;
+            break;
+        }
         default: {
             printf("[Error] Unknown trap code: %d, info: %d\n", trap_code, trap_info);
             state = EMU_HIT_BAD;
@@ -317,10 +561,133 @@ void Emulator::trap(TrapCode trap_code, uint32_t trap_info) {
     }
 }
 
+void Emulator::set_perf_clean(bool clean) {
+    if (perf_scope == nullptr) {
+        return;
+    }
+    svSetScope(perf_scope);
+    set_perf_ctrl_clean(clean);
+}
+
+void Emulator::set_perf_enable(bool enable) {
+    if (perf_scope == nullptr) {
+        return;
+    }
+    svSetScope(perf_scope);
+    set_perf_ctrl_enable(enable);
+}
+
+void Emulator::set_perf_dump(bool dump) {
+    if (perf_scope == nullptr) {
+        return;
+    }
+    svSetScope(perf_scope);
+    set_perf_ctrl_dump(dump);
+}
+
+// Start measuring after instr <insts>: PerfBox counters are cleaned on the
+// next cycle, and cycles, instrs and DRAM statistics count from here.
+void Emulator::roi_begin(uint64_t insts) {
+    printf("[Info] ROI begins at instr %lu, cycle %lu\n", insts, cycles);
+    set_perf_clean(true);
+    set_perf_enable(true);
+    roi.clean_pending = true;
+    roi.active = true;
+    roi.moved = true;
+    roi.begin_cycles = cycles;
+    roi.begin_insts = insts;
+    dram_stat_reset(&mem.dram_stats);
+}
+
+// Freeze the counters at instr <insts>, the rest of the run is not measured
+void Emulator::roi_end(uint64_t insts) {
+    if (!roi.active) {
+        return;
+    }
+    printf("[Info] ROI ends at instr %lu, cycle %lu\n", insts, cycles);
+    set_perf_enable(false);
+    roi.active = false;
+    roi.end_cycles = cycles;
+    roi.end_insts = insts;
+    roi.dram = mem.dram_stats;
+}
+
+// Run another image on the same model: reset the DUT in place and only
+// undo the memory, device, DRAM and REF state the previous image touched.
+void Emulator::restart(char *image, const char *output_dir) {
+    uart_flush();
+    if (args.dump_trace) {
+        std::string trace_path = output_path("trace.log");
+        trace_dump(trace_path.c_str());
+    }
+    printf("[Info] Batch: %s, Cycles: %lu, Instrs: %lu, IPC: %.5lf\n",
+        args.image ? args.image : "default", roi_cycles(), roi_insts(),
+        roi_cycles() ? (double)roi_insts() / roi_cycles() : 0.0);
+    if (state == EMU_HIT_BAD) {
+        status = 1;
+    }
+    dram_stat_dump(roi_dram(), roi_cycles(), stderr);
+    memtrace_close(mem.mem_trace);
+    mem.mem_trace = nullptr;
+
+    args.image = image;
+    args.output_dir = output_dir;
+    telemetry_set_image(&telemetry, image);
+    if (args.uart_log) {
+        uart_reopen(output_path(args.uart_log).c_str());
+    }
+    // each image records into its own directory, replay starts over
+    close_mmio_log();
+    std::string mmio_record = args.mmio_record ? output_path(args.mmio_record) : "";
+    init_mmio_log(args.mmio_record ? mmio_record.c_str() : nullptr, args.mmio_replay);
+    if (args.mem_trace) {
+        mem.mem_trace = memtrace_open(output_path(args.mem_trace).c_str());
+    }
+
+    printf("===================== EMU =====================\n");
+
+    clear_dirty_mem(args.enable_diff);
+    long img_size = load_image(args.image);
+    reset_device();
+
+    // same overlap as at startup
+    std::thread loader([this, img_size] {
+        emu = this;
+        reset_dram();
+        if (args.enable_diff) {
+            reset_difftest(args.image, img_size);
+            init_shadow_mem(img_size, args.mem_hash_interval);
+        }
+    });
+    if (args.dump_trace) {
+        trace_init();
+    }
+    archhash_close(cycles);
+    cmttrace_close(cmt_trace);
+    cmt_trace = nullptr;
+    trace_window_close();
+    open_commit_logs();
+
+    state = EMU_RUN;
+    cycles = 0;
+    inst_count = 0;
+    nocmt_cycles = 0;
+    memset(&npc_arch_sim_state, 0, sizeof(CPUState));
+    memset(&npc_arch_real_state, 0, sizeof(CPUState));
+    last_heartbeat_cycles = 0;
+    last_heartbeat_insts = 0;
+    roi = RoiWindow();
+
+    printf("Reset DUT...\n");
+    set_perf_clean(true);
+    set_perf_enable(true);
+    reset_ncycles(args.reset_cycles);
+    set_perf_clean(false);
+    loader.join();
+}
+
 void Emulator::get_npc_regfiles() {
-    svScope scope = svGetScopeFromName("TOP.SimTop.core.backend.rat.peeker");
-    assert(scope);
-    svSetScope(scope);
+    svSetScope(rat_scope);
 
     // Get RAT from NPC
     for (int i = 0; i < ARCH_REG_NUM; i++) {
@@ -330,9 +697,7 @@ void Emulator::get_npc_regfiles() {
         npc_uarch_state.rat[i] = (uint32_t)rat_val.aval;
     }
 
-    scope = svGetScopeFromName("TOP.SimTop.core.backend.regfile.peeker");
-    assert(scope);
-    svSetScope(scope);
+    svSetScope(rf_scope);
     // Get RF from NPC
     for (int i = 0; i < PHY_REG_NUM; i++) {
         set_rf_idx((svLogicVecVal *)&i);
@@ -350,6 +715,16 @@ void Emulator::get_npc_regfiles() {
 int Emulator::step() {
     single_cycle();
 
+    if (roi.clean_pending) {
+        set_perf_clean(false);
+        roi.clean_pending = false;
+    }
+    if (telemetry.sample_pending) {
+        set_perf_dump(false);
+        telemetry.sample_pending = false;
+        telemetry_publish(&telemetry, cycles, inst_count, state);
+    }
+
     if (state != EMU_RUN) {
         return 0;
     }
@@ -358,36 +733,77 @@ int Emulator::step() {
     int cmt_cnt = 0;
     diff_infos infos;
     for (int i = 0; i < COMMIT_WIDTH; i++){
-        if (get_diff_infos(&infos, i)) {
+        uint64_t t = prof.begin();
+        int valid = get_diff_infos(&infos, i);
+        prof.end(PROF_COMMIT, t);
+
+        if (valid) {
             cmt_cnt ++;
             npc_arch_sim_state.pc = infos.pc;
             npc_arch_real_state.pc = infos.pc;
+            if (infos.mem_en && IS_STORE(infos.instr)) {
+                mark_dirty(&mem, infos.mem_addr);
+            }
             if (infos.rf_wen) {
                 npc_arch_sim_state.gpr[infos.rf_waddr] = infos.rf_wdata;
             }
+            if (archhash.fp) {
+                archhash_commit(&infos, cycles);
+            }
+            if (tracer.window) {
+                trace_window(&infos, inst_count + cmt_cnt - 1);
+            }
+            if (cmt_trace) {
+                cmttrace_commit(cmt_trace, &infos, cycles);
+            }
+            if (infos.instr == ROI_BEGIN_INST) {
+                roi_begin(inst_count + cmt_cnt);
+            }
+            else if (infos.instr == ROI_END_INST) {
+                roi_end(inst_count + cmt_cnt - 1);
+            }
 
             if (args.dump_trace) {
+                t = prof.begin();
                 trace(infos.pc, infos.instr);
+                prof.end(PROF_TRACE, t);
             }
 
             if (args.enable_diff) {
+                t = prof.begin();
                 if (infos.mem_en && is_device(infos.mem_addr) != -1) {
-                    ref_difftest_regcpy(&npc_arch_sim_state, DIFFTEST_TO_REF);
+                    ref_regcpy(&diff, &npc_arch_sim_state, DIFFTEST_TO_REF);
                 } else {
                     diff_step();
+                    if (infos.mem_en && IS_STORE(infos.instr)) {
+                        diff_record_store(&infos);
+                    }
                     CPUState ref_arch_state;
-                    ref_difftest_regcpy(&ref_arch_state, DIFFTEST_TO_DUT);
+                    ref_regcpy(&diff, &ref_arch_state, DIFFTEST_TO_DUT);
                     diff_states(&ref_arch_state, 1);
                 }
+                prof.end(PROF_DIFF_REF, t);
             }
         }
     }
 
     if (args.enable_diff && cmt_cnt > 0) {
+        uint64_t t = prof.begin();
         get_npc_regfiles();
+        prof.end(PROF_REGFILE, t);
+
+        t = prof.begin();
         CPUState ref_arch_state;
-        ref_difftest_regcpy(&ref_arch_state, DIFFTEST_TO_DUT);
+        ref_regcpy(&diff, &ref_arch_state, DIFFTEST_TO_DUT);
         diff_states(&ref_arch_state, 0);
+        diff_check_stores();
+        prof.end(PROF_DIFF_REF, t);
+    }
+
+    if (diff.shadow && cycles >= diff.next_hash) {
+        uint64_t t = prof.begin();
+        diff_check_mem_hash();
+        prof.end(PROF_DIFF_REF, t);
     }
 
     if (cmt_cnt == 0) {
@@ -450,17 +866,25 @@ void Emulator::diff_states(CPUState *ref, bool is_sim_arch) {
 
 void Emulator::run() {
     printf("-----------------------------------------------\n");
+    prof.start();
+    last_heartbeat_time = uptime();
     for (;;) {
         if (state != EMU_RUN) {
             break;
         }
 
+        if (sigint_received) {
+            trap(TRAP_SIG_INT, 0);
+            break;
+        }
+
         if (args.enable_fork) {
-            static bool have_init_fork = false;
             uint32_t timer = uptime();
             if (((timer - lasttime_snapshot > args.fork_interval) || !have_init_fork) && !is_fork_child()) {
                 have_init_fork = true;
                 lasttime_snapshot = timer;
+                // the child must not replay buffered output
+                uart_flush();
                 switch (lightsss->do_fork()) {
                     case FORK_ERROR: assert(0);
                     case FORK_CHILD: fork_child_init();
@@ -481,6 +905,21 @@ void Emulator::run() {
 
         inst_count += step();
 
+        if (args.warmup_inst && !roi.warmed && inst_count >= args.warmup_inst) {
+            roi.warmed = true;
+            roi_begin(inst_count);
+        }
+
+        if (args.heartbeat_interval && (cycles & 0x3ff) == 0) {
+            heartbeat();
+        }
+
+        // counters are sampled on the next cycle and published by step()
+        if (telemetry.page && cycles >= telemetry.next && !telemetry.sample_pending && state == EMU_RUN) {
+            set_perf_dump(true);
+            telemetry.sample_pending = true;
+        }
+
         if (args.enable_fork && is_fork_child() && cycles != 0) {
             if (cycles == lightsss->get_end_cycles()) {
                 printf("[Info] checkpoint has reached the main process abort point: %lu\n", cycles);
@@ -491,15 +930,79 @@ void Emulator::run() {
     }
 }
 
-void Emulator::fork_child_init() {
-    printf("[Info] the oldest checkpoint start to dump wave ...\n");
-    dut_ptr->atClone();
+std::string Emulator::output_path(const char *name) {
+    if (args.output_dir == nullptr || name[0] == '/') {
+        return name;
+    }
+    return std::string(args.output_dir) + "/" + name;
+}
 
+// Hash stream, trace window and commit trace, restarted with every image
+void Emulator::open_commit_logs() {
+    if (args.hash_interval) {
+        std::string path = args.output_dir ? output_path("archhash.log") : "./build/archhash.log";
+        archhash_init(path.c_str(), args.hash_interval);
+    }
+    if (args.trace_from != (uint64_t)-1) {
+        std::string path = args.output_dir ? output_path("trace-window.log") : "./build/trace-window.log";
+        trace_window_open(path.c_str(), args.trace_from);
+    }
+    if (args.commit_trace) {
+        cmt_trace = cmttrace_open(output_path(args.commit_trace).c_str());
+    }
+}
+
+// Models built without --trace-fst (make fast) have no waveform support
+void Emulator::open_wave() {
+#if VM_TRACE
     Verilated::traceEverOn(true);
     tfp = new VerilatedFstC;
     dut_ptr->trace(tfp, 99);
-    tfp->open("waveform");
+    tfp->open(output_path("waveform").c_str());
+#else
+    printf("[Warn] Waveform is not built into this model\n");
+#endif
+}
+
+inline void Emulator::wave_dump(uint64_t time) {
+#if VM_TRACE
+    tfp->dump(time);
+#endif
+}
+
+void Emulator::close_wave() {
+#if VM_TRACE
+    tfp->close();
+    delete tfp;
+#endif
+}
+
+void Emulator::heartbeat() {
+    uint32_t now = uptime();
+    uint32_t elapsed = now - last_heartbeat_time;
+    if (elapsed < args.heartbeat_interval) {
+        return;
+    }
+
+    uint64_t win_cycles = cycles - last_heartbeat_cycles;
+    uint64_t win_insts = inst_count - last_heartbeat_insts;
+    fprintf(stderr, "[Heartbeat] cycles: %lu, instrs: %lu, IPC(window): %.5lf, KIPS: %.2lf\n",
+        cycles, inst_count, win_cycles ? (double)win_insts / win_cycles : 0.0,
+        (double)win_insts / elapsed);
+
+    last_heartbeat_time = now;
+    last_heartbeat_cycles = cycles;
+    last_heartbeat_insts = inst_count;
+}
+
+void Emulator::fork_child_init() {
+    printf("[Info] the oldest checkpoint start to dump wave ...\n");
+    dut_ptr->atClone();
+
+    open_wave();
 
     args.dump_wave = true;
     args.dump_trace = false;
+    // the telemetry page belongs to the parent
+    telemetry.page = nullptr;
 }
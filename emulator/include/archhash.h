@@ -0,0 +1,23 @@
+#ifndef __ARCHHASH_H__
+#define __ARCHHASH_H__
+
+#include <cstdint>
+#include <cstdio>
+#include "difftest.h"
+
+// Rolling hash of committed architectural effects (pc, rf writes, stores),
+// written as "<instrs> <cycles> <hash>" every interval instructions. Two
+// builds running the same image agree on every line until they diverge,
+// so scripts/archhash.py can find the first differing interval without REF.
+struct ArchHash {
+    FILE *fp = nullptr;
+    uint64_t interval = 0;
+    uint64_t count = 0;     // commits hashed so far
+    uint64_t hash = 0;
+};
+
+extern void archhash_init(const char *path, uint64_t interval);
+extern void archhash_commit(const diff_infos *infos, uint64_t cycles);
+extern void archhash_close(uint64_t cycles);
+
+#endif
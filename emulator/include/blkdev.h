@@ -0,0 +1,34 @@
+#ifndef __BLKDEV_H__
+#define __BLKDEV_H__
+
+#include <cstdint>
+
+// Block device backed by a host file. The guest picks a sector with
+// BLK_SECTOR and BLK_CMD_MAP, then reads the data window, which is served
+// straight from the mmap of the file. Guest writes land in a private copy
+// of the mapping and are dropped on reset; the host file is never changed.
+//
+// It must sit inside an uncached range of AddrSpace (UART by default), so
+// the DCache never keeps stale window contents.
+
+#define BLK_BASE        0x10001000
+#define BLK_REG_SIZE    0x1000
+#define BLK_SECTOR_SIZE 512
+#define BLK_WINDOW_SIZE 0x8000  // 64 sectors, at BLK_BASE + BLK_REG_SIZE
+
+// register offsets
+#define BLK_SECTOR      0x00    // RW: first sector of the window
+#define BLK_NSECTORS    0x04    // RO: sectors in the backing file
+#define BLK_WINDOW      0x08    // RO: window size in bytes
+#define BLK_CMD         0x0c    // WO: command below
+#define BLK_STATUS      0x10    // RO: status of the last command
+
+#define BLK_CMD_MAP     1       // move the window to BLK_SECTOR
+
+#define BLK_STATUS_OK   0
+#define BLK_STATUS_ERR  1       // sector out of range or unknown command
+
+// spec is <file>[@<base>]
+extern void init_blkdev(const char *spec);
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef __CMTTRACE_H__
+#define __CMTTRACE_H__
+
+#include <stdint.h>
+#include <stdio.h>
+
+// Binary commit stream written with --commit-trace, the input of the
+// trace-driven models in tools/. A header followed by one record per
+// committed instruction, in commit order.
+
+#define CMTTRACE_MAGIC   0x4354524d  // "MRTC"
+#define CMTTRACE_VERSION 1
+
+struct CmtTraceHeader {
+    uint32_t magic;
+    uint32_t version;
+};
+
+struct CmtTraceRecord {
+    uint32_t pc;
+    uint32_t inst;
+    uint32_t addr;      // word address of a load or store, 0 otherwise
+    uint32_t cycle;     // low bits of the commit cycle
+};
+
+struct diff_infos;
+
+extern FILE *cmttrace_open(const char *path);
+extern void cmttrace_commit(FILE *fp, const diff_infos *infos, uint64_t cycles);
+extern void cmttrace_close(FILE *fp);
+
+#endif
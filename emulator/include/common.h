@@ -1,6 +1,7 @@
 #ifndef __COMMON_H__
 #define __COMMON_H__
 
+#include <atomic>
 #include <cstdint>
 
 // Default Inst
@@ -16,7 +17,7 @@ static const char FontGreen[]   = "\033[1;32m";
 static const char FontBlue[]    = "\033[34m";
 static const char Restore[]     = "\033[0m";
 
-extern int status;
+extern std::atomic<int> status;
 extern uint32_t uptime();
 
 #define WAIT_INTERVAL 5
@@ -0,0 +1,49 @@
+#ifndef __DEVAPI_H__
+#define __DEVAPI_H__
+
+// Device API shared by built-in devices and device plugins. Plugins only
+// need this header: they are loaded with --device <so>[:<arg>] and reach
+// the emulator through the DeviceHost passed to their init entry.
+
+#include <stdint.h>
+
+#define DEVICE_API_VERSION 1
+#define DEVICE_NAME_LEN 16
+
+// Accesses are 32-bit: offset is word aligned, mask has one bit per byte
+typedef uint32_t (*dev_read_func)(void *opaque, uint32_t offset);
+typedef void (*dev_write_func)(void *opaque, uint32_t offset, uint32_t data, uint32_t mask);
+typedef void (*dev_tick_func)(void *opaque, uint64_t cycles);
+typedef void (*dev_reset_func)(void *opaque);
+typedef void (*dev_free_func)(void *opaque);
+
+typedef struct Device {
+    char name[DEVICE_NAME_LEN];
+    uint32_t base;
+    uint32_t size;
+    void *opaque;
+
+    dev_read_func read;
+    dev_write_func write;
+
+    // optional hooks, NULL when unused
+    dev_tick_func tick;
+    uint64_t tick_interval;     // cycles between two tick calls
+    dev_reset_func reset;
+    dev_free_func free;
+}Device;
+
+// Services the emulator offers to plugins
+typedef struct DeviceHost {
+    uint32_t version;
+    int (*register_device)(const Device *dev);  // -1 on failure
+    uint64_t (*get_cycles)(void);
+    void (*access_error)(uint32_t addr);        // stop with a memory access error
+}DeviceHost;
+
+// Entry exported by a plugin, called once per emulator instance, so all
+// state must hang off Device.opaque. Returns 0 on success.
+#define DEVICE_INIT_SYMBOL "erythrina_device_init"
+typedef int (*device_init_func)(const DeviceHost *host, const char *arg);
+
+#endif
@@ -2,17 +2,67 @@
 #define __DEVICE_H__
 
 #include <memory.h>
+#include "devapi.h"
+#include "uart.h"
+#include <cstdio>
+#include <vector>
 #define DEV_NUM 100
 
 #define SERIAL_BASE 0x10000000
+#define SERIAL_SIZE 0x10
 #define RTC_BASE    0x02000000
+#define RTC_SIZE    0x10
 
-extern void init_device();
+// Device table of one emulator instance
+struct DeviceCtx {
+    int dev_idx = 0;
+    Device dev[DEV_NUM];
+
+    // devices with a tick hook, and the nearest cycle any of them is due
+    int tick_num = 0;
+    int tick_dev[DEV_NUM];
+    uint64_t tick_due[DEV_NUM];
+    uint64_t next_tick = UINT64_MAX;
+
+    std::vector<void *> plugins;
+
+    UartCtx uart;
+    uint32_t read_byte = 0;     // byte offset in the word of the current read
+    uint32_t rtc_hi = 0;        // high half latched by a read of the low half
+    uint64_t boot_time = 0;
+
+    FILE *mmio_record = nullptr;
+    FILE *mmio_replay = nullptr;
+};
+
+// MMIO log: a header followed by one record per device read
+#define MMIO_LOG_MAGIC   0x4f494d4d  // "MMIO"
+#define MMIO_LOG_VERSION 1
+
+struct MmioLogHeader {
+    uint32_t magic;
+    uint32_t version;
+};
+
+struct MmioRecord {
+    uint32_t addr;
+    uint32_t data;
+};
+
+extern void init_device(const std::vector<const char *> &plugins);
+extern void init_mmio_log(const char *record, const char *replay);
+extern void close_mmio_log();
+extern void reset_device();
+extern void free_device();
 extern void init_serial();
 extern void init_timer();
 
+extern int register_device(const Device *dev);
+extern void load_device_plugin(const char *spec);
+
 extern int is_device(paddr_t addr);
 extern uint32_t device_read(paddr_t addr);
 extern uint32_t device_write(paddr_t addr, uint32_t data, uint32_t mask);
+extern void device_tick(uint64_t cycles);
 
-#endif
\ No newline at end of file
+#endif
@@ -2,11 +2,12 @@
 #define __DIFFTEST_H__
 
 #include "memory.h"
+#include "isa.h"
+#include "svdpi.h"
+#include "refcore.h"
 
 #define COMMIT_WIDTH 5
 
-extern const char *diff_ref_so;
-
 struct diff_infos {
     uint32_t pc;
     uint32_t instr;
@@ -21,17 +22,83 @@ struct diff_infos {
     uint32_t mem_mask;
 };
 
-void init_difftest(long img_size, int port);
-
 enum { DIFFTEST_TO_DUT, DIFFTEST_TO_REF };
 
-extern void (*ref_difftest_memcpy)(paddr_t addr, void *buf, int n, bool direction);
-extern void (*ref_difftest_regcpy)(void *dut, bool direction);
-extern void (*ref_difftest_exec)(uint32_t n);
-extern void (*ref_difftest_init)(int port);
+// glibc has 16 link-map namespaces (DL_NNS), the default one included, so
+// no more external REF copies can be loaded by one process
+#define MAX_REF_INSTANCES 16
+
+struct StoreCommit {
+    uint32_t pc;
+    uint32_t addr;  // word aligned
+    uint32_t data;  // already shifted to its byte lanes
+    uint32_t mask;
+};
+
+// REF handles and DUT commit port of one emulator instance
+struct DifftestCtx {
+    void *handle = nullptr;
+    RefCore *builtin = nullptr;     // -d builtin, the hooks below are unused
+
+    void (*ref_difftest_memcpy)(paddr_t addr, void *buf, int n, bool direction) = nullptr;
+    void (*ref_difftest_regcpy)(void *dut, bool direction) = nullptr;
+    void (*ref_difftest_exec)(uint32_t n) = nullptr;
+    void (*ref_difftest_init)(int port) = nullptr;
+    int port = 0;
+
+    svScope messager_scope = nullptr;
+
+    // stores committed in the current cycle, checked in one pass at its end
+    StoreCommit stores[COMMIT_WIDTH];
+    int store_num = 0;
+
+    // guest memory as seen by committed stores, DUT pmem lags behind the
+    // DCache, so the periodic hash check compares REF against this copy
+    uint8_t *shadow = nullptr;
+    uint64_t hash_interval = 0;
+    uint64_t next_hash = 0;
+};
+
+void init_difftest(const char *ref_so, const char *img, long img_size, int port);
+void reset_difftest(const char *img, long img_size);
+void free_difftest();
+void init_diff_scope();
+void init_shadow_mem(long img_size, uint64_t hash_interval);
+
+extern void diff_record_store(const diff_infos *infos);
+extern void diff_check_stores();
+extern void diff_check_mem_hash();
 
 extern void diff_step();
 
+// REF access, a direct call into the builtin REF when it is selected
+static inline void ref_memcpy(DifftestCtx *ctx, paddr_t addr, void *buf, int n, bool direction) {
+    if (ctx->builtin) {
+        refcore_memcpy(ctx->builtin, addr, buf, n, direction);
+    }
+    else {
+        ctx->ref_difftest_memcpy(addr, buf, n, direction);
+    }
+}
+
+static inline void ref_regcpy(DifftestCtx *ctx, void *dut, bool direction) {
+    if (ctx->builtin) {
+        refcore_regcpy(ctx->builtin, dut, direction);
+    }
+    else {
+        ctx->ref_difftest_regcpy(dut, direction);
+    }
+}
+
+static inline void ref_exec(DifftestCtx *ctx, uint32_t n) {
+    if (ctx->builtin) {
+        refcore_exec(ctx->builtin, n);
+    }
+    else {
+        ctx->ref_difftest_exec(n);
+    }
+}
+
 extern int get_diff_infos(diff_infos *infos, int req_idx);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,60 @@
+#ifndef __DRAMSTAT_H__
+#define __DRAMSTAT_H__
+
+#include <cstdint>
+#include <cstdio>
+
+#define DRAM_MAX_RANKS  8
+#define DRAM_MAX_BANKS  128     // ranks * bankgroups * banks_per_group
+#define DRAM_MAX_IDS    16      // AXI ids, each may have a request outstanding
+
+// Address fields of the DRAMsim3 config, decoded the way DRAMsim3 does
+enum { DRAM_CH, DRAM_RA, DRAM_BG, DRAM_BA, DRAM_RO, DRAM_CO, DRAM_FIELDS };
+
+struct DramGeometry {
+    int shift = 6;                  // log2 of the request size
+    int pos[DRAM_FIELDS] = {};
+    int width[DRAM_FIELDS] = {};
+    int ranks = 1;
+    int banks = 1;                  // per rank
+};
+
+// Request statistics seen at the mem_req/mem_rsp DPI layer. A request
+// waits in the queue from its first rejected mem_req until DRAMsim3
+// accepts it, and is in service from then until mem_rsp returns it.
+// Reads of different ids are outstanding together, so queueing is tracked
+// per id.
+// Row hits assume every bank keeps its last row open.
+struct DramStats {
+    DramGeometry geo;
+
+    bool pending[2][DRAM_MAX_IDS] = {};     // by is_write and id, a mem_req was rejected
+    uint64_t pending_since[2][DRAM_MAX_IDS] = {};
+
+    uint64_t reqs[2] = {};
+    uint64_t rejects[2] = {};
+    uint64_t queue_cycles[2] = {};
+    uint64_t service_cycles[2] = {};
+    uint64_t service_max[2] = {};
+
+    uint64_t row_hits = 0;
+    int64_t open_row[DRAM_MAX_BANKS];
+    uint64_t bank_reqs[DRAM_MAX_BANKS] = {};
+    uint64_t bank_busy[DRAM_MAX_BANKS] = {};
+    uint64_t rank_busy[DRAM_MAX_RANKS] = {};
+};
+
+// per-request bookkeeping, carried in the DRAMsim3 request meta
+struct DramReqInfo {
+    uint32_t addr;
+    uint64_t issue_cycle;   // first attempt, before any reject
+    uint64_t accept_cycle;
+};
+
+extern void dram_stat_init(DramStats *st, const char *config_file);
+extern void dram_stat_reset(DramStats *st);
+extern void dram_stat_req(DramStats *st, bool is_write, uint32_t id, bool accepted, uint64_t cycles, DramReqInfo *info);
+extern void dram_stat_rsp(DramStats *st, bool is_write, uint64_t cycles, const DramReqInfo *info);
+extern void dram_stat_dump(DramStats *st, uint64_t cycles, FILE *fp);
+
+#endif
@@ -1,14 +1,26 @@
 #ifndef __EMULATOR_H__
 #define __EMULATOR_H__
 
+#include <csignal>
 #include <cstdint>
+#include <string>
+#include <vector>
 #include "VSimTop.h"
 #include "isa.h"
+#include "memory.h"
+#include "device.h"
+#include "difftest.h"
+#include "trace.h"
+#include "archhash.h"
 #include "verilated.h"
 #include "lightsss.h"
+#include "profiler.h"
+#include "telemetry.h"
 
 #define DUT_TOP VSimTop
 
+class VerilatedFstC;
+
 #define TIMEOUT_CYCLES 15000
 
 #ifndef __SOC__
@@ -34,6 +46,7 @@ typedef enum{
     TRAP_HALT_HIT_CYCLE_BOUND,
     TRAP_SIG_INT,
     TRAP_SIM_STOP,
+    TRAP_REPLAY_ERR,
     TRAP_UNKNOWN,
 }TrapCode;
 
@@ -42,13 +55,54 @@ struct EmuArgs {
     uint64_t max_cycles = -1;
     uint64_t max_inst = -1;
     uint64_t fork_interval = 5000; // default: 5 seconds
+    uint64_t heartbeat_interval = 0; // ms, 0 for disable
+    uint64_t telemetry_interval = 0; // cycles between shm telemetry updates, 0 for disable
+
+    uint64_t mem_hash_interval = 0; // cycles, 0 for disable
+    uint64_t hash_interval = 0;     // instrs between arch hash lines, 0 for disable
+    uint64_t trace_from = -1;       // first instr of the full trace window
+    uint64_t warmup_inst = 0;       // instrs before measurement starts, 0 for disable
+
+    uint64_t jobs = 0; // instances run concurrently, 0 for one per image up to host cores
 
     char *image = nullptr;
+    std::vector<char *> images;
+    const char *output_dir = nullptr;
+    const char *diff_ref_so = nullptr;
+
+    const char *uart_log = nullptr;
+    const char *uart_input = nullptr;
+    uint64_t uart_flush_ms = 0; // 0 for flush on newline and full buffer only
+
+    const char *mmio_record = nullptr;
+    const char *mmio_replay = nullptr;
+    const char *mem_trace = nullptr;            // DRAM transaction trace for tools/memreplay
+    const char *commit_trace = nullptr;         // commit stream for tools/uarchsim
+
+    std::vector<const char *> device_plugins;   // <so>[:<arg>] of each --device
+    const char *blk_image = nullptr;            // <file>[@<base>] of --blk
+
+    bool batch = false; // reuse one DUT for all images of a thread
 
     bool dump_wave = false;
-    bool enable_diff = true;
+    bool enable_diff = false;   // set by -d, runs without REF otherwise
     bool dump_trace = false;
     bool enable_fork = false;
+    bool host_prof = false;
+};
+
+// Measured region: the whole run unless --warmup-inst or the guest ROI
+// markers move it. Cycles, instrs, PerfBox and DRAM statistics cover it alone.
+struct RoiWindow {
+    bool active = true;         // still counting, cleared by the end marker
+    bool moved = false;         // begin set by warm-up or a marker
+    bool warmed = false;        // --warmup-inst already applied
+    bool clean_pending = false; // PerfBox clean held for the next cycle
+    uint64_t begin_cycles = 0;
+    uint64_t begin_insts = 0;
+    uint64_t end_cycles = 0;
+    uint64_t end_insts = 0;
+    DramStats dram;             // DRAM statistics frozen at the end marker
 };
 
 struct MicroArchState {
@@ -69,31 +123,75 @@ private:
     uint64_t inst_count;
 
     uint32_t lasttime_snapshot = 0;
+    bool have_init_fork = false;
     uint64_t nocmt_cycles;
 
+    svScope rat_scope = nullptr;
+    svScope rf_scope = nullptr;
+    svScope perf_scope = nullptr;   // NULL when PerfBox is not elaborated
+
+    void set_perf_clean(bool clean);
+    void set_perf_enable(bool enable);
+    void set_perf_dump(bool dump);
+
+    RoiWindow roi;
+    void roi_begin(uint64_t insts);
+    void roi_end(uint64_t insts);
+    uint64_t roi_cycles() { return (roi.active ? cycles : roi.end_cycles) - roi.begin_cycles; }
+    uint64_t roi_insts() { return (roi.active ? inst_count : roi.end_insts) - roi.begin_insts; }
+    DramStats *roi_dram() { return roi.active ? &mem.dram_stats : &roi.dram; }
+
     CPUState npc_arch_sim_state;    // deduct from commit info
     CPUState npc_arch_real_state;   // read npc regfiles
     MicroArchState npc_uarch_state;
 
+    HostProfiler prof;
+
+    // heartbeat window
+    uint32_t last_heartbeat_time = 0;
+    uint64_t last_heartbeat_cycles = 0;
+    uint64_t last_heartbeat_insts = 0;
+
     inline void reset_ncycles(size_t cycles);
     inline void single_cycle();
+    void heartbeat();
 
     inline bool is_fork_child() {
         return lightsss->is_child();
     }
 
     void fork_child_init();
+    void open_wave();
+    inline void wave_dump(uint64_t time);
+    void close_wave();
+    void open_commit_logs();
+    std::string output_path(const char *name);
 
     uint32_t start_time;
 
 public:
-    Emulator(int argc, const char *argv[]);
+    Emulator(const EmuArgs &emu_args);
     ~Emulator();
     
     uint64_t pc_rstvec;
 
+    // per-instance state reached by DPI callbacks through emu
+    MemoryCtx mem;
+    DeviceCtx devices;
+    DifftestCtx diff;
+    TraceRing tracer;
+    ArchHash archhash;
+    FILE *cmt_trace = nullptr;
+    TelemetryCtx telemetry;
+
+    EmuState get_state() { return state; }
+    uint64_t get_cycles() { return cycles; }
+    uint64_t get_inst_count() { return inst_count; }
+
     void run();
 
+    void restart(char *image, const char *output_dir);
+
     void trap(TrapCode trap_code, uint32_t trap_info);
 
     void diff_states(CPUState *ref, bool is_sim_arch);
@@ -103,6 +201,12 @@ public:
     int step();
 };
 
-extern Emulator *emu;
+extern EmuArgs parse_args(int argc, const char *argv[]);
+
+// Every instance runs on its own thread, so DPI callbacks invoked from
+// eval() find their instance through this thread-local pointer.
+extern thread_local Emulator *emu;
+
+extern volatile sig_atomic_t sigint_received;
 
 #endif
\ No newline at end of file
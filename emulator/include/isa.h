@@ -6,6 +6,12 @@
 #define ARCH_REG_NUM 32
 #define PHY_REG_NUM 64
 
+#define IS_STORE(inst) (((inst) & 0x7f) == 0x23)
+
+// Region of interest markers, HINTs that write x0 and run as NOPs anywhere
+#define ROI_BEGIN_INST 0x00102013   // slti x0, x0, 1
+#define ROI_END_INST   0x00202013   // slti x0, x0, 2
+
 typedef struct{
     uint32_t gpr[ARCH_REG_NUM];
     uint32_t pc;
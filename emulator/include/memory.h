@@ -2,7 +2,9 @@
 #define __MEMORY_H__
 
 #include <cstdint>
+#include <cstdio>
 #include "cosimulation.h"
+#include "dramstat.h"
 typedef uint32_t paddr_t;
 
 #define MEMBASE     0x80000000               
@@ -17,10 +19,25 @@ typedef uint32_t paddr_t;
 #define SRAM_BASE   0x0f000000
 #define SRAM_SIZE   0x2000
 
-extern uint8_t pmem[MEMSIZE];
-extern uint8_t mrom[MROM_SIZE];
-extern uint8_t sram[SRAM_SIZE];
-extern uint8_t flash[FLASH_SIZE];
+#define PAGE_SHIFT  12
+#define PAGE_SIZE   (1 << PAGE_SHIFT)
+#define PMEM_PAGES  (MEMSIZE >> PAGE_SHIFT)
+
+// Guest memories and DRAM timing model of one emulator instance
+struct MemoryCtx {
+    uint8_t *pmem = nullptr;
+    uint8_t *mrom = nullptr;
+    uint8_t *sram = nullptr;
+    uint8_t *flash = nullptr;
+
+    CoDRAMsim3 *dram = nullptr;
+    uint64_t dram_inflight = 0;     // accepted requests not answered yet
+    DramStats dram_stats;
+    FILE *mem_trace = nullptr;
+
+    // pmem pages written by the image, the DUT or committed stores
+    uint64_t dirty[PMEM_PAGES / 64] = {};
+};
 
 static inline bool in_pmem(paddr_t addr){
     return addr >= MEMBASE && addr - MEMBASE < MEMSIZE;
@@ -39,15 +56,26 @@ static inline bool in_flash(paddr_t addr){
 }
 
 extern long init_mem(char *img);
+extern void init_dram(const char *dram_outdir);
+extern long load_image(char *img);
+extern void reset_dram();
+extern void clear_dirty_mem(bool sync_ref);
+extern void free_mem();
+
+static inline void mark_dirty(MemoryCtx *mem, paddr_t addr) {
+    if (in_pmem(addr)) {
+        uint32_t page = (addr - MEMBASE) >> PAGE_SHIFT;
+        mem->dirty[page / 64] |= 1UL << (page % 64);
+    }
+}
 
 extern uint8_t *guest2host(paddr_t paddr);
 extern uint32_t pmem_read(paddr_t addr);
 extern uint32_t pmem_write(paddr_t addr, uint32_t data, uint32_t mask);
 
-extern CoDRAMsim3 *dram;
-
 struct dramsim3_meta {
     uint32_t id;
+    DramReqInfo info;
 };
 
 #endif
\ No newline at end of file
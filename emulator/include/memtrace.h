@@ -0,0 +1,31 @@
+#ifndef __MEMTRACE_H__
+#define __MEMTRACE_H__
+
+#include <stdint.h>
+#include <stdio.h>
+
+// Binary trace of AXI4Memory transactions captured at the DPI boundary
+// with --mem-trace, and read back by tools/memreplay. A header followed
+// by one record per transaction, in completion order.
+
+#define MEMTRACE_MAGIC   0x4352544d  // "MTRC"
+#define MEMTRACE_VERSION 1
+
+struct MemTraceHeader {
+    uint32_t magic;
+    uint32_t version;
+};
+
+struct MemTraceRecord {
+    uint64_t cycle;     // first mem_req of the transaction
+    uint32_t addr;
+    uint16_t latency;   // cycles until mem_rsp, saturated
+    uint8_t id;
+    uint8_t is_write;
+};
+
+extern FILE *memtrace_open(const char *path);
+extern void memtrace_write(FILE *fp, uint64_t cycle, uint32_t addr, uint64_t latency, uint8_t id, bool is_write);
+extern void memtrace_close(FILE *fp);
+
+#endif
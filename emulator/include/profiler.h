@@ -0,0 +1,73 @@
+#ifndef __PROFILER_H__
+#define __PROFILER_H__
+
+#include <cstdint>
+#include <ctime>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Host-side cost buckets of the simulation loop
+typedef enum {
+    PROF_EVAL,
+    PROF_DRAM,
+    PROF_COMMIT,
+    PROF_DIFF_REF,
+    PROF_REGFILE,
+    PROF_TRACE,
+    PROF_WAVE,
+    PROF_NUM
+}ProfPhase;
+
+static inline uint64_t host_ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000UL + ts.tv_nsec;
+#endif
+}
+
+#define STARTUP_PHASES 16
+
+class HostProfiler {
+private:
+    uint64_t ticks[PROF_NUM] = {};
+    uint64_t calls[PROF_NUM] = {};
+
+    // wall clock and tick counter at start, used to calibrate the tick rate
+    uint64_t start_ticks = 0;
+    struct timespec start_ts = {};
+
+    // startup phases in wall clock, recorded even without -p
+    const char *startup_names[STARTUP_PHASES];
+    double startup_ms[STARTUP_PHASES];
+    int startup_num = 0;
+    struct timespec startup_begin_ts = {};
+    struct timespec startup_last_ts = {};
+
+public:
+    bool enable = false;
+
+    void start();
+    void dump();
+
+    void startup_begin();
+    void startup_mark(const char *phase);           // time since the last mark
+    void startup_add(const char *phase, double ms); // measured elsewhere, e.g. on a helper thread
+    void dump_startup();
+
+    inline uint64_t begin() {
+        return enable ? host_ticks() : 0;
+    }
+
+    inline void end(ProfPhase phase, uint64_t begin_ticks) {
+        if (enable) {
+            ticks[phase] += host_ticks() - begin_ticks;
+            calls[phase]++;
+        }
+    }
+};
+
+#endif
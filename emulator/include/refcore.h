@@ -0,0 +1,219 @@
+#ifndef __REFCORE_H__
+#define __REFCORE_H__
+
+#include <cstdint>
+#include <cstring>
+#include "isa.h"
+#include "memory.h"
+
+// Built-in RV32IM + Zicsr reference, selected with -d builtin. It covers
+// the instructions decoded by frontend/isa and the CSRs of backend/fu/CSR,
+// and runs in-process so the difftest loop calls it directly.
+
+#define REF_ICACHE_SIZE 4096    // predecoded entries, direct mapped by pc
+
+enum RefOp : uint8_t {
+    REF_INVALID,
+    REF_LUI, REF_AUIPC, REF_JAL, REF_JALR,
+    REF_BEQ, REF_BNE, REF_BLT, REF_BGE, REF_BLTU, REF_BGEU,
+    REF_LB, REF_LH, REF_LW, REF_LBU, REF_LHU,
+    REF_SB, REF_SH, REF_SW,
+    REF_ADDI, REF_SLTI, REF_SLTIU, REF_XORI, REF_ORI, REF_ANDI,
+    REF_SLLI, REF_SRLI, REF_SRAI,
+    REF_ADD, REF_SUB, REF_SLL, REF_SLT, REF_SLTU, REF_XOR, REF_SRL, REF_SRA, REF_OR, REF_AND,
+    REF_MUL, REF_MULH, REF_MULHSU, REF_MULHU, REF_DIV, REF_DIVU, REF_REM, REF_REMU,
+    REF_CSRRW, REF_CSRRS, REF_CSRRC,
+    REF_ECALL, REF_EBREAK, REF_MRET,
+};
+
+struct RefInst {
+    uint32_t pc;
+    uint32_t raw;       // entry is valid only while memory still holds it
+    RefOp op;
+    uint8_t rd;
+    uint8_t rs1;
+    uint8_t rs2;
+    int32_t imm;        // csr number for Zicsr
+};
+
+// CSR numbers, as in backend/fu/CSR.scala
+#define CSR_MSTATUS     0x300
+#define CSR_MTVEC       0x305
+#define CSR_MEPC        0x341
+#define CSR_MCAUSE      0x342
+#define CSR_MVENDORID   0xf11
+#define CSR_MARCHID     0xf12
+
+struct RefCore {
+    uint32_t gpr[ARCH_REG_NUM];
+    uint32_t pc;
+
+    uint32_t mstatus;
+    uint32_t mtvec;
+    uint32_t mepc;
+    uint32_t mcause;
+
+    uint8_t *mem;       // MEMSIZE bytes at MEMBASE, the image mapped copy-on-write
+    RefInst icache[REF_ICACHE_SIZE];
+    bool error;         // hit an instruction the core does not decode
+};
+
+extern RefCore *refcore_init(const char *img, long img_size);
+extern void refcore_reset(RefCore *ref, const char *img, long img_size);
+extern void refcore_free(RefCore *ref);
+extern void refcore_decode(RefInst *inst, uint32_t pc, uint32_t raw);
+extern void refcore_memcpy(RefCore *ref, paddr_t addr, void *buf, int n, bool direction);
+extern void refcore_regcpy(RefCore *ref, void *dut, bool direction);
+
+static inline uint8_t *ref_guest(RefCore *ref, paddr_t addr, int len) {
+    if (addr >= MEMBASE && addr - MEMBASE <= MEMSIZE - len) {
+        return ref->mem + addr - MEMBASE;
+    }
+    return nullptr;
+}
+
+static inline uint32_t ref_load(RefCore *ref, paddr_t addr, int len) {
+    uint32_t data = 0;
+    uint8_t *p = ref_guest(ref, addr, len);
+    if (p) {
+        memcpy(&data, p, len);
+    }
+    return data;
+}
+
+static inline void ref_store(RefCore *ref, paddr_t addr, uint32_t data, int len) {
+    uint8_t *p = ref_guest(ref, addr, len);
+    if (p) {
+        memcpy(p, &data, len);
+    }
+}
+
+static inline uint32_t ref_csr_read(RefCore *ref, uint32_t csr) {
+    switch (csr) {
+    case CSR_MSTATUS:   return ref->mstatus;
+    case CSR_MTVEC:     return ref->mtvec;
+    case CSR_MEPC:      return ref->mepc;
+    case CSR_MCAUSE:    return ref->mcause;
+    case CSR_MVENDORID: return 0x79737978;
+    case CSR_MARCHID:   return 0x1d4b42;
+    default:            return 0;
+    }
+}
+
+static inline void ref_csr_write(RefCore *ref, uint32_t csr, uint32_t data) {
+    switch (csr) {
+    case CSR_MSTATUS:   ref->mstatus = data; break;
+    case CSR_MTVEC:     ref->mtvec = data; break;
+    case CSR_MEPC:      ref->mepc = data; break;
+    case CSR_MCAUSE:    ref->mcause = data; break;
+    default:            break;
+    }
+}
+
+static inline void refcore_exec_one(RefCore *ref) {
+    uint32_t pc = ref->pc;
+    uint32_t raw = ref_load(ref, pc, 4);
+    RefInst *inst = &ref->icache[(pc >> 2) & (REF_ICACHE_SIZE - 1)];
+    if (inst->pc != pc || inst->raw != raw || inst->op == REF_INVALID) {
+        refcore_decode(inst, pc, raw);
+    }
+
+    uint32_t *R = ref->gpr;
+    uint32_t src1 = R[inst->rs1];
+    uint32_t src2 = R[inst->rs2];
+    uint32_t imm = inst->imm;
+    uint32_t npc = pc + 4;
+    uint32_t res = 0;
+    bool wen = true;
+
+    switch (inst->op) {
+    case REF_LUI:   res = imm; break;
+    case REF_AUIPC: res = pc + imm; break;
+    case REF_JAL:   res = npc; npc = pc + imm; break;
+    case REF_JALR:  res = npc; npc = (src1 + imm) & ~1u; break;
+
+    case REF_BEQ:   wen = false; if (src1 == src2) npc = pc + imm; break;
+    case REF_BNE:   wen = false; if (src1 != src2) npc = pc + imm; break;
+    case REF_BLT:   wen = false; if ((int32_t)src1 < (int32_t)src2) npc = pc + imm; break;
+    case REF_BGE:   wen = false; if ((int32_t)src1 >= (int32_t)src2) npc = pc + imm; break;
+    case REF_BLTU:  wen = false; if (src1 < src2) npc = pc + imm; break;
+    case REF_BGEU:  wen = false; if (src1 >= src2) npc = pc + imm; break;
+
+    case REF_LB:    res = (int8_t)ref_load(ref, src1 + imm, 1); break;
+    case REF_LH:    res = (int16_t)ref_load(ref, src1 + imm, 2); break;
+    case REF_LW:    res = ref_load(ref, src1 + imm, 4); break;
+    case REF_LBU:   res = ref_load(ref, src1 + imm, 1); break;
+    case REF_LHU:   res = ref_load(ref, src1 + imm, 2); break;
+
+    case REF_SB:    wen = false; ref_store(ref, src1 + imm, src2, 1); break;
+    case REF_SH:    wen = false; ref_store(ref, src1 + imm, src2, 2); break;
+    case REF_SW:    wen = false; ref_store(ref, src1 + imm, src2, 4); break;
+
+    case REF_ADDI:  res = src1 + imm; break;
+    case REF_SLTI:  res = (int32_t)src1 < (int32_t)imm; break;
+    case REF_SLTIU: res = src1 < imm; break;
+    case REF_XORI:  res = src1 ^ imm; break;
+    case REF_ORI:   res = src1 | imm; break;
+    case REF_ANDI:  res = src1 & imm; break;
+    case REF_SLLI:  res = src1 << (imm & 0x1f); break;
+    case REF_SRLI:  res = src1 >> (imm & 0x1f); break;
+    case REF_SRAI:  res = (int32_t)src1 >> (imm & 0x1f); break;
+
+    case REF_ADD:   res = src1 + src2; break;
+    case REF_SUB:   res = src1 - src2; break;
+    case REF_SLL:   res = src1 << (src2 & 0x1f); break;
+    case REF_SLT:   res = (int32_t)src1 < (int32_t)src2; break;
+    case REF_SLTU:  res = src1 < src2; break;
+    case REF_XOR:   res = src1 ^ src2; break;
+    case REF_SRL:   res = src1 >> (src2 & 0x1f); break;
+    case REF_SRA:   res = (int32_t)src1 >> (src2 & 0x1f); break;
+    case REF_OR:    res = src1 | src2; break;
+    case REF_AND:   res = src1 & src2; break;
+
+    case REF_MUL:   res = src1 * src2; break;
+    case REF_MULH:  res = ((int64_t)(int32_t)src1 * (int64_t)(int32_t)src2) >> 32; break;
+    case REF_MULHSU:res = ((int64_t)(int32_t)src1 * (int64_t)(uint64_t)src2) >> 32; break;
+    case REF_MULHU: res = ((uint64_t)src1 * (uint64_t)src2) >> 32; break;
+    case REF_DIV:
+        if (src2 == 0) res = -1;
+        else if (src1 == 0x80000000 && src2 == 0xffffffff) res = src1;
+        else res = (int32_t)src1 / (int32_t)src2;
+        break;
+    case REF_DIVU:  res = src2 == 0 ? 0xffffffff : src1 / src2; break;
+    case REF_REM:
+        if (src2 == 0) res = src1;
+        else if (src1 == 0x80000000 && src2 == 0xffffffff) res = 0;
+        else res = (int32_t)src1 % (int32_t)src2;
+        break;
+    case REF_REMU:  res = src2 == 0 ? src1 : src1 % src2; break;
+
+    case REF_CSRRW: res = ref_csr_read(ref, imm); ref_csr_write(ref, imm, src1); break;
+    case REF_CSRRS: res = ref_csr_read(ref, imm); ref_csr_write(ref, imm, res | src1); break;
+    case REF_CSRRC: res = ref_csr_read(ref, imm); ref_csr_write(ref, imm, res & ~src1); break;
+
+    // the core keeps mstatus untouched on trap and return
+    case REF_ECALL: wen = false; ref->mepc = pc; ref->mcause = 11; npc = ref->mtvec; break;
+    case REF_MRET:  wen = false; npc = ref->mepc; break;
+    case REF_EBREAK:wen = false; break;
+
+    default:
+        wen = false;
+        npc = pc;
+        ref->error = true;
+        break;
+    }
+
+    if (wen) {
+        R[inst->rd] = res;
+    }
+    R[0] = 0;
+    ref->pc = npc;
+}
+
+static inline void refcore_exec(RefCore *ref, uint32_t n) {
+    for (uint32_t i = 0; i < n; i++) {
+        refcore_exec_one(ref);
+    }
+}
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef __TELEMETRY_H__
+#define __TELEMETRY_H__
+
+#include <cstdint>
+
+// Live counters published with --telemetry to a POSIX shared memory page,
+// /dev/shm/erythrina-<pid>-<n>, refreshed every interval cycles. Readers
+// such as scripts/telemon.py never block the writer: seq is odd while an
+// update is in flight, so a copy taken between two equal even reads of seq
+// is consistent.
+
+#define TELEMETRY_MAGIC    0x4d4c4554  // "TELM"
+#define TELEMETRY_VERSION  1
+#define TELEMETRY_COUNTERS 256
+#define TELEMETRY_NAME_LEN 48
+
+struct TelemetryCounter {
+    char name[TELEMETRY_NAME_LEN];
+    uint64_t value;
+};
+
+struct TelemetryPage {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;              // sizeof(TelemetryPage)
+    uint32_t pid;
+    uint64_t seq;
+
+    char image[256];
+    uint64_t cycles;
+    uint64_t instrs;
+    double ipc;                 // whole run so far
+    double ipc_window;          // since the previous update
+    double kips;                // host speed since the previous update
+    uint64_t host_ms;           // uptime of the emulator at this update
+    uint32_t state;             // EmuState
+    uint32_t ncounters;
+    uint64_t counter_cycles;    // cycle of the PerfBox snapshot below
+    TelemetryCounter counters[TELEMETRY_COUNTERS];
+};
+
+struct TelemetryCtx {
+    TelemetryPage *page = nullptr;
+    char path[64] = {};
+    uint64_t interval = 0;
+    uint64_t next = 0;          // cycle of the next update
+    bool sample_pending = false;
+
+    // PerfBox snapshot, filled by perf_sample() during eval()
+    uint32_t nsamples = 0;
+    uint64_t sample_cycles = 0;
+    TelemetryCounter samples[TELEMETRY_COUNTERS];
+
+    uint64_t last_cycles = 0;
+    uint64_t last_instrs = 0;
+    uint32_t last_ms = 0;
+};
+
+extern void telemetry_open(TelemetryCtx *tm, uint64_t interval, const char *image);
+extern void telemetry_set_image(TelemetryCtx *tm, const char *image);
+extern void telemetry_publish(TelemetryCtx *tm, uint64_t cycles, uint64_t instrs, uint32_t state);
+extern void telemetry_close(TelemetryCtx *tm);
+
+#endif
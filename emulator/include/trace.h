@@ -2,12 +2,36 @@
 #define __TRACE_H__
 
 #include <cstdint>
+#include <cstdio>
+#include "difftest.h"
+
+#define IRINGBUF_LEN 1000
+
+struct TraceEntry {
+    uint32_t pc;
+    uint32_t inst;
+};
+
+// Instruction ring buffer of one emulator instance, disassembled at dump
+struct TraceRing {
+    TraceEntry irbuf[IRINGBUF_LEN];
+    int irbuf_ptr;
+    int irbuf_valid[IRINGBUF_LEN];
+    char inst_disasm[100];
+
+    // full trace of every commit from window_from on
+    FILE *window = nullptr;
+    uint64_t window_from = 0;
+};
 
 extern void trace_init();
 extern void trace(uint32_t pc, uint32_t inst);
-extern void trace_dump();
+extern void trace_dump(const char *path);
+extern void trace_window_open(const char *path, uint64_t from);
+extern void trace_window(const diff_infos *infos, uint64_t idx);
+extern void trace_window_close();
 
 extern "C" void init_disasm(const char *triple);
 extern "C" void disassemble(char *str, int size, uint64_t pc, uint8_t *code, int nbyte);
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,46 @@
+#ifndef __UART_H__
+#define __UART_H__
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#define UART_BUF_SIZE   4096
+
+// 16550-style register offsets used by the serial device
+#define UART_RBR        0   // read: receive buffer, write: transmit holding
+#define UART_LSR        5
+#define UART_LSR_DR     0x01
+#define UART_LSR_THRE   0x20
+#define UART_LSR_TEMT   0x40
+
+// Guest console of one emulator instance
+struct UartCtx {
+    std::mutex lock;
+    char buf[UART_BUF_SIZE];
+    size_t len = 0;
+    FILE *capture = nullptr;
+
+    // background flusher
+    std::thread flusher;
+    std::condition_variable cv;
+    bool stop = false;
+    uint64_t flush_ms = 0;
+
+    // receive queue, or the process-wide stdin queue
+    std::deque<uint8_t> input;
+    bool use_stdin = false;
+};
+
+extern void init_uart(const char *capture, const char *input, uint64_t flush_ms);
+extern void uart_reopen(const char *capture);
+extern void uart_putc(char c);
+extern int uart_getc();
+extern bool uart_rx_ready();
+extern void uart_flush();
+extern void free_uart();
+
+#endif
@@ -1,12 +1,113 @@
 #include "emu.h"
+#include "common.h"
+#include <algorithm>
 #include <cassert>
 #include <cstdlib>
-Emulator *emu = nullptr;
-int status = 0;
+#include <cstring>
+#include <libgen.h>
+#include <mutex>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+
+thread_local Emulator *emu = nullptr;
+std::atomic<int> status(0);
+
+struct InstanceResult {
+    EmuState state;
+    uint64_t cycles;
+    uint64_t inst_count;
+};
+
+static const char *state_name(EmuState state) {
+    switch (state) {
+        case EMU_HIT_GOOD: return "Good";
+        case EMU_HIT_BAD: return "Bad";
+        case EMU_HIT_BREAK: return "Break";
+        case EMU_HIT_INTERRUPT: return "Interrupt";
+        default: return "Unknown";
+    }
+}
+
+// Run every image on its own DUT, <jobs> instances at a time in this process.
+// In batch mode each thread keeps one DUT and restarts it for the next image.
+static void run_instances(const EmuArgs &args) {
+    size_t n = args.images.size();
+    size_t jobs = args.jobs ? args.jobs : std::thread::hardware_concurrency();
+    jobs = std::max<size_t>(1, std::min(jobs, n));
+
+    // every thread loads its own copy of an external REF
+    bool ext_ref = args.enable_diff && args.diff_ref_so && strcmp(args.diff_ref_so, "builtin") != 0;
+    if (ext_ref && jobs > MAX_REF_INSTANCES) {
+        printf("[Warn] At most %d copies of %s can be loaded, run on %d threads\n",
+            MAX_REF_INSTANCES, args.diff_ref_so, MAX_REF_INSTANCES);
+        jobs = MAX_REF_INSTANCES;
+    }
+
+    // outputs of each instance go to <output-dir>/<idx>-<image>
+    std::string base = args.output_dir ? args.output_dir : "build";
+    mkdir(base.c_str(), 0755);
+    std::vector<std::string> out_dirs(n);
+    for (size_t i = 0; i < n; i++) {
+        std::string image = args.images[i];
+        out_dirs[i] = base + "/" + std::to_string(i) + "-" + basename(&image[0]);
+        mkdir(out_dirs[i].c_str(), 0755);
+    }
+
+    printf("[Info] Run %lu images on %lu threads\n", n, jobs);
+
+    std::vector<InstanceResult> results(n);
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+        Emulator *inst = nullptr;
+        for (size_t i = next++; i < n; i = next++) {
+            EmuArgs inst_args = args;
+            inst_args.image = args.images[i];
+            inst_args.output_dir = out_dirs[i].c_str();
+
+            if (inst == nullptr) {
+                inst = new Emulator(inst_args);
+            }
+            else {
+                inst->restart(inst_args.image, inst_args.output_dir);
+            }
+            inst->run();
+            results[i] = {inst->get_state(), inst->get_cycles(), inst->get_inst_count()};
+
+            if (!args.batch) {
+                delete inst;
+                inst = nullptr;
+            }
+        }
+        delete inst;
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < jobs; i++) {
+        threads.emplace_back(worker);
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+
+    printf("===================== SUM =====================\n");
+    for (size_t i = 0; i < n; i++) {
+        printf("%-10s IPC: %.5lf, Cycles: %lu, %s\n", state_name(results[i].state),
+            results[i].cycles ? (double)results[i].inst_count / results[i].cycles : 0.0,
+            results[i].cycles, args.images[i]);
+    }
+}
 
 int main(int argc, const char *argv[]) {
-    emu = new Emulator(argc, argv);
+    EmuArgs args = parse_args(argc, argv);
+
+    if (args.images.size() > 1) {
+        run_instances(args);
+        exit(status);
+    }
+
+    emu = new Emulator(args);
     emu->run();
     delete emu;
     exit(status);
-}
\ No newline at end of file
+}
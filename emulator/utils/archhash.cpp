@@ -0,0 +1,51 @@
+#include "archhash.h"
+#include "emu.h"
+#include <cassert>
+
+#define ARCHHASH_SEED 0xcbf29ce484222325UL
+
+static inline uint64_t mix(uint64_t h, uint64_t v) {
+    h = (h ^ v) * 0x100000001b3UL;
+    return h ^ (h >> 29);
+}
+
+void archhash_init(const char *path, uint64_t interval) {
+    ArchHash *ah = &emu->archhash;
+    ah->fp = fopen(path, "w");
+    assert(ah->fp);
+    ah->interval = interval;
+    ah->count = 0;
+    ah->hash = ARCHHASH_SEED;
+    printf("[Info] Write arch state hash every %lu instrs to %s\n", interval, path);
+}
+
+void archhash_commit(const diff_infos *infos, uint64_t cycles) {
+    ArchHash *ah = &emu->archhash;
+    uint64_t h = mix(ah->hash, infos->pc);
+    // x0 writes have no architectural effect, whether the core reports them or not
+    if (infos->rf_wen && infos->rf_waddr != 0) {
+        h = mix(h, (uint64_t)infos->rf_waddr << 32 | infos->rf_wdata);
+    }
+    if (infos->mem_en && IS_STORE(infos->instr)) {
+        h = mix(h, (uint64_t)infos->mem_mask << 32 | infos->mem_addr);
+        h = mix(h, infos->mem_data);
+    }
+    ah->hash = h;
+
+    if (++ah->count % ah->interval == 0) {
+        fprintf(ah->fp, "%lu %lu %016lx\n", ah->count, cycles, h);
+    }
+}
+
+void archhash_close(uint64_t cycles) {
+    ArchHash *ah = &emu->archhash;
+    if (ah->fp == nullptr) {
+        return;
+    }
+    // last partial interval, so runs that stop early still differ
+    if (ah->count % ah->interval != 0) {
+        fprintf(ah->fp, "%lu %lu %016lx\n", ah->count, cycles, ah->hash);
+    }
+    fclose(ah->fp);
+    ah->fp = nullptr;
+}
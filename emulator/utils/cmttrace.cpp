@@ -0,0 +1,30 @@
+#include "cmttrace.h"
+#include "difftest.h"
+#include <cassert>
+
+#define CMTTRACE_BUF_SIZE (1 << 20)
+
+FILE *cmttrace_open(const char *path) {
+    FILE *fp = fopen(path, "wb");
+    assert(fp);
+    setvbuf(fp, NULL, _IOFBF, CMTTRACE_BUF_SIZE);
+    CmtTraceHeader header = {CMTTRACE_MAGIC, CMTTRACE_VERSION};
+    fwrite(&header, sizeof(header), 1, fp);
+    printf("[Info] Record commit stream to %s\n", path);
+    return fp;
+}
+
+void cmttrace_commit(FILE *fp, const diff_infos *infos, uint64_t cycles) {
+    CmtTraceRecord rec;
+    rec.pc = infos->pc;
+    rec.inst = infos->instr;
+    rec.addr = infos->mem_en ? infos->mem_addr : 0;
+    rec.cycle = cycles;
+    fwrite(&rec, sizeof(rec), 1, fp);
+}
+
+void cmttrace_close(FILE *fp) {
+    if (fp) {
+        fclose(fp);
+    }
+}
@@ -5,13 +5,11 @@
 #include "common.h"
 
 ForkShareMemory::ForkShareMemory() {
-    // Generate A key for shared memory
-    if ((key_n == ftok(".", 's')) < 0) {
-        std::cout << "Fail to ftok()" << std::endl;
-        assert(0);
-    }
+    // The segment is only shared with forked children, so a private key
+    // keeps concurrent simulations in the same directory apart
+    key_n = IPC_PRIVATE;
 
-    // Create or get a shared memory segment
+    // Create a shared memory segment
     if ((shm_id = shmget(key_n, 1024, 0666 | IPC_CREAT)) == -1) {
         std::cout << "Fail to shmget()" << std::endl;
         assert(0);
@@ -26,6 +24,8 @@ ForkShareMemory::ForkShareMemory() {
     else {
         info = (shinfo *)ret;
     }
+    // freed once the last attached process is gone, even a killed one
+    shmctl(shm_id, IPC_RMID, NULL);
 
     info->flag = false;
     info->notgood = false;
@@ -39,7 +39,6 @@ ForkShareMemory::~ForkShareMemory() {
         std::cout << "Fail to shmdt()" << std::endl;
         assert(0);
     }
-    shmctl(shm_id, IPC_RMID, NULL);
 }
 
 void ForkShareMemory::shwait() {
@@ -0,0 +1,70 @@
+#include "profiler.h"
+#include <cstdio>
+
+static const char *phase_names[PROF_NUM] = {
+    "eval", "dram", "commit", "diff-ref", "regfile", "trace", "wave"
+};
+
+static double ts_diff(struct timespec *begin, struct timespec *end) {
+    return (end->tv_sec - begin->tv_sec) + (end->tv_nsec - begin->tv_nsec) / 1e9;
+}
+
+void HostProfiler::start() {
+    clock_gettime(CLOCK_MONOTONIC, &start_ts);
+    start_ticks = host_ticks();
+}
+
+void HostProfiler::dump() {
+    if (!enable) {
+        return;
+    }
+
+    struct timespec end_ts;
+    clock_gettime(CLOCK_MONOTONIC, &end_ts);
+    uint64_t total = host_ticks() - start_ticks;
+    double wall = ts_diff(&start_ts, &end_ts);
+    if (total == 0 || wall <= 0) {
+        return;
+    }
+    double sec_per_tick = wall / total;
+
+    printf("Host time breakdown (%.3lf s):\n", wall);
+    uint64_t accounted = 0;
+    for (int i = 0; i < PROF_NUM; i++) {
+        accounted += ticks[i];
+        printf("  %-10s %10.3lf s  %6.2lf%%  %12lu calls\n",
+            phase_names[i], ticks[i] * sec_per_tick, 100.0 * ticks[i] / total, calls[i]);
+    }
+    uint64_t other = total > accounted ? total - accounted : 0;
+    printf("  %-10s %10.3lf s  %6.2lf%%\n", "other", other * sec_per_tick, 100.0 * other / total);
+}
+
+void HostProfiler::startup_begin() {
+    clock_gettime(CLOCK_MONOTONIC, &startup_begin_ts);
+    startup_last_ts = startup_begin_ts;
+    startup_num = 0;
+}
+
+void HostProfiler::startup_mark(const char *phase) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    startup_add(phase, ts_diff(&startup_last_ts, &now) * 1e3);
+    startup_last_ts = now;
+}
+
+void HostProfiler::startup_add(const char *phase, double ms) {
+    if (startup_num < STARTUP_PHASES) {
+        startup_names[startup_num] = phase;
+        startup_ms[startup_num] = ms;
+        startup_num++;
+    }
+}
+
+// One line, so runs can be compared across releases with grep
+void HostProfiler::dump_startup() {
+    printf("[Startup]");
+    for (int i = 0; i < startup_num; i++) {
+        printf(" %s: %.2lf ms,", startup_names[i], startup_ms[i]);
+    }
+    printf(" total: %.2lf ms\n", ts_diff(&startup_begin_ts, &startup_last_ts) * 1e3);
+}
@@ -0,0 +1,97 @@
+#include "telemetry.h"
+#include "common.h"
+#include <atomic>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+static std::atomic<int> telemetry_instances(0);
+
+void telemetry_open(TelemetryCtx *tm, uint64_t interval, const char *image) {
+    snprintf(tm->path, sizeof(tm->path), "/erythrina-%d-%d", getpid(), telemetry_instances++);
+    int fd = shm_open(tm->path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        printf("[Warn] Cannot create telemetry page %s, telemetry is disabled\n", tm->path);
+        return;
+    }
+    void *p = MAP_FAILED;
+    if (ftruncate(fd, sizeof(TelemetryPage)) == 0) {
+        p = mmap(NULL, sizeof(TelemetryPage), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (p == MAP_FAILED) {
+        printf("[Warn] Cannot map telemetry page %s, telemetry is disabled\n", tm->path);
+        shm_unlink(tm->path);
+        return;
+    }
+
+    tm->page = (TelemetryPage *)p;
+    tm->page->size = sizeof(TelemetryPage);
+    tm->page->pid = getpid();
+    tm->page->version = TELEMETRY_VERSION;
+    tm->interval = interval;
+    tm->next = interval;
+    tm->last_ms = uptime();
+    telemetry_set_image(tm, image);
+    // readers ignore the page until the magic shows up
+    std::atomic_thread_fence(std::memory_order_release);
+    tm->page->magic = TELEMETRY_MAGIC;
+    printf("[Info] Telemetry page /dev/shm%s, every %lu cycles\n", tm->path, interval);
+}
+
+void telemetry_set_image(TelemetryCtx *tm, const char *image) {
+    if (tm->page == nullptr) {
+        return;
+    }
+    TelemetryPage *page = tm->page;
+    __atomic_fetch_add(&page->seq, 1, __ATOMIC_RELEASE);
+    snprintf(page->image, sizeof(page->image), "%s", image ? image : "default");
+    page->ncounters = 0;
+    __atomic_fetch_add(&page->seq, 1, __ATOMIC_RELEASE);
+    tm->nsamples = 0;
+    tm->next = tm->interval;
+    tm->last_cycles = 0;
+    tm->last_instrs = 0;
+}
+
+void telemetry_publish(TelemetryCtx *tm, uint64_t cycles, uint64_t instrs, uint32_t state) {
+    TelemetryPage *page = tm->page;
+    uint32_t now = uptime();
+    uint64_t win_cycles = cycles - tm->last_cycles;
+    uint64_t win_instrs = instrs - tm->last_instrs;
+    uint32_t win_ms = now - tm->last_ms;
+
+    __atomic_fetch_add(&page->seq, 1, __ATOMIC_RELEASE);
+    std::atomic_thread_fence(std::memory_order_release);
+    page->cycles = cycles;
+    page->instrs = instrs;
+    page->ipc = cycles ? (double)instrs / cycles : 0.0;
+    page->ipc_window = win_cycles ? (double)win_instrs / win_cycles : 0.0;
+    page->kips = win_ms ? (double)win_instrs / win_ms : 0.0;
+    page->host_ms = now;
+    page->state = state;
+    if (tm->nsamples) {
+        memcpy(page->counters, tm->samples, tm->nsamples * sizeof(TelemetryCounter));
+        page->ncounters = tm->nsamples;
+        page->counter_cycles = tm->sample_cycles;
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+    __atomic_fetch_add(&page->seq, 1, __ATOMIC_RELEASE);
+
+    tm->last_cycles = cycles;
+    tm->last_instrs = instrs;
+    tm->last_ms = now;
+    tm->next = cycles + tm->interval;
+}
+
+void telemetry_close(TelemetryCtx *tm) {
+    if (tm->page == nullptr) {
+        return;
+    }
+    munmap(tm->page, sizeof(TelemetryPage));
+    shm_unlink(tm->path);
+    tm->page = nullptr;
+}
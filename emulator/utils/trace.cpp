@@ -1,36 +1,81 @@
 #include "trace.h"
+#include "emu.h"
+#include <cassert>
 #include <cstdio>
+#include <cstring>
+#include <mutex>
 
-FILE *trace_file = nullptr;
+static std::once_flag disasm_once;
 
-#define IRINGBUF_LEN 1000
-char irbuf[IRINGBUF_LEN][256];
-int irbuf_ptr;
-int irbuf_valid[IRINGBUF_LEN];
+// The disassembler is shared by all instances, and only set up once some
+// instance needs text
+static void need_disasm() {
+    std::call_once(disasm_once, init_disasm, "riscv32-pc-linux-gnu");
+}
 
 void trace_init() {
-    irbuf_ptr = 0;
-    init_disasm("riscv32-pc-linux-gnu");
+    TraceRing *ring = &emu->tracer;
+    ring->irbuf_ptr = 0;
+    memset(ring->irbuf_valid, 0, sizeof(ring->irbuf_valid));
 }
 
-char inst_disasm[100];
-
 void trace(uint32_t pc, uint32_t inst) {
-    disassemble(inst_disasm, 100, pc, (uint8_t *)&(inst), 4);
-    sprintf(irbuf[irbuf_ptr], "\tPC: 0x%08x\tInst: 0x%08x\t%s\n", pc, inst, inst_disasm);
-    irbuf_valid[irbuf_ptr] = 1;
-    irbuf_ptr = (irbuf_ptr + 1) % IRINGBUF_LEN;
+    TraceRing *ring = &emu->tracer;
+    ring->irbuf[ring->irbuf_ptr] = {pc, inst};
+    ring->irbuf_valid[ring->irbuf_ptr] = 1;
+    ring->irbuf_ptr = (ring->irbuf_ptr + 1) % IRINGBUF_LEN;
 }
 
-void trace_dump() {
-    trace_file = fopen("./build/trace.log", "w");
+void trace_dump(const char *path) {
+    TraceRing *ring = &emu->tracer;
+    FILE *trace_file = fopen(path, "w");
     if (trace_file == nullptr) {
         return;
     }
+    need_disasm();
+    int irbuf_ptr = ring->irbuf_ptr;
     for (int i = (irbuf_ptr + 1) % IRINGBUF_LEN; i != irbuf_ptr; i = (i + 1) % IRINGBUF_LEN) {
-        if (irbuf_valid[i]) {
-            fprintf(trace_file, "%s %s", (i == irbuf_ptr - 1 ? "->" : "  "), irbuf[i]);
+        if (ring->irbuf_valid[i]) {
+            TraceEntry *e = &ring->irbuf[i];
+            disassemble(ring->inst_disasm, 100, e->pc, (uint8_t *)&e->inst, 4);
+            fprintf(trace_file, "%s \tPC: 0x%08x\tInst: 0x%08x\t%s\n", (i == irbuf_ptr - 1 ? "->" : "  "),
+                e->pc, e->inst, ring->inst_disasm);
         }
     }
     fclose(trace_file);
-}
\ No newline at end of file
+}
+
+void trace_window_open(const char *path, uint64_t from) {
+    TraceRing *ring = &emu->tracer;
+    need_disasm();
+    ring->window = fopen(path, "w");
+    assert(ring->window);
+    ring->window_from = from;
+    printf("[Info] Trace every commit from instr %lu to %s\n", from, path);
+}
+
+// One line per commit, with the effects archhash hashes
+void trace_window(const diff_infos *infos, uint64_t idx) {
+    TraceRing *ring = &emu->tracer;
+    if (idx < ring->window_from) {
+        return;
+    }
+    uint32_t inst = infos->instr;
+    disassemble(ring->inst_disasm, 100, infos->pc, (uint8_t *)&inst, 4);
+    fprintf(ring->window, "%lu\tPC: 0x%08x\tInst: 0x%08x\t%-24s", idx, infos->pc, inst, ring->inst_disasm);
+    if (infos->rf_wen && infos->rf_waddr != 0) {
+        fprintf(ring->window, "\t%s = 0x%08x", get_regname(infos->rf_waddr), infos->rf_wdata);
+    }
+    if (infos->mem_en && IS_STORE(inst)) {
+        fprintf(ring->window, "\tM[0x%08x] = 0x%08x/%x", infos->mem_addr, infos->mem_data, infos->mem_mask);
+    }
+    fputc('\n', ring->window);
+}
+
+void trace_window_close() {
+    TraceRing *ring = &emu->tracer;
+    if (ring->window) {
+        fclose(ring->window);
+        ring->window = nullptr;
+    }
+}
@@ -1,4 +1,8 @@
 import top._
+import erythrina.frontend.bpu.BPUParmams
+import erythrina.frontend.icache.ICacheParams
+import erythrina.memblock.dcache.DCacheParams
+
 object Elaborate extends App {
   val firtoolOptions = Array(
     "--lowering-options=" + List(
@@ -10,8 +14,46 @@ object Elaborate extends App {
     ).reduce(_ + "," + _)
   )
 
+  // --param Name=Value, used by scripts/sweep.py
+  def setParam(param: String): Unit = {
+    val Array(name, value) = param.split("=", 2)
+    name match {
+      case "FTQSize"      => Config.FTQSize = value.toInt
+      case "ROBSize"      => Config.ROBSize = value.toInt
+      case "LoadQueSize"  => Config.LoadQueSize = value.toInt
+      case "StoreQueSize" => Config.StoreQueSize = value.toInt
+      case "BTBSize"      => BPUParmams.BTBSize = value.toInt
+      case "TageBaseSize" => BPUParmams.TageBaseSize = value.toInt
+      case "TageTables"   => BPUParmams.TageTables = value.split(":").toSeq.map{ t =>
+                               val Array(size, len) = t.split("x", 2)
+                               (size.toInt, len.toInt)
+                             }
+      case "TageTagBits"  => BPUParmams.TageTagBits = value.toInt
+      case "RASSize"      => BPUParmams.RASSize = value.toInt
+      case "useGHR"       => Config.useGHR = value.toBoolean
+      case "CoreFreqMHz"  => Config.CoreFreqMHz = value.toInt
+      case "useICachePft" => Config.useICachePft = value.toBoolean
+      case "useFTQPft"    => Config.useFTQPft = value.toBoolean
+      case "FTQPftAhead"  => Config.FTQPftAhead = value.toInt
+      case "ICacheWays"   => ICacheParams.ways = value.toInt
+      case "ICacheSets"   => ICacheParams.sets = value.toInt; Config.shrinkPerfCaches = false
+      case "DCacheWays"   => DCacheParams.ways = value.toInt
+      case "DCacheSets"   => DCacheParams.sets = value.toInt; Config.shrinkPerfCaches = false
+      case "DCacheMSHRs"  => DCacheParams.nMSHR = value.toInt
+      case "LoadSlots"    => DCacheParams.nLoadSlot = value.toInt
+      case "useDCachePft" => Config.useDCachePft = value.toBoolean
+      case "PftStrides"   => DCacheParams.StrideEntries = value.toInt
+      case "PftStreams"   => DCacheParams.StreamEntries = value.toInt
+      case "PftDistance"  => DCacheParams.StrideDistance = value.toInt; DCacheParams.StreamDistance = value.toInt
+      case _ => throw new IllegalArgumentException(s"Unknown param: $name")
+    }
+    println(s"Param: $name = $value")
+  }
+
   val is_perf = args.contains("--perf")
-  val remainArgs = args.filterNot(_ == "--perf")
+  val paramIdx = args.indices.filter(args(_) == "--param")
+  paramIdx.foreach(i => setParam(args(i + 1)))
+  val remainArgs = args.indices.filterNot(i => args(i) == "--perf" || paramIdx.contains(i) || paramIdx.contains(i - 1)).map(args(_)).toArray
 
   if (is_perf) {
     circt.stage.ChiselStage.emitSystemVerilogFile(new PerfTop, remainArgs, firtoolOptions)
@@ -19,4 +61,4 @@ object Elaborate extends App {
   else {
     circt.stage.ChiselStage.emitSystemVerilogFile(new SimTop, remainArgs, firtoolOptions)
   }
-}
\ No newline at end of file
+}
@@ -9,39 +9,39 @@ class AXI4Arbiter(n:Int) extends Module {
         val out = new AXI4
     })
 
+    require(n >= 2, "AXI4Arbiter: at least two masters")
+
     val (in, out) = (io.in, io.out)
 
     val w_inflight = RegInit(false.B)
 
     /* ----------------- Read Channel ----------------- */
-    val r_idle = RegInit(true.B)
-    when (io.out.ar.fire) {
-        r_idle := false.B
-    }.elsewhen(io.out.r.fire && io.out.r.bits.last) {
-        r_idle := true.B
-    }
+    // reads stay outstanding from several masters at once: the top id bits
+    // carry the master, the rest is the id the master chose
+    val srcBits = log2Ceil(n)
+    def src_of(id: UInt): UInt = id(AXI4Params.idBits - 1, AXI4Params.idBits - srcBits)
+    def tag_id(src: UInt, id: UInt): UInt = Cat(src, id(AXI4Params.idBits - srcBits - 1, 0))
+    def untag_id(id: UInt): UInt = id(AXI4Params.idBits - srcBits - 1, 0)
 
     val rd_arb = Module(new RRArbiter(new AXI4BundleA(AXI4Params.idBits), n))
-    val rd_chosen = RegInit(0.U)
-    when (io.out.ar.fire) {
-        rd_chosen := rd_arb.io.chosen
-    }.elsewhen(io.out.r.fire && io.out.r.bits.last) {
-        rd_chosen := 0.U
-    }
 
     // AR
     for (i <- 0 until n) {
         in(i).ar <> rd_arb.io.in(i)
+        assert(!in(i).ar.valid || src_of(in(i).ar.bits.id) === 0.U, "AXI4Arbiter: id of master %d uses the source bits", i.U)
     }
-    out.ar.valid := rd_arb.io.out.valid && !w_inflight && r_idle
+    out.ar.valid := rd_arb.io.out.valid && !w_inflight
     out.ar.bits := rd_arb.io.out.bits
-    rd_arb.io.out.ready := out.ar.ready && !w_inflight && r_idle
+    out.ar.bits.id := tag_id(rd_arb.io.chosen, rd_arb.io.out.bits.id)
+    rd_arb.io.out.ready := out.ar.ready && !w_inflight
 
     // R
-    out.r.ready := in(rd_chosen).r.ready
+    val r_src = src_of(out.r.bits.id)
+    out.r.ready := in(r_src).r.ready
     for (i <- 0 until n) {
-        in(i).r.valid := out.r.valid && rd_chosen === i.U
+        in(i).r.valid := out.r.valid && r_src === i.U
         in(i).r.bits := out.r.bits
+        in(i).r.bits.id := untag_id(out.r.bits.id)
     }
 
     /* ----------------- Write Channel ---------------- */
@@ -26,10 +26,15 @@ class AXI4XBar(addr_space: List[(Long, Long)]) extends ErythModule {
     val r_chosen = PriorityEncoder(r_hit_vec)
     val r_chosen_reg = RegEnable(r_chosen, 0.U, in.ar.fire)
 
+    // reads may be outstanding to one slave at a time, R is routed by r_chosen_reg
+    val r_inflight = RegInit(0.U(8.W))
+    r_inflight := r_inflight + in.ar.fire - (in.r.fire && in.r.bits.last)
+    val r_block = r_inflight =/= 0.U && r_chosen =/= r_chosen_reg
+
     // AR
-    in.ar.ready := out(r_chosen).ar.ready
+    in.ar.ready := out(r_chosen).ar.ready && !r_block
     for (i <- 0 until addr_space.size) {
-        out(i).ar.valid := in.ar.valid && r_hit_vec(i)
+        out(i).ar.valid := in.ar.valid && r_hit_vec(i) && !r_block
         out(i).ar.bits := in.ar.bits
     }
 
@@ -5,6 +5,7 @@ import chisel3.util._
 import erythrina.ErythModule
 import bus.axi4.AXI4
 import utils.LookupTree
+import top.Config.CoreFreqMHz
 
 object AXI4CLINTAddr {
     def rtc_l = 0x2000000L.U
@@ -40,13 +41,19 @@ class AXI4CLINT extends ErythModule {
     // AR
     axi.ar.ready := state === sREQ
     val addr_r = RegEnable(axi.ar.bits.addr, 0.U, axi.ar.fire)
+    val id_r = RegEnable(axi.ar.bits.id, 0.U, axi.ar.fire)
 
     // R
+    require(CoreFreqMHz >= 1, "CoreFreqMHz must be positive")
     val mtime = RegInit(0.U(64.W))
-    mtime := mtime + 1.U
+    val usec_tick = if (CoreFreqMHz > 1) Counter(true.B, CoreFreqMHz)._2 else true.B
+    when (usec_tick) {
+        mtime := mtime + 1.U
+    }
 
     axi.r.valid := state === sRSP
     axi.r.bits := 0.U.asTypeOf(axi.r.bits)
+    axi.r.bits.id := id_r
     axi.r.bits.data := LookupTree(addr_r, List(
         AXI4CLINTAddr.rtc_l -> (mtime(31, 0)),
         AXI4CLINTAddr.rtc_h -> (mtime(63,32))
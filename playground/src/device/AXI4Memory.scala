@@ -156,24 +156,54 @@ class AXI4Memory extends Module {
 	val axi = IO(Flipped(new AXI4))
 
 	/* --------------------- Read --------------------- */
-	val ddr_rd_req_ready = Wire(Bool())
-	val ddr_rd_rsp_valid = Wire(Bool())
+	// every AXI id can have a read outstanding, DRAMsim3 gets the id with the
+	// request and hands the reads back in the order it finishes them
+	val nRdCtx = 1 << AXI4Params.idBits
 
-	val rIDLE :: rWAIT_DRAM_REQ :: rWAIT_DRAM_RSP :: rREQ :: rRESP :: Nil = Enum(5)
+	val cIDLE :: cDRAM_REQ :: cDRAM_RSP :: cREADY :: Nil = Enum(4)
+	val ctx_state = RegInit(VecInit(Seq.fill(nRdCtx)(cIDLE)))
+	val ctx_addr = RegInit(VecInit(Seq.fill(nRdCtx)(0.U(AXI4Params.addrBits.W))))
+	val ctx_len = RegInit(VecInit(Seq.fill(nRdCtx)(0.U(AXI4Params.lenBits.W))))
+
+	// AR
+	axi.ar.ready := ctx_state(axi.ar.bits.id) === cIDLE
+	when (axi.ar.fire) {
+		ctx_state(axi.ar.bits.id) := cDRAM_REQ
+		ctx_addr(axi.ar.bits.id) := axi.ar.bits.addr
+		ctx_len(axi.ar.bits.id) := axi.ar.bits.len
+	}
+
+	//assert(!axi.ar.valid || axi.ar.bits.len <= 7.U)
+	assert(!axi.ar.valid || axi.ar.bits.size === "b010".U)
+
+	// DDR, the helpers answer a cycle after the call
+	val req_vec = VecInit(ctx_state.map(_ === cDRAM_REQ))
+	val req_id = PriorityEncoder(req_vec)
+	val req_sent = RegInit(false.B)
+	val req_sent_id = RegInit(0.U(AXI4Params.idBits.W))
+	val req_valid = req_vec.asUInt.orR && !req_sent
+	req_sent := req_valid
+	req_sent_id := req_id
+
+	val ddr_rd_req_ready = readRequest(req_valid, ctx_addr(req_id), req_id)
+	when (req_sent && ddr_rd_req_ready) {
+		ctx_state(req_sent_id) := cDRAM_RSP
+	}
+
+	val (ddr_rd_rsp_valid, ddr_rd_rsp_id) = readResponse(ctx_state.map(_ === cDRAM_RSP).reduce(_ || _))
+	when (ddr_rd_rsp_valid) {
+		ctx_state(ddr_rd_rsp_id(AXI4Params.idBits - 1, 0)) := cREADY
+	}
+
+	// R, one burst at a time
+	val rIDLE :: rREQ :: rRESP :: Nil = Enum(3)
 	val rState = RegInit(rIDLE)
+
+	val ready_vec = VecInit(ctx_state.map(_ === cREADY))
+	val ready_any = ready_vec.asUInt.orR
 	switch (rState) {
 		is (rIDLE) {
-			when (axi.ar.fire) {
-				rState := rWAIT_DRAM_REQ
-			}
-		}
-		is (rWAIT_DRAM_REQ) {
-			when (ddr_rd_req_ready) {
-				rState := rWAIT_DRAM_RSP
-			}
-		}
-		is (rWAIT_DRAM_RSP) {
-			when (ddr_rd_rsp_valid) {
+			when (ready_any) {
 				rState := rREQ
 			}
 		}
@@ -193,30 +223,22 @@ class AXI4Memory extends Module {
 
 	val rd_addr = RegInit(0.U(AXI4Params.addrBits.W))
 	val rd_id = RegInit(0.U(AXI4Params.idBits.W))
+	val rd_len = RegInit(0.U(AXI4Params.lenBits.W))
 
-	when (axi.ar.fire) {
-		rd_addr := axi.ar.bits.addr
-		rd_id := axi.ar.bits.id
+	when (rState === rIDLE && ready_any) {
+		val id = PriorityEncoder(ready_vec)
+		rd_id := id
+		rd_addr := ctx_addr(id)
+		rd_len := ctx_len(id)
 	}.elsewhen(rState === rREQ) {
 		rd_addr := rd_addr + 4.U
-	}
-
-	val rd_len = RegInit(0.U(AXI4Params.lenBits.W))
-	when (axi.ar.fire) {
-		rd_len := axi.ar.bits.len
 	}.elsewhen(axi.r.fire) {
 		rd_len := rd_len - 1.U
 	}
 
-	// AR
-	axi.ar.ready := rState === rIDLE
-
-	//assert(!axi.ar.valid || axi.ar.bits.len <= 7.U)
-	assert(!axi.ar.valid || axi.ar.bits.size === "b010".U)
-
-	// DDR
-	ddr_rd_req_ready := readRequest(rState === rWAIT_DRAM_REQ && !ddr_rd_req_ready, rd_addr, rd_id)
-	ddr_rd_rsp_valid := readResponse(rState === rWAIT_DRAM_RSP && !ddr_rd_rsp_valid)._1
+	when (axi.r.fire && axi.r.bits.last) {
+		ctx_state(rd_id) := cIDLE
+	}
 
 	// Get Data
 	val rd_data = readData(rState === rREQ, rd_addr)
@@ -27,7 +27,7 @@ trait HasErythCoreParams {
     val RESETVEC = Config.RESETVEC
 
     val FetchWidth = 2
-    val FTQSize = 16
+    val FTQSize = Config.FTQSize
     val DecodeWidth = FetchWidth
     val RenameWidth = DecodeWidth
     val DispatchWidth = RenameWidth
@@ -46,7 +46,7 @@ trait HasErythCoreParams {
     val ArchRegNum = 32
     val ArchRegAddrBits = log2Up(ArchRegNum)
 
-    val ROBSize = 64
-    val LoadQueSize = 8
-    val StoreQueSize = 8
+    val ROBSize = Config.ROBSize
+    val LoadQueSize = Config.LoadQueSize
+    val StoreQueSize = Config.StoreQueSize
 }
\ No newline at end of file
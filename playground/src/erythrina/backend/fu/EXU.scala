@@ -8,6 +8,7 @@ import erythrina.backend.InstExInfo
 import utils.LookupTreeDefault
 import erythrina.backend.Redirect
 import utils.PerfCount
+import erythrina.frontend.bpu.BrType
 import erythrina.backend.fu.div.Divisor
 import erythrina.backend.fu.mul.Multiplier
 
@@ -112,6 +113,11 @@ class EXU0 extends BaseEXU {
     PerfCount("bpu_wrong_exu", cmt.valid && cmt.bits.exception.bpu_mispredict && cmt.bits.fuType === FuType.bru)
     PerfCount("bpu_wrong_br", cmt.valid && cmt.bits.exception.bpu_mispredict && cmt.bits.fuType === FuType.bru && !(cmt.bits.fuOpType === BRUop.jal || cmt.bits.fuOpType === BRUop.jalr))
     PerfCount("bpu_wrong_jal", cmt.valid && cmt.bits.exception.bpu_mispredict && cmt.bits.fuType === FuType.bru && (cmt.bits.fuOpType === BRUop.jal || cmt.bits.fuOpType === BRUop.jalr))
+
+    val cmt_brtype = BrType(cmt.bits.fuOpType, cmt.bits.a_rd, cmt.bits.a_rs1)
+    PerfCount("bpu_correct_br", cmt.valid && !cmt.bits.exception.bpu_mispredict && cmt.bits.fuType === FuType.bru && cmt_brtype === BrType.cond)
+    PerfCount("bpu_correct_ret", cmt.valid && !cmt.bits.exception.bpu_mispredict && cmt.bits.fuType === FuType.bru && cmt_brtype === BrType.ret)
+    PerfCount("bpu_wrong_ret", cmt.valid && cmt.bits.exception.bpu_mispredict && cmt.bits.fuType === FuType.bru && cmt_brtype === BrType.ret)
 }
 
 // exu1: alu mul
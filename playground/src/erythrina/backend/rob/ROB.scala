@@ -13,6 +13,7 @@ import utils.PerfDumpTrigger
 import utils.PerfCount
 import top.Config
 import erythrina.frontend.bpu.BPUTrainInfo
+import erythrina.frontend.bpu.BrType
 
 class ROB extends ErythModule {
     val io = IO(new Bundle {
@@ -149,7 +150,10 @@ class ROB extends ErythModule {
         bpu_upt(i).bits.hit := entries(ptr.value).bpu_hit
         bpu_upt(i).bits.target := entries(ptr.value).real_target
         bpu_upt(i).bits.taken := entries(ptr.value).real_taken && (entries(ptr.value).fuType === FuType.bru)
+        bpu_upt(i).bits.brtype := BrType(entries(ptr.value).fuOpType, entries(ptr.value).a_rd, entries(ptr.value).a_rs1)
         bpu_upt(i).bits.ghr := entries(ptr.value).bpu_ghr
+        bpu_upt(i).bits.ras_sp := 0.U
+        bpu_upt(i).bits.ras_top := 0.U
     }
     val cmtNum = PopCount(commit_canDeq)
     commitPtrExt.foreach{case x => when (commit_canDeq.asUInt.orR) {x := x + cmtNum}}
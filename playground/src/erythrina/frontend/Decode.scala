@@ -14,6 +14,7 @@ import utils.ZeroExt
 import erythrina.backend.fu.BRUop
 import erythrina.backend.Redirect
 import erythrina.frontend.bpu.BPUTrainInfo
+import erythrina.frontend.bpu.BrType
 
 trait InstrType {
 	def TypeI   = "b000".U
@@ -167,6 +168,9 @@ class Decoder extends ErythModule with InstrType{
     io.bpu_upt.bits.hit := out.bits.bpu_hit
     io.bpu_upt.bits.pc := pc
     io.bpu_upt.bits.taken := true.B
+    io.bpu_upt.bits.brtype := BrType(fuOpType, rd, rs1)
     io.bpu_upt.bits.ghr := out.bits.bpu_ghr
+    io.bpu_upt.bits.ras_sp := in.ras_sp
+    io.bpu_upt.bits.ras_top := in.ras_top
 
 }
\ No newline at end of file
@@ -3,11 +3,11 @@ package erythrina.frontend
 import chisel3._
 import chisel3.util._
 import erythrina.ErythModule
-import utils.CircularQueuePtr
+import utils.{CircularQueuePtr, HasCircularQueuePtrHelper}
 import utils.PerfCount
-import top.Config.useFTQPft
+import top.Config.{useFTQPft, FTQPftAhead}
 
-class FTQ extends ErythModule {
+class FTQ extends ErythModule with HasCircularQueuePtrHelper {
     val io = IO(new Bundle {
         val enq_req  = Flipped(DecoupledIO(new InstFetchBlock))        // from BPU, enq
 
@@ -88,13 +88,19 @@ class FTQ extends ErythModule {
     }
 
     // prefetch req
+    // the BPU runs ahead of fetch, prefetch the line of each block waiting behind the
+    // one being fetched, up to FTQPftAhead blocks ahead. A taken branch ends its block,
+    // so its target is the head of the next one and gets prefetched too.
+    require(FTQPftAhead > 0 && FTQPftAhead < FTQSize, "FTQPftAhead must be within 1 to FTQSize - 1")
+
     val pft_req = io.pft_req
-    pft_req.valid := valids(pftPtrExt.value) && !io.flush && !reset.asBool && useFTQPft.B
-    pft_req.bits := entries(pftPtrExt.value).instVec.head.pc
+    val pft_ptr = Mux(pftPtrExt > fetchPtrExt, pftPtrExt, fetchPtrExt + 1.U)
+    val pft_inrange = pft_ptr < enqPtrExt && pft_ptr < fetchPtrExt + FTQPftAhead.U
+    pft_req.valid := valids(pft_ptr.value) && pft_inrange && !io.flush && !reset.asBool && useFTQPft.B
+    pft_req.bits := entries(pft_ptr.value).instVec.head.pc
 
-    when (pft_req.fire && pftPtrExt < enqPtrExt) {
-        pftPtrExt := pftPtrExt + 1.U
-    }
+    // never left behind fetch, so the pointers stay comparable
+    pftPtrExt := Mux(pft_req.fire, pft_ptr + 1.U, pft_ptr)
 
     // flush
     when (io.flush) {
@@ -127,4 +133,8 @@ class FTQ extends ErythModule {
     PerfCount("topdown_FetchUnalignBubbles", Mux(fetch_req.valid && fetch_resp.valid && state === sWORK, PopCount(fetch_resp.bits.instVec.map(!_.valid)), 0.U))
 
     PerfCount("topdown_RedirectResteerBubbles", Mux((state === sRECOVERY || io.flush), FetchWidth.U, 0.U))
+
+    /* -------------------- Prefetch -------------------- */
+    PerfCount("icache_pft_ftq_req", pft_req.fire)
+    PerfCount("icache_pft_ftq_ahead_tot", Mux(pft_req.fire, distanceBetween(pft_ptr, fetchPtrExt), 0.U))
 }
\ No newline at end of file
@@ -2,13 +2,16 @@ package erythrina.frontend
 
 /**
   * Filter for FTQ prefetch requests.
-  * Only allow prefetch requests that are not in the same cacheline.
+  * Only allow prefetch requests to cachelines not among the last FTQFilterSize sent,
+  * a loop body spanning a few lines would otherwise prefetch them every iteration.
   */
 
 import chisel3._
 import chisel3.util._
 import erythrina.{ErythBundle, ErythModule}
 import erythrina.frontend.icache.ICacheParams
+import top.Config.FTQFilterSize
+import utils.PerfCount
 
 class FTQFilter extends ErythModule {
     val io = IO(new Bundle {
@@ -16,16 +19,24 @@ class FTQFilter extends ErythModule {
         val out = DecoupledIO(UInt(XLEN.W))
     })
 
+    require(isPow2(FTQFilterSize), "FTQFilterSize must be a power of 2")
+
     val (in, out) = (io.in, io.out)
 
-    val last_base = RegInit(0.U((XLEN - log2Ceil(ICacheParams.CachelineSize)).W))
+    val last_bases = RegInit(VecInit(Seq.fill(FTQFilterSize)(0.U.asTypeOf(Valid(UInt((XLEN - log2Ceil(ICacheParams.CachelineSize)).W))))))
+    val last_ptr = RegInit(0.U(log2Ceil(FTQFilterSize).W))
     val in_base = in.bits(XLEN - 1, log2Ceil(ICacheParams.CachelineSize))
+    val dup = last_bases.map(b => b.valid && b.bits === in_base).reduce(_ || _)
 
-    out.valid := in.valid && (in_base =/= last_base)
+    out.valid := in.valid && !dup
     out.bits := Cat(in_base, 0.U(log2Ceil(ICacheParams.CachelineSize).W))
-    in.ready := out.ready || (in_base === last_base)
+    in.ready := out.ready || dup
     
     when (out.fire) {
-        last_base := in_base
+        last_bases(last_ptr).valid := true.B
+        last_bases(last_ptr).bits := in_base
+        last_ptr := last_ptr + 1.U
     }
-}
\ No newline at end of file
+
+    PerfCount("icache_pft_ftq_filtered", in.valid && dup)
+}
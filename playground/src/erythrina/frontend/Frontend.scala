@@ -43,6 +43,8 @@ class Frontend extends ErythModule {
 
     bpu.io.redirect.valid := redirect.valid || idu.io.redirect.valid
     bpu.io.redirect.bits := Mux(redirect.valid, redirect.bits, idu.io.redirect.bits)
+    bpu.io.recover.valid := idu.io.redirect.valid && !redirect.valid
+    bpu.io.recover.bits := idu.io.bpu_recover
     for (i <- 0 until CommitWidth) {
         bpu.io.bpu_upt(i) <> io.from_backend.bpu_upt(i)
     }
@@ -14,6 +14,8 @@ class InstInfo extends ErythBundle {
     val bpu_taken = Bool()      // BPU says: let's take the branch!
     val bpu_target = UInt(XLEN.W) // BPU says: branch target address
     val bpu_ghr = UInt(XLEN.W) // BPU global history register
+    val ras_sp = UInt(BPUParmams.RASPtrBits.W)  // BPU return address stack, for the IDU to repair it
+    val ras_top = UInt(XLEN.W)
 }
 
 class InstFetchBlock extends ErythBundle {
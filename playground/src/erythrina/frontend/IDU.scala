@@ -15,6 +15,7 @@ class IDU extends ErythModule {
         val decode_res = DecoupledIO(Vec(DecodeWidth, Valid(new InstExInfo)))   // to Rename
 
         val redirect = ValidIO(new Redirect)
+        val bpu_recover = Output(new BPUTrainInfo)     // the jump behind redirect, to repair the BPU
         
         val bpu_upt = Vec(DecodeWidth, ValidIO(new BPUTrainInfo))
     })
@@ -46,6 +47,7 @@ class IDU extends ErythModule {
 
     io.redirect.valid := RegNext(redirect_vec.map(_.valid).reduce(_ || _) && io.decode_res.fire && !io.flush)
     io.redirect.bits := RegNext(redirect_vec(redirect_idx).bits)
+    io.bpu_recover := RegNext(VecInit(decoder_seq.map(_.io.bpu_upt.bits))(redirect_idx))
 
     for (i <- 0 until DecodeWidth) {
         io.bpu_upt(i) <> decoder_seq(i).io.bpu_upt
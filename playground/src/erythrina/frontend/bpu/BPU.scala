@@ -9,12 +9,15 @@ import erythrina.ErythBundle
 import erythrina.frontend.icache.ICacheParams._
 import erythrina.frontend.InstFetchBlock
 import utils.MultiPortQueue
+import utils.PerfCount
 import top.Config
+import BPUParmams._
 
 class BPU extends ErythModule {
     val io = IO(new Bundle {
         val flush = Input(Bool())
         val redirect = Flipped(ValidIO(new Redirect))
+        val recover = Flipped(ValidIO(new BPUTrainInfo))         // from IDU, the jump behind its redirect
 
         val ftq_enq_req = DecoupledIO(new InstFetchBlock)        // to FTQ, enq
 
@@ -32,13 +35,22 @@ class BPU extends ErythModule {
 
     train_queue.io.deq(0).ready := !reset.asBool
 
+    // the backend redirects when the branch commits, anything else comes from the IDU
+    val restore = io.flush || io.redirect.valid && !io.recover.valid
+
     /* -------------- Global History Register -------------- */
+    // speculative, shifted by the conditional branches of each block sent to the FTQ;
+    // the committed one rebuilds it on a backend redirect, a decode redirect
+    // goes back to the history the block was predicted with
     val ghr = RegInit(0.U(XLEN.W))
-    if (Config.useGHR) {
-        when (train_queue.io.deq(0).valid) {
-            ghr := Cat(ghr(XLEN - 2, 0), train_queue.io.deq(0).bits.taken)
-        }
+    val ghr_next = Wire(UInt(XLEN.W))
+
+    val arch_ghr = RegInit(0.U(XLEN.W))
+    val arch_ghr_next = io.bpu_upt.take(CommitWidth).foldLeft(arch_ghr){
+        case (h, cmt) => Mux(cmt.valid && cmt.bits.brtype === BrType.cond, Cat(h(XLEN - 2, 0), cmt.bits.taken), h)
     }
+    arch_ghr := arch_ghr_next
+    ghr := ghr_next
 
     val s0_valid = Wire(Bool())
     val s1_valid = RegInit(false.B)
@@ -56,7 +68,14 @@ class BPU extends ErythModule {
     val btb = Module(new BTB)
     btb.io.upt.valid := train_queue.io.deq(0).valid
     btb.io.upt.bits := train_queue.io.deq(0).bits
-    btb.io.ghr := ghr
+    btb.io.ghr := ghr_next
+    btb.io.hold := !s1_ready
+
+    val tage = Module(new Tage)
+    tage.io.upt.valid := train_queue.io.deq(0).valid
+    tage.io.upt.bits := train_queue.io.deq(0).bits
+    tage.io.ghr := ghr_next
+    tage.io.hold := !s1_ready
 
     /* -------------- s0 -------------- */
     s0_valid := (s1_valid || io.redirect.valid || !rst_issued) && !io.flush && !reset.asBool
@@ -72,6 +91,8 @@ class BPU extends ErythModule {
     for (i <- 0 until FetchWidth) {
         btb.io.req(i).valid := s0_valid && s1_ready
         btb.io.req(i).bits.pc := s0_pc + (i.U << 2)
+        tage.io.req(i).valid := s0_valid && s1_ready
+        tage.io.req(i).bits.pc := s0_pc + (i.U << 2)
     }
 
     /* -------------- s1 -------------- */
@@ -86,13 +107,22 @@ class BPU extends ErythModule {
     val base_cacheline = s1_pc(XLEN - 1, log2Ceil(CachelineSize))
     val enq_blk = WireInit(0.U.asTypeOf(new InstFetchBlock))
 
+    val ras = if (RASSize > 0) Some(Module(new RAS)) else None
+    val ras_sp = ras.map(_.io.sp).getOrElse(0.U)
+    val ras_top = ras.map(_.io.top).getOrElse(0.U)
+
+    // jumps are always taken, conditional branches as the TAGE says
     val s_npc_vec = Wire(Vec(FetchWidth, UInt(XLEN.W)))
     val d_npc_vec = Wire(Vec(FetchWidth, UInt(XLEN.W)))
     val d_npc_v_vec = Wire(Vec(FetchWidth, Bool()))
     for (i <- 0 until FetchWidth) {
+        val btb_rsp = btb.io.rsp(i)
+        val is_cond = btb_rsp.bits.brtype === BrType.cond
+        val is_ret = btb_rsp.bits.brtype === BrType.ret
+
         s_npc_vec(i) := s1_pc + (i.U << 2) + 4.U
-        d_npc_vec(i) := btb.io.rsp(i).bits.target
-        d_npc_v_vec(i) := btb.io.rsp(i).valid && btb.io.rsp(i).bits.taken
+        d_npc_vec(i) := Mux(is_ret && (RASSize > 0).B, ras_top, btb_rsp.bits.target)
+        d_npc_v_vec(i) := btb_rsp.valid && btb_rsp.bits.hit && (!is_cond || tage.io.rsp(i).bits.taken)
     }
 
     for (i <- 0 until FetchWidth) {
@@ -100,6 +130,9 @@ class BPU extends ErythModule {
         enq_blk.instVec(i).bpu_hit := btb.io.rsp(i).bits.hit
         enq_blk.instVec(i).bpu_taken := d_npc_v_vec(i)
         enq_blk.instVec(i).bpu_target := Mux(d_npc_v_vec(i), d_npc_vec(i), s_npc_vec(i))
+        enq_blk.instVec(i).bpu_ghr := ghr
+        enq_blk.instVec(i).ras_sp := ras_sp
+        enq_blk.instVec(i).ras_top := ras_top
         
         val prev_taken = if (i == 0) false.B else d_npc_v_vec.take(i).reduce(_ || _)
         val same_cacheline = (s1_pc + (i.U << 2))(XLEN - 1, log2Ceil(CachelineSize)) === base_cacheline
@@ -121,4 +154,35 @@ class BPU extends ErythModule {
 
     io.ftq_enq_req.valid := s1_valid && !io.redirect.valid && !io.flush
     io.ftq_enq_req.bits := enq_blk
+
+    /* -------------- Speculative Update -------------- */
+    val s1_fire = io.ftq_enq_req.fire
+
+    val cond_vec = (0 until FetchWidth).map(i => enq_blk.instVec(i).valid && btb.io.rsp(i).bits.hit && btb.io.rsp(i).bits.brtype === BrType.cond)
+    val s1_ghr = (0 until FetchWidth).foldLeft(ghr){
+        case (h, i) => Mux(cond_vec(i), Cat(h(XLEN - 2, 0), d_npc_v_vec(i)), h)
+    }
+
+    ghr_next := MuxCase(ghr, Seq(
+        restore -> arch_ghr_next,
+        io.recover.valid -> io.recover.bits.ghr,
+        s1_fire -> s1_ghr
+    ))
+
+    // the block ends at its only taken jump, if any
+    val end_taken = d_npc_v_vec(last_valid_idx)
+    val end_brtype = btb.io.rsp(last_valid_idx).bits.brtype
+    ras.foreach{
+        case r =>
+            r.io.push.valid := s1_fire && end_taken && end_brtype === BrType.call
+            r.io.push.bits := s_npc_vec(last_valid_idx)
+            r.io.pop := s1_fire && end_taken && end_brtype === BrType.ret
+            r.io.commit.zip(io.bpu_upt).foreach{case (cmt, upt) => cmt := upt}
+            r.io.restore := restore
+            r.io.recover := io.recover
+    }
+
+    /* -------------- Perf -------------- */
+    PerfCount("bpu_recover_backend", restore)
+    PerfCount("bpu_recover_idu", io.recover.valid && !restore)
 }
\ No newline at end of file
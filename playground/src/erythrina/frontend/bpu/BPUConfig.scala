@@ -7,6 +7,15 @@ import top.Config._
 object BPUParmams {
     /* ------------- Branch Target Buffer ------------- */
     var BTBSize = 64
-    val TagBits = XLEN - log2Ceil(BTBSize) - 2
-    val IdxBits = log2Ceil(BTBSize)
-}
\ No newline at end of file
+    def TagBits = XLEN - log2Ceil(BTBSize) - 2
+    def IdxBits = log2Ceil(BTBSize)
+
+    /* ------------- TAGE Direction Predictor ------------- */
+    var TageBaseSize = 512                                  // bimodal base table
+    var TageTables = Seq((128, 8), (128, 16), (128, 32))    // (entries, history length), shortest history first
+    var TageTagBits = 8
+
+    /* ------------- Return Address Stack ------------- */
+    var RASSize = 16                                        // 0 for no RAS
+    def RASPtrBits = if (RASSize > 0) log2Ceil(RASSize) max 1 else 1
+}
@@ -7,6 +7,7 @@ import BPUParmams._
 import utils.MultiPortQueue
 import utils.PerfCount
 import top.Config
+import erythrina.backend.fu.BRUop
 
 class BTBReq extends ErythBundle {
     val pc = UInt(XLEN.W)
@@ -14,17 +15,41 @@ class BTBReq extends ErythBundle {
 
 class BTBRsp extends ErythBundle {
     val hit = Bool()
-    val taken = Bool()
+    val brtype = UInt(2.W)
     val target = UInt(XLEN.W)
 }
 
+object BrType {
+    def cond    = "b00".U(2.W)
+    def jump    = "b01".U(2.W)
+    def call    = "b10".U(2.W)
+    def ret     = "b11".U(2.W)
+
+    def isLink(reg: UInt): Bool = reg === 1.U || reg === 5.U
+
+    // RISC-V return address hints: a jump writing ra/t0 is a call, a jalr reading one is a return
+    def apply(fuOpType: UInt, rd: UInt, rs1: UInt): UInt = {
+        val is_jmp = fuOpType === BRUop.jal || fuOpType === BRUop.jalr
+        MuxCase(cond, Seq(
+            (is_jmp && isLink(rd)) -> call,
+            (fuOpType === BRUop.jalr && isLink(rs1)) -> ret,
+            is_jmp -> jump
+        ))
+    }
+}
+
 class BPUTrainInfo extends ErythBundle {
     val hit = Bool()
     val pc = UInt(XLEN.W)
     val target = UInt(XLEN.W)
     val taken = Bool()
+    val brtype = UInt(2.W)
 
     val ghr = UInt(XLEN.W)
+
+    // RAS snapshot of the fetch block, only used by the IDU to repair the RAS
+    val ras_sp = UInt(RASPtrBits.W)
+    val ras_top = UInt(XLEN.W)
 }
 
 class SatCnt(bits:Int) extends ErythBundle {
@@ -46,6 +71,7 @@ class BTB extends ErythModule {
     val io = IO(new Bundle {
         val req = Vec(FetchWidth, Flipped(ValidIO(new BTBReq)))
         val ghr = Input(UInt(XLEN.W))
+        val hold = Input(Bool())                                // s1 stalled, keep the response
         val rsp = Vec(FetchWidth, ValidIO(new BTBRsp))
         val upt = Flipped(ValidIO(new BPUTrainInfo))
     })
@@ -54,19 +80,21 @@ class BTB extends ErythModule {
 
     val train_req = io.upt
     
+    // the direction of conditional branches comes from the TAGE, the BTB only
+    // tells which slots hold a branch, what kind it is and where it goes
     def get_btb_idx(pc: UInt, ghr: UInt): UInt = {
-        val new_pc = pc ^ ghr
+        val new_pc = if (Config.useGHR) pc ^ ghr else pc
         new_pc(log2Ceil(BTBSize) + 1, 2)
     }
     def get_btb_tag(pc: UInt, ghr: UInt): UInt = {
-        val new_pc = pc ^ ghr
+        val new_pc = if (Config.useGHR) pc ^ ghr else pc
         new_pc(XLEN - 1, XLEN - TagBits)
     }
 
-    /* ------------- Meta & Target & Sat Cnt ------------- */
+    /* ------------- Meta & Target & Type ------------- */
     val targets = SyncReadMem(BTBSize, UInt(XLEN.W))
     val tags = SyncReadMem(BTBSize, UInt(TagBits.W))
-    val satcnts = RegInit(VecInit(Seq.fill(BTBSize)(0.U.asTypeOf(new SatCnt(2)))))
+    val brtypes = RegInit(VecInit(Seq.fill(BTBSize)(BrType.cond)))
     val valids = RegInit(VecInit(Seq.fill(BTBSize)(false.B)))
 
     /* ------------- Request ------------- */
@@ -74,23 +102,34 @@ class BTB extends ErythModule {
 
     val btb_targets = Wire(Vec(FetchWidth, UInt(XLEN.W)))
     val btb_tags = Wire(Vec(FetchWidth, UInt(TagBits.W)))
-    val btb_satcnts = Wire(Vec(FetchWidth, UInt(2.W)))
+    val btb_brtypes = Wire(Vec(FetchWidth, UInt(2.W)))
     val btb_valids = Wire(Vec(FetchWidth, Bool()))
 
+    // hold the response while the BPU s1 is stalled by the FTQ
     for (i <- 0 until FetchWidth) {
         val idx = get_btb_idx(io.req(i).bits.pc, ghr)
 
         btb_targets(i) := targets.read(idx, io.req(i).valid)
         btb_tags(i) := tags.read(idx, io.req(i).valid)
-        btb_satcnts(i) := RegNext(satcnts(idx).cnt)
-        btb_valids(i) := RegNext(valids(idx))
+        btb_brtypes(i) := RegEnable(brtypes(idx), io.req(i).valid)
+        btb_valids(i) := RegEnable(valids(idx), false.B, io.req(i).valid)
     }
 
     /* ------------- Response ------------- */
     for (i <- 0 until FetchWidth) {
-        io.rsp(i).valid := RegNext(io.req(i).valid)
-        io.rsp(i).bits.hit := btb_tags(i) === get_btb_tag(RegNext(io.req(i).bits.pc), RegNext(ghr)) && btb_valids(i)
-        io.rsp(i).bits.taken := btb_satcnts(i)(1) && io.rsp(i).bits.hit
+        val req_pc = RegEnable(io.req(i).bits.pc, io.req(i).valid)
+        val req_ghr = RegEnable(ghr, io.req(i).valid)
+
+        val rsp_valid = RegInit(false.B)
+        when (io.req(i).valid) {
+            rsp_valid := true.B
+        }.elsewhen (!io.hold) {
+            rsp_valid := false.B
+        }
+
+        io.rsp(i).valid := rsp_valid
+        io.rsp(i).bits.hit := btb_tags(i) === get_btb_tag(req_pc, req_ghr) && btb_valids(i)
+        io.rsp(i).bits.brtype := btb_brtypes(i)
         io.rsp(i).bits.target := btb_targets(i)
     }
 
@@ -100,23 +139,14 @@ class BTB extends ErythModule {
         val tag = get_btb_tag(train_req.bits.pc, train_req.bits.ghr)
         val hit = train_req.bits.hit
         val target = train_req.bits.target
-        val taken = train_req.bits.taken
-
-        // Update SatCnt
-        when (hit) {
-            when (taken) {
-                satcnts(idx).inc()
-            }.otherwise {
-                satcnts(idx).dec()
-            }
-        }.otherwise {
-            satcnts(idx).reset()
-        }
 
-        // Update Target && Tag
-        when (!hit) {
+        // Update Target && Tag && Type, a branch allocated while not taken learns its target later
+        when (!hit || train_req.bits.taken) {
             targets.write(idx, target)
+        }
+        when (!hit) {
             tags.write(idx, tag)
+            brtypes(idx) := train_req.bits.brtype
             valids(idx) := true.B
         }
     }
@@ -0,0 +1,83 @@
+package erythrina.frontend.bpu
+
+import chisel3._
+import chisel3.util._
+import erythrina.{ErythModule, ErythBundle}
+import BPUParmams._
+import utils.PerfCount
+
+/*
+    Return Address Stack, circular and speculative: s1 pushes for a predicted
+    call and pops for a predicted return. A second copy follows the calls
+    and returns committed by the ROB, the backend redirects at commit so the
+    speculative stack is simply reloaded from it. A decode redirect only
+    flushes the blocks behind the jump, every block carries the sp and top
+    entry seen by s1 through the FTQ and they are put back from there.
+*/
+class RAS extends ErythModule {
+    val io = IO(new Bundle {
+        val sp = Output(UInt(RASPtrBits.W))
+        val top = Output(UInt(XLEN.W))                          // return address prediction
+
+        val push = Flipped(ValidIO(UInt(XLEN.W)))               // s1, predicted call
+        val pop = Input(Bool())                                 // s1, predicted return
+
+        val commit = Flipped(Vec(CommitWidth, ValidIO(new BPUTrainInfo)))  // from ROB, in order
+        val restore = Input(Bool())                             // backend redirect
+        val recover = Flipped(ValidIO(new BPUTrainInfo))        // decode redirect
+    })
+
+    require(isPow2(RASSize) && RASSize >= 2, "RASSize must be a power of 2")
+
+    println(s"RAS: RASSize = ${RASSize}")
+
+    val stack = RegInit(VecInit(Seq.fill(RASSize)(0.U(XLEN.W))))
+    val sp = RegInit(0.U(RASPtrBits.W))
+
+    io.sp := sp
+    io.top := stack(sp)
+
+    /* ------------- Committed Stack ------------- */
+    val arch_stack = RegInit(VecInit(Seq.fill(RASSize)(0.U(XLEN.W))))
+    val arch_sp = RegInit(0.U(RASPtrBits.W))
+
+    val arch_stack_next = WireInit(arch_stack)
+    val arch_sp_next = io.commit.foldLeft(arch_sp){
+        case (cur_sp, cmt) =>
+            val push = cmt.valid && cmt.bits.brtype === BrType.call
+            val pop = cmt.valid && cmt.bits.brtype === BrType.ret
+            when (push) {
+                arch_stack_next(cur_sp + 1.U) := cmt.bits.pc + 4.U
+            }
+            Mux(push, cur_sp + 1.U, Mux(pop, cur_sp - 1.U, cur_sp))
+    }
+    arch_stack := arch_stack_next
+    arch_sp := arch_sp_next
+
+    /* ------------- Speculative Stack ------------- */
+    val recover = io.recover.bits
+    val recover_push = recover.brtype === BrType.call
+
+    when (io.restore) {
+        stack := arch_stack_next
+        sp := arch_sp_next
+    }.elsewhen (io.recover.valid) {
+        // the jump behind the redirect was not predicted, redo it on the snapshot
+        stack(recover.ras_sp) := recover.ras_top
+        when (recover_push) {
+            stack(recover.ras_sp + 1.U) := recover.pc + 4.U
+        }
+        sp := Mux(recover_push, recover.ras_sp + 1.U, recover.ras_sp)
+    }.elsewhen (io.push.valid) {
+        stack(sp + 1.U) := io.push.bits
+        sp := sp + 1.U
+    }.elsewhen (io.pop) {
+        sp := sp - 1.U
+    }
+
+    /* ------------------ Perf ------------------ */
+    PerfCount("bpu_ras_push", io.push.valid && !io.restore && !io.recover.valid)
+    PerfCount("bpu_ras_pop", io.pop && !io.restore && !io.recover.valid)
+    PerfCount("bpu_ras_restore", io.restore)
+    PerfCount("bpu_ras_recover", io.recover.valid && !io.restore)
+}
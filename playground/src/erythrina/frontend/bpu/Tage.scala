@@ -0,0 +1,183 @@
+package erythrina.frontend.bpu
+
+import chisel3._
+import chisel3.util._
+import erythrina.{ErythModule, ErythBundle}
+import BPUParmams._
+import utils.PerfCount
+
+class TageReq extends ErythBundle {
+    val pc = UInt(XLEN.W)
+}
+
+class TageRsp extends ErythBundle {
+    val taken = Bool()
+}
+
+class TageEntry extends ErythBundle {
+    val valid = Bool()
+    val tag = UInt(TageTagBits.W)
+    val ctr = new SatCnt(3)
+    val u = new SatCnt(2)
+}
+
+/*
+    A small TAGE: a bimodal base table plus tagged tables indexed with
+    geometrically longer global histories. The longest matching table
+    provides the direction, a misprediction allocates in a longer table.
+    The predict side is looked up in s0 and answers in s1 like the BTB,
+    the update side reads the tables again with the history recorded at
+    prediction time (BPUTrainInfo.ghr), so both index the same entries.
+*/
+class Tage extends ErythModule {
+    val io = IO(new Bundle {
+        val req = Vec(FetchWidth, Flipped(ValidIO(new TageReq)))
+        val ghr = Input(UInt(XLEN.W))
+        val hold = Input(Bool())                                // s1 stalled, keep the response
+        val rsp = Vec(FetchWidth, ValidIO(new TageRsp))
+        val upt = Flipped(ValidIO(new BPUTrainInfo))
+    })
+
+    val nTables = TageTables.length
+
+    require(nTables >= 1, "TAGE needs at least one tagged table")
+    require(isPow2(TageBaseSize), "TageBaseSize must be a power of 2")
+    for ((size, len) <- TageTables) {
+        require(isPow2(size) && log2Ceil(size) + TageTagBits + 2 <= XLEN, s"TAGE table of $size entries is not supported")
+        require(len > 0 && len <= XLEN, s"TAGE history length $len must be within 1 to $XLEN")
+    }
+
+    println(s"TAGE: TageBaseSize = ${TageBaseSize}, TageTables = ${TageTables.mkString(" ")}, TageTagBits = ${TageTagBits}")
+
+    // xor the newest len bits of history down to width bits
+    def fold(hist: UInt, len: Int, width: Int): UInt = {
+        (0 until len by width).map(i => hist(math.min(i + width, len) - 1, i).pad(width)).reduce(_ ^ _)
+    }
+
+    def get_base_idx(pc: UInt): UInt = pc(log2Ceil(TageBaseSize) + 1, 2)
+    def get_idx(t: Int, pc: UInt, ghr: UInt): UInt = {
+        val (size, len) = TageTables(t)
+        val w = log2Ceil(size)
+        pc(w + 1, 2) ^ fold(ghr, len, w)
+    }
+    def get_tag(t: Int, pc: UInt, ghr: UInt): UInt = {
+        val (size, len) = TageTables(t)
+        val w = log2Ceil(size)
+        pc(w + TageTagBits + 1, w + 2) ^ fold(ghr, len, TageTagBits) ^ (fold(ghr, len, TageTagBits - 1) << 1)
+    }
+
+    /* ------------- Tables ------------- */
+    val base = RegInit(VecInit(Seq.fill(TageBaseSize)(1.U.asTypeOf(new SatCnt(2)))))
+    val tables = TageTables.map{
+        case (size, _) => RegInit(VecInit(Seq.fill(size)(0.U.asTypeOf(new TageEntry))))
+    }
+
+    // longest matching table as provider, the next one as alternate
+    class Lookup(pc: UInt, ghr: UInt) {
+        val idx = (0 until nTables).map(t => get_idx(t, pc, ghr))
+        val tag = (0 until nTables).map(t => get_tag(t, pc, ghr))
+        val entries = VecInit((0 until nTables).map(t => tables(t)(idx(t))))
+        val hits = VecInit((0 until nTables).map(t => entries(t).valid && entries(t).tag === tag(t)))
+
+        val base_idx = get_base_idx(pc)
+        val base_taken = base(base_idx).cnt(1)
+
+        val has_provider = hits.asUInt.orR
+        val provider = (nTables - 1).U - PriorityEncoder(hits.reverse)
+        val provider_taken = entries(provider).ctr.cnt(2)
+
+        val alt_hits = VecInit((0 until nTables).map(t => hits(t) && t.U < provider))
+        val has_alt = alt_hits.asUInt.orR
+        val alt = (nTables - 1).U - PriorityEncoder(alt_hits.reverse)
+        val alt_taken = Mux(has_alt, entries(alt).ctr.cnt(2), base_taken)
+
+        val taken = Mux(has_provider, provider_taken, base_taken)
+    }
+
+    /* ------------- Predict ------------- */
+    for (i <- 0 until FetchWidth) {
+        val req = io.req(i)
+        val lookup = new Lookup(req.bits.pc, io.ghr)
+
+        // hold the response while the BPU s1 is stalled by the FTQ, as the BTB does
+        val rsp_valid = RegInit(false.B)
+        when (req.valid) {
+            rsp_valid := true.B
+        }.elsewhen (!io.hold) {
+            rsp_valid := false.B
+        }
+
+        io.rsp(i).valid := rsp_valid
+        io.rsp(i).bits.taken := RegEnable(lookup.taken, req.valid)
+    }
+
+    /* ------------- Update ------------- */
+    val upt = io.upt
+    val upt_valid = upt.valid && upt.bits.brtype === BrType.cond
+    val taken = upt.bits.taken
+    val lookup = new Lookup(upt.bits.pc, upt.bits.ghr)
+    val mispredict = lookup.taken =/= taken
+
+    // allocate in the shortest longer table with a useless entry
+    val longer = VecInit((0 until nTables).map(t => !lookup.has_provider || t.U > lookup.provider))
+    val can_alloc = VecInit((0 until nTables).map(t => longer(t) && lookup.entries(t).u.cnt === 0.U))
+    val alloc = PriorityEncoder(can_alloc)
+    val need_alloc = upt_valid && mispredict && longer.asUInt.orR
+
+    when (upt_valid) {
+        when (lookup.has_provider) {
+            for (t <- 0 until nTables) {
+                when (lookup.provider === t.U) {
+                    val entry = tables(t)(lookup.idx(t))
+                    when (taken) {
+                        entry.ctr.inc()
+                    }.otherwise {
+                        entry.ctr.dec()
+                    }
+
+                    // only useful when it disagrees with what would have been used instead
+                    when (lookup.provider_taken =/= lookup.alt_taken) {
+                        when (lookup.provider_taken === taken) {
+                            entry.u.inc()
+                        }.otherwise {
+                            entry.u.dec()
+                        }
+                    }
+                }
+            }
+        }.otherwise {
+            when (taken) {
+                base(lookup.base_idx).inc()
+            }.otherwise {
+                base(lookup.base_idx).dec()
+            }
+        }
+    }
+
+    when (need_alloc) {
+        for (t <- 0 until nTables) {
+            val entry = tables(t)(lookup.idx(t))
+            when (can_alloc.asUInt.orR) {
+                when (alloc === t.U) {
+                    entry.valid := true.B
+                    entry.tag := lookup.tag(t)
+                    entry.ctr.cnt := Mux(taken, 4.U, 3.U)
+                    entry.u.reset()
+                }
+            }.elsewhen (longer(t)) {
+                // nothing to replace, age the candidates instead
+                entry.u.dec()
+            }
+        }
+    }
+
+    /* ------------------ Perf ------------------ */
+    PerfCount("bpu_tage_base_correct", upt_valid && !lookup.has_provider && !mispredict)
+    PerfCount("bpu_tage_base_wrong", upt_valid && !lookup.has_provider && mispredict)
+    for (t <- 0 until nTables) {
+        PerfCount(s"bpu_tage_t${t}_correct", upt_valid && lookup.has_provider && lookup.provider === t.U && !mispredict)
+        PerfCount(s"bpu_tage_t${t}_wrong", upt_valid && lookup.has_provider && lookup.provider === t.U && mispredict)
+    }
+    PerfCount("bpu_tage_alloc_succ", need_alloc && can_alloc.asUInt.orR)
+    PerfCount("bpu_tage_alloc_fail", need_alloc && !can_alloc.asUInt.orR)
+}
@@ -33,13 +33,15 @@ class ICache extends ErythModule {
 
     val replacer = Module(new Replacer)
 
-    val pftpipe_req_arb = Module(new RRArbiter(UInt(XLEN.W), 2))
+    val pftpipe_req_arb = Module(new RRArbiter(new PftReq, 2))
     pftpipe_req_arb.io.in(0).valid := io.ftq_pft_req.valid
-    pftpipe_req_arb.io.in(0).bits := io.ftq_pft_req.bits
+    pftpipe_req_arb.io.in(0).bits.addr := io.ftq_pft_req.bits
+    pftpipe_req_arb.io.in(0).bits.from_ftq := true.B
     io.ftq_pft_req.ready := pftpipe_req_arb.io.in(0).ready
 
     pftpipe_req_arb.io.in(1).valid := prefetcher.io.pft_req.valid
-    pftpipe_req_arb.io.in(1).bits := prefetcher.io.pft_req.bits
+    pftpipe_req_arb.io.in(1).bits.addr := prefetcher.io.pft_req.bits
+    pftpipe_req_arb.io.in(1).bits.from_ftq := false.B
     prefetcher.io.pft_req.ready := pftpipe_req_arb.io.in(1).ready
 
     val fetcher_req_arb = Module(new Arbiter(new FetcherReq, 2))
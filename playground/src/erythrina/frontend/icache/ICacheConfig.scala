@@ -5,8 +5,8 @@ import chisel3.util._
 import top.Config._
 
 object ICacheParams {
-    val CacheableRange = ICacheRange
-    val UsePft = useICachePft.B
+    def CacheableRange = ICacheRange
+    def UsePft = useICachePft.B
 
     def get_cacheline_offset(addr: UInt): UInt = {
         val offset = addr(log2Ceil(CachelineSize) - 1, 0)
@@ -119,4 +119,6 @@ class MainPipe extends ErythModule {
     PerfCount("icache_hit", s1_valid && hit && s1_inrange && rsp.valid)
     PerfCount("icache_miss", s1_valid && !hit && s1_inrange && rsp.valid)
     PerfCount("icache_nc", s1_valid && !s1_inrange && rsp.valid)
+    // held back by the prefetch pipe working on the same set, mostly the line it is bringing in
+    PerfCount("icache_pft_late_cycles", req.valid && fwd_hit)
 }
\ No newline at end of file
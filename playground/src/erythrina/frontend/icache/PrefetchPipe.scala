@@ -6,11 +6,17 @@ package erythrina.frontend.icache
 
 import chisel3._
 import chisel3.util._
-import erythrina.ErythModule
+import erythrina.{ErythBundle, ErythModule}
+import utils.PerfCount
+
+class PftReq extends ErythBundle {
+    val addr = UInt(XLEN.W)
+    val from_ftq = Bool()       // FTQ lookahead, next-line otherwise
+}
 
 class PrefetchPipe extends ErythModule {
     val io = IO(new Bundle {
-        val req = Flipped(DecoupledIO(UInt(XLEN.W)))
+        val req = Flipped(DecoupledIO(new PftReq))
 
         // Req to Meta Array
         val meta_req = DecoupledIO(new Bundle {
@@ -44,7 +50,7 @@ class PrefetchPipe extends ErythModule {
     s0_ready := s1_ready && meta_req.ready
     req.ready := s0_ready
 
-    val s0_addr = req.bits
+    val s0_addr = req.bits.addr
     val s0_inrange = (s0_addr >= ICacheParams.CacheableRange._1.U) && (s0_addr < ICacheParams.CacheableRange._2.U)
 
     val s0_idx = ICacheParams.get_idx(s0_addr)
@@ -58,17 +64,20 @@ class PrefetchPipe extends ErythModule {
     val s1_idx = RegInit(0.U(log2Ceil(ICacheParams.sets).W))
     val s1_tag = RegInit(0.U(ICacheParams.TagLen.W))
     val s1_inrange = RegInit(false.B)
+    val s1_from_ftq = RegInit(false.B)
 
     when (s0_valid && s1_ready) {
         s1_valid := s0_valid
         s1_inrange := s0_inrange
         s1_idx := s0_idx
         s1_tag := s0_tag
+        s1_from_ftq := req.bits.from_ftq
     }.elsewhen(!s0_valid && s1_ready) {
         s1_valid := false.B
         s1_inrange := false.B
         s1_idx := 0.U
         s1_tag := 0.U
+        s1_from_ftq := false.B
     }
 
     val hit_vec = meta_rsp.map(m => m.valid && (m.tag === s1_tag))
@@ -83,4 +92,12 @@ class PrefetchPipe extends ErythModule {
     // forward
     fwd_info.valid := s1_valid
     fwd_info.bits := Cat(s1_tag, s1_idx, 0.U(log2Ceil(ICacheParams.CachelineSize).W))
+
+    /* ---------------- Performance ----------------  */
+    val pft_hit = s1_valid && s1_inrange && hit && s1_ready
+    val pft_miss = s1_valid && s1_inrange && !hit && fetcher_rsp.valid
+    PerfCount("icache_pft_hit", pft_hit)
+    PerfCount("icache_pft_miss", pft_miss)
+    PerfCount("icache_pft_ftq_hit", pft_hit && s1_from_ftq)
+    PerfCount("icache_pft_ftq_miss", pft_miss && s1_from_ftq)
 }
\ No newline at end of file
@@ -17,7 +17,7 @@ class Replacer extends ErythModule {
         val query_way = Output(UInt(log2Ceil(ICacheParams.ways).W))
     })
 
-    val lru_seq = Seq.fill(ICacheParams.sets)(Module(new PLRU))
+    val lru_seq = Seq.fill(ICacheParams.sets)(Module(new PLRU(ICacheParams.ways)))
     val lru_oldest = VecInit(lru_seq.map(_.io.oldest))
 
     // update
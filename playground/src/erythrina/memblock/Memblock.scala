@@ -63,6 +63,7 @@ class Memblock extends ErythModule {
     /* ---------------- LDU ---------------- */
     ldu.io.dcache_req <> dcache_req_arb.io.in(0)
     ldu.io.dcache_resp <> dcache.io.rsp
+    ldu.io.pft_hint <> dcache.io.pft_hint
     ldu.io.req <> io.from_backend.ldu_req
     ldu.io.ldu_cmt <> io.to_backend.ldu_cmt
     ldu.io.ldu_cmt <> loadQueue.io.ldu_cmt
@@ -8,6 +8,7 @@ import DCacheParams._
 object DCacheCMD {
     val READ = 0.U(CmdBits.W)
     val WRITE = 1.U(CmdBits.W)
+    val PREFETCH = 2.U(CmdBits.W)   // no response, dropped when the line is present or no MSHR is spare
 }
 
 class DCacheReq extends ErythBundle {
@@ -15,9 +16,11 @@ class DCacheReq extends ErythBundle {
     val data = UInt(XLEN.W)
     val mask = UInt((XLEN / 8).W)
     val cmd = UInt(CmdBits.W)
+    val id = UInt(LoadIdBits.W)     // LDU slot of a load
 }
 
 class DCacheResp extends ErythBundle {
     val data = UInt(XLEN.W)
     val cmd = UInt(CmdBits.W)
+    val id = UInt(LoadIdBits.W)
 }
\ No newline at end of file
@@ -5,7 +5,8 @@ import chisel3.util._
 import top.Config._
 
 object DCacheParams {
-    val CacheableRange = DCacheRange
+    def CacheableRange = DCacheRange
+    def UsePft = useDCachePft.B
     val CmdBits = 2
 
     def get_cacheline_offset(addr: UInt): UInt = {
@@ -22,9 +23,31 @@ object DCacheParams {
         Cat(addr(XLEN - 1, log2Ceil(CachelineSize)), 0.U(log2Ceil(CachelineSize).W))
     }
 
+    // tag ## idx, what the MSHRs match on
+    def get_line(addr: UInt): UInt = {
+        addr(XLEN - 1, log2Ceil(CachelineSize))
+    }
+
     var ways = 4
     var sets = 256
     var CachelineSize = 64
+
+    // outstanding line misses, the refill of MSHR i uses AXI id i and
+    // uncached reads use id nMSHR
+    var nMSHR = 4
+
+    // loads the LDU keeps in flight, each may wait for a refill; the slot
+    // index goes with the request and comes back with its response
+    var nLoadSlot = 4
+    def LoadIdBits = log2Ceil(nLoadSlot) max 1
+
+    // data prefetcher, trained by the loads of the LDU; a prefetch only
+    // takes an MSHR when another one stays free for demand misses
+    var StrideEntries = 16      // PC-indexed stride table
+    var StrideDistance = 4      // strides ahead
+    var StreamEntries = 4       // sequential line streams
+    var StreamDistance = 4      // lines ahead
+    var PftFilterSize = 8       // recently prefetched lines not asked again
     
     def TagLen = XLEN - log2Ceil(sets) - log2Ceil(CachelineSize)
 
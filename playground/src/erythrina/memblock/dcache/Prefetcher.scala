@@ -0,0 +1,191 @@
+package erythrina.memblock.dcache
+
+import chisel3._
+import chisel3.util._
+import erythrina.{ErythBundle, ErythModule}
+import DCacheParams._
+import utils.PerfCount
+
+class LoadPftHint extends ErythBundle {
+    val pc = UInt(XLEN.W)
+    val addr = UInt(XLEN.W)
+}
+
+class StrideEntry extends ErythBundle {
+    val valid = Bool()
+    val tag = UInt((XLEN - log2Ceil(StrideEntries) - 2).W)
+    val last_addr = UInt(XLEN.W)
+    val stride = UInt(XLEN.W)
+    val conf = UInt(2.W)
+}
+
+// per load pc, the distance between its last two addresses
+class StridePrefetcher extends ErythModule {
+    val io = IO(new Bundle {
+        val pft_hint = Flipped(ValidIO(new LoadPftHint))
+        val pft_req = DecoupledIO(UInt(XLEN.W))
+    })
+
+    require(isPow2(StrideEntries), "StrideEntries must be a power of 2")
+
+    def get_stride_idx(pc: UInt): UInt = pc(log2Ceil(StrideEntries) + 1, 2)
+    def get_stride_tag(pc: UInt): UInt = pc(XLEN - 1, log2Ceil(StrideEntries) + 2)
+
+    val table = RegInit(VecInit(Seq.fill(StrideEntries)(0.U.asTypeOf(new StrideEntry))))
+
+    val hint = io.pft_hint
+    val addr = hint.bits.addr
+    val entry = table(get_stride_idx(hint.bits.pc))
+    val hit = entry.valid && entry.tag === get_stride_tag(hint.bits.pc)
+    val stride = addr - entry.last_addr
+
+    // the same address again says nothing about the stride
+    when (hint.valid) {
+        when (!hit) {
+            entry.valid := true.B
+            entry.tag := get_stride_tag(hint.bits.pc)
+            entry.last_addr := addr
+            entry.stride := 0.U
+            entry.conf := 0.U
+        }.elsewhen(stride =/= 0.U) {
+            entry.last_addr := addr
+            when (stride === entry.stride) {
+                entry.conf := Mux(entry.conf === 3.U, entry.conf, entry.conf + 1.U)
+            }.otherwise {
+                entry.conf := Mux(entry.conf === 0.U, entry.conf, entry.conf - 1.U)
+                when (entry.conf <= 1.U) {
+                    entry.stride := stride
+                }
+            }
+        }
+    }
+
+    // seen twice in a row, go StrideDistance strides ahead unless still in this line
+    val pft_addr = addr + (entry.stride * StrideDistance.U)(XLEN - 1, 0)
+    val trigger = hint.valid && hit && stride =/= 0.U && stride === entry.stride && entry.conf =/= 0.U &&
+                    get_line(pft_addr) =/= get_line(addr)
+
+    io.pft_req.valid := RegNext(trigger, false.B)
+    io.pft_req.bits := RegNext(pft_addr)
+}
+
+class StreamEntry extends ErythBundle {
+    val valid = Bool()
+    val line = UInt((XLEN - log2Ceil(CachelineSize)).W)        // last line demanded
+    val pft_line = UInt((XLEN - log2Ceil(CachelineSize)).W)    // furthest line prefetched
+    val up = Bool()
+    val conf = UInt(2.W)
+}
+
+// loads walking through consecutive lines, whatever their pc
+class StreamPrefetcher extends ErythModule {
+    val io = IO(new Bundle {
+        val pft_hint = Flipped(ValidIO(new LoadPftHint))
+        val pft_req = DecoupledIO(UInt(XLEN.W))
+    })
+
+    require(isPow2(StreamEntries) && StreamEntries >= 2, "StreamEntries must be a power of 2")
+
+    val streams = RegInit(VecInit(Seq.fill(StreamEntries)(0.U.asTypeOf(new StreamEntry))))
+    val alloc_ptr = RegInit(0.U(log2Ceil(StreamEntries).W))
+
+    val hint = io.pft_hint
+    val line = get_line(hint.bits.addr)
+
+    def ahead(s: StreamEntry): UInt = Mux(s.up, s.pft_line - s.line, s.line - s.pft_line)
+
+    val same_vec = VecInit(streams.map(s => s.valid && s.line === line))
+    val up_vec = streams.map(s => s.valid && line === s.line + 1.U && (s.up || s.conf === 0.U))
+    val down_vec = streams.map(s => s.valid && line === s.line - 1.U && (!s.up || s.conf === 0.U))
+    val next_vec = VecInit(up_vec.zip(down_vec).map{case (u, d) => u || d})
+    val next_idx = PriorityEncoder(next_vec)
+
+    /* ------------- Train ------------- */
+    when (hint.valid && !same_vec.asUInt.orR) {
+        when (next_vec.asUInt.orR) {
+            val s = streams(next_idx)
+            val up = VecInit(up_vec)(next_idx)
+            s.line := line
+            s.up := up
+            s.conf := Mux(s.conf === 3.U, s.conf, s.conf + 1.U)
+            // fell behind the demand, start over from it
+            when (Mux(up, s.pft_line - line, line - s.pft_line) > StreamDistance.U) {
+                s.pft_line := line
+            }
+        }.otherwise {
+            val s = streams(alloc_ptr)
+            s.valid := true.B
+            s.line := line
+            s.pft_line := line
+            s.up := true.B
+            s.conf := 0.U
+            alloc_ptr := alloc_ptr + 1.U
+        }
+    }
+
+    /* ------------- Issue ------------- */
+    // a confirmed stream keeps StreamDistance lines prefetched ahead, one line a cycle
+    val issue_vec = VecInit(streams.map(s => s.valid && s.conf >= 2.U && ahead(s) < StreamDistance.U))
+    val issue_idx = PriorityEncoder(issue_vec)
+    val issue_stream = streams(issue_idx)
+    val issue_line = Mux(issue_stream.up, issue_stream.pft_line + 1.U, issue_stream.pft_line - 1.U)
+
+    io.pft_req.valid := issue_vec.asUInt.orR && !hint.valid
+    io.pft_req.bits := Cat(issue_line, 0.U(log2Ceil(CachelineSize).W))
+
+    when (io.pft_req.fire) {
+        streams(issue_idx).pft_line := issue_line
+    }
+}
+
+/*
+    Data prefetcher: a stride table and a stream detector, both trained by
+    the loads the LDU sends to the DCache. Their requests go through a
+    filter of recently prefetched lines and enter the DCache pipeline with
+    the lowest priority as PREFETCH, which Stage3 drops when the line is
+    already there or on its way.
+*/
+class Prefetcher extends ErythModule {
+    val io = IO(new Bundle {
+        val pft_hint = Flipped(ValidIO(new LoadPftHint))
+        val pft_req = DecoupledIO(UInt(XLEN.W))
+    })
+
+    println(s"DCache Prefetcher: StrideEntries = ${StrideEntries}, StreamEntries = ${StreamEntries}, distance = ${StrideDistance} strides / ${StreamDistance} lines")
+
+    val stride_pft = Module(new StridePrefetcher)
+    val stream_pft = Module(new StreamPrefetcher)
+    stride_pft.io.pft_hint := io.pft_hint
+    stream_pft.io.pft_hint := io.pft_hint
+
+    // the stride prefetcher does not wait, it drops what the queue can't take
+    val pft_arb = Module(new Arbiter(UInt(XLEN.W), 2))
+    pft_arb.io.in(0) <> stride_pft.io.pft_req
+    pft_arb.io.in(1) <> stream_pft.io.pft_req
+    val pft_queue = Queue(pft_arb.io.out, 4)
+
+    /* ------------- Filter ------------- */
+    require(isPow2(PftFilterSize) && PftFilterSize >= 2, "PftFilterSize must be a power of 2")
+
+    val recent = RegInit(VecInit(Seq.fill(PftFilterSize)(0.U.asTypeOf(Valid(UInt((XLEN - log2Ceil(CachelineSize)).W))))))
+    val recent_ptr = RegInit(0.U(log2Ceil(PftFilterSize).W))
+
+    val pft_line = get_line(pft_queue.bits)
+    val dup = recent.map(r => r.valid && r.bits === pft_line).reduce(_ || _)
+    val drop = dup || !is_cacheable(pft_queue.bits) || !UsePft
+
+    io.pft_req.valid := pft_queue.valid && !drop
+    io.pft_req.bits := Cat(pft_line, 0.U(log2Ceil(CachelineSize).W))
+    pft_queue.ready := io.pft_req.ready || drop
+
+    when (io.pft_req.fire) {
+        recent(recent_ptr).valid := true.B
+        recent(recent_ptr).bits := pft_line
+        recent_ptr := recent_ptr + 1.U
+    }
+
+    /* ---------------- Performance ----------------  */
+    PerfCount("dcache_pft_stride_req", stride_pft.io.pft_req.valid)
+    PerfCount("dcache_pft_stream_req", stream_pft.io.pft_req.fire)
+    PerfCount("dcache_pft_filtered", pft_queue.valid && drop && UsePft)
+}
@@ -1,7 +1,12 @@
 package erythrina.memblock.dcache
 
 /*
-    A Simple Blocking DCache
+    A Non-blocking DCache
+    Misses go to MSHRs, which merge later accesses to the same line, so
+    hits and further misses go on under a miss. Refills come back by AXI
+    id in any order and are written into the arrays one line at a time.
+    Loads answer by the LDU slot id they carry, out of order.
+    Prefetches share the pipeline when no demand access needs it.
     Ref: Nutshell Cache
 */
 
@@ -17,6 +22,7 @@ import erythrina.ErythBundle
 class MetaEntry extends ErythBundle {
     val valid = Bool()
     val dirty = Bool()
+    val pft = Bool()        // brought in by a prefetch, not used yet
     val tag = UInt(TagLen.W)
 }
 
@@ -87,6 +93,7 @@ class SimpleDCacheTask extends ErythBundle {
     val data = UInt(XLEN.W)
     val mask = UInt(MASKLEN.W)
     val cmd = UInt(CmdBits.W)
+    val id = UInt(LoadIdBits.W)
 
     val hit = Bool()
     val cacheable = Bool()
@@ -95,6 +102,28 @@ class SimpleDCacheTask extends ErythBundle {
 
 }
 
+class MSHREntry extends ErythBundle {
+    val valid = Bool()
+    val line = UInt((XLEN - log2Ceil(CachelineSize)).W)
+    val way = UInt(log2Ceil(ways).W)       // reserved for the refill
+    val prefetch = Bool()                   // no demand access merged yet
+    val issued = Bool()
+    val refilled = Bool()
+    val data = Vec(CachelineSize / 4, UInt(XLEN.W))
+
+    // stores merged before the refill, applied on top of it
+    val st_mask = Vec(CachelineSize / 4, UInt(MASKLEN.W))
+    val st_data = Vec(CachelineSize / 4, UInt(XLEN.W))
+}
+
+class LoadWaitEntry extends ErythBundle {
+    val valid = Bool()
+    val mshr = UInt(log2Ceil(nMSHR).W)
+    val word = UInt(log2Ceil(CachelineSize / 4).W)
+    val refilled = Bool()       // data holds the word, waiting for the response port
+    val data = UInt(XLEN.W)
+}
+
 // Stage1: Req for Meta
 class Stage1 extends ErythModule {
     val io = IO(new Bundle {
@@ -113,6 +142,7 @@ class Stage1 extends ErythModule {
     task.data := in.bits.data
     task.mask := in.bits.mask
     task.cmd := in.bits.cmd
+    task.id := in.bits.id
     
     meta_rd_req.valid := in.valid && out.ready
     meta_rd_req.bits := get_idx(task.addr)
@@ -142,43 +172,38 @@ class Stage2 extends ErythModule {
     val meta_rd_rsp = io.meta_rd_rsp
     val data_rd_req = io.data_rd_req
 
-    val plru_seq = Seq.fill(sets)(Module(new PLRU))
+    val plru_seq = Seq.fill(sets)(Module(new PLRU(ways)))
     val oldest_way_vec = VecInit(plru_seq.map(_.io.oldest))
 
     val idx = get_idx(in.bits.addr)
+    val is_pft = in.bits.cmd === DCacheCMD.PREFETCH
 
-    val use_meta_reg = RegInit(false.B)
-    when (in.fire || out.fire) {
-        use_meta_reg := false.B
-    }.elsewhen(out.valid && !out.ready) {
-        use_meta_reg := true.B
-    }
+    // the meta is read again every cycle the task waits here, but it is a
+    // cycle old: patch in the entry Stage3 wrote in that cycle
+    val fwd = io.forward
+    val meta_vec = VecInit(meta_rd_rsp.bits.zipWithIndex.map{
+        case (m, i) =>
+            Mux(fwd.valid && fwd.bits.fwd_idx === idx && fwd.bits.fwd_way === i.U, fwd.bits.fwd_meta, m)
+    })
 
     // check for hit
-    val meta_hit_vec = meta_rd_rsp.bits.map{
+    val hit_vec = meta_vec.map{
         case m => 
             m.valid && (m.tag === get_tag(in.bits.addr))
     }
-    val meta_hit = meta_hit_vec.reduce(_ || _)
-    val meta_hit_way = PriorityEncoder(meta_hit_vec)
-    assert(PopCount(meta_hit_vec) <= 1.U, "More than one hit in meta array")
-
-    val fwd = io.forward
-    val fwd_hit = fwd.bits.fwd_meta.tag === get_tag(in.bits.addr) && fwd.bits.fwd_idx === idx
-    val fwd_hit_way = fwd.bits.fwd_way
-
-    val hit = meta_hit || fwd_hit
-    val hit_way = Mux(fwd_hit, fwd_hit_way, meta_hit_way)
-    val hit_meta = Mux(meta_hit, meta_rd_rsp.bits(meta_hit_way), fwd.bits.fwd_meta)
+    val hit = hit_vec.reduce(_ || _)
+    val hit_way = PriorityEncoder(hit_vec)
+    val hit_meta = meta_vec(hit_way)
+    assert(PopCount(hit_vec) <= 1.U, "More than one hit in meta array")
 
     val cascheable = in.bits.addr >= CacheableRange._1.U && in.bits.addr <= CacheableRange._2.U
 
     // evict & update
     val evict_way = oldest_way_vec(idx)
-    val evict_meta = meta_rd_rsp.bits(evict_way)
+    val evict_meta = meta_vec(evict_way)
 
     for (i <- 0 until sets) {
-        plru_seq(i).io.update.valid := i.U === idx && in.bits.content_valid
+        plru_seq(i).io.update.valid := i.U === idx && in.bits.content_valid && out.ready && !(is_pft && hit)
         plru_seq(i).io.update.bits := Mux(hit, hit_way, evict_way)
     }
 
@@ -192,22 +217,17 @@ class Stage2 extends ErythModule {
     task.hit_or_evict_meta := Mux(hit, hit_meta, evict_meta)
     task.hit_or_evict_way := Mux(hit, hit_way, evict_way)
 
-    val task_reg = RegInit(0.U.asTypeOf(new SimpleDCacheTask))
-    when (out.valid && !out.ready && !use_meta_reg) {
-        task_reg := task
-    }
-
     in.ready := out.ready
     out.valid := true.B
-    out.bits := Mux(use_meta_reg, task_reg, task)
+    out.bits := task
 
     /* ---------------- Performance ----------------  */
-    PerfCount("dcache_hit", out.fire && out.bits.hit && out.bits.cacheable)
-    PerfCount("dcache_miss", out.fire && !out.bits.hit && out.bits.cacheable)
-    PerfCount("dcache_mmio", out.fire && !out.bits.hit && !out.bits.cacheable)
+    PerfCount("dcache_hit", out.fire && out.bits.hit && out.bits.cacheable && !is_pft)
+    PerfCount("dcache_miss", out.fire && !out.bits.hit && out.bits.cacheable && !is_pft)
+    PerfCount("dcache_mmio", out.fire && !out.bits.hit && !out.bits.cacheable && !is_pft)
 }
 
-// Stage3: response for hit, refill for miss
+// Stage3: response for hit, MSHR for miss
 class Stage3 extends ErythModule {
     val io = IO(new Bundle {
         val in = Flipped(DecoupledIO(new SimpleDCacheTask))
@@ -236,33 +256,124 @@ class Stage3 extends ErythModule {
         val axi = new AXI4
     })
 
+    // the top id bit is taken by AXI4Arbiter
+    require(nMSHR >= 2 && nMSHR < (1 << (AXI4Params.idBits - 1)), s"DCache: ${nMSHR} MSHRs do not fit in the AXI id")
+
     val (in, out) = (io.in, io.out)
     val axi = io.axi
+    val (meta_wr_req, data_wr_req) = (io.meta_wr_req, io.data_wr_req)
 
     val is_read = in.bits.cmd === DCacheCMD.READ
     val is_write = in.bits.cmd === DCacheCMD.WRITE
-    val hit = in.bits.hit
-    val dirty = in.bits.hit_or_evict_meta.dirty
+    val is_pft = in.bits.cmd === DCacheCMD.PREFETCH
     val cacheable = in.bits.cacheable
     val content_valid = in.bits.content_valid
 
-    val meta = in.bits.hit_or_evict_meta
-    val way = in.bits.hit_or_evict_way
+    // a refill can land while the task waits here, bringing either its line
+    // or a new line into the way it was going to evict
+    val fix_valid = RegInit(false.B)
+    val fix_hit = RegInit(false.B)
+    val fix_way = RegInit(0.U(log2Ceil(ways).W))
+    val fix_meta = RegInit(0.U.asTypeOf(new MetaEntry))
+
+    val hit = in.bits.hit || fix_valid && fix_hit
+    val meta = Mux(fix_valid, fix_meta, in.bits.hit_or_evict_meta)
+    val way = Mux(fix_valid, fix_way, in.bits.hit_or_evict_way)
     val cacheline = io.data_rd_rsp.bits(way)
 
     val set_idx = get_idx(in.bits.addr)
+    val line = get_line(in.bits.addr)
+    val word_offset = get_cacheline_blk_offset(in.bits.addr)
+
+    def line_idx(l: UInt): UInt = l(log2Ceil(sets) - 1, 0)
+    def line_tag(l: UInt): UInt = l(l.getWidth - 1, log2Ceil(sets))
+
+    /* ------------- MSHR ------------- */
+    val mshr = RegInit(VecInit(Seq.fill(nMSHR)(0.U.asTypeOf(new MSHREntry))))
+    val mshr_ptr = RegInit(VecInit(Seq.fill(nMSHR)(0.U(log2Ceil(CachelineSize / 4).W))))
+    val mshr_valid = VecInit(mshr.map(_.valid))
+    val mshr_busy = mshr_valid.asUInt.orR
+
+    val match_vec = VecInit(mshr.map(m => m.valid && m.line === line))
+    val match_any = match_vec.asUInt.orR
+    val match_idx = PriorityEncoder(match_vec)
+
+    val free_any = !mshr_valid.asUInt.andR
+    val free_idx = PriorityEncoder(mshr_valid.map(!_))
+    // prefetches leave the last free MSHR to demand misses
+    val free_spare = PopCount(mshr_valid.map(!_)) > 1.U
+
+    // the way a refill lands in is off limits to other misses
+    val way_busy = mshr.map(m => m.valid && line_idx(m.line) === set_idx && m.way === way).reduce(_ || _)
+
+    // loads waiting for a refill, by LDU slot
+    val ld_wait = RegInit(VecInit(Seq.fill(nLoadSlot)(0.U.asTypeOf(new LoadWaitEntry))))
+    val ld_wait_valid = VecInit(ld_wait.map(_.valid))
+
+    // a refill wakes every load waiting on it, they answer one a cycle and
+    // hold off the task meanwhile
+    val wake_vec = VecInit(ld_wait.map(w => w.valid && w.refilled))
+    val ld_wakeup = wake_vec.asUInt.orR
+    val wake_id = PriorityEncoder(wake_vec)
+
+    /* ------------- Writeback Buffer ------------- */
+    // a dirty victim or an uncached store, one word per AXI transaction
+    val wb_valid = RegInit(false.B)
+    val wb_cacheable = RegInit(false.B)
+    val wb_addr = RegInit(0.U(XLEN.W))
+    val wb_data = RegInit(VecInit(Seq.fill(CachelineSize / 4)(0.U(XLEN.W))))
+    val wb_strb = RegInit(0.U(MASKLEN.W))
+    val wb_ptr = RegInit(0.U(log2Ceil(CachelineSize / 4).W))
+    val wb_last = Mux(wb_cacheable, wb_ptr === (CachelineSize / 4 - 1).U, true.B)
+
+    // the line must reach memory before it is read again
+    val wb_conflict = wb_valid && wb_cacheable && get_line(wb_addr) === line
 
     /* ------------- Ctrl Signals ------------- */
     val reset_done = Wire(Bool())
-    
-    val wr_last = Wire(Bool())
-    val ready_to_write = Wire(Bool())
 
-    /* ------------- FSM Ctrl ------------- */
-    // main FSM
-    val sRESET :: sWORK :: sUPDATE :: Nil = Enum(3)
+    // sSETTLE: the data read issued in the refill cycle still returns the old line
+    val sRESET :: sWORK :: sUPDATE :: sSETTLE :: sMMIO :: Nil = Enum(5)
     val state = RegInit(sRESET)
 
+    // a finished refill goes into the arrays before the task is looked at
+    val install_vec = VecInit(mshr.map(m => m.valid && m.refilled))
+    val install = state === sWORK && install_vec.asUInt.orR
+    val install_idx = PriorityEncoder(install_vec)
+    val install_mshr = mshr(install_idx)
+    val install_line = VecInit((0 until CachelineSize / 4).map{
+        i => MaskExpand(install_mshr.st_mask(i)) & install_mshr.st_data(i) | MaskExpand(~install_mshr.st_mask(i)) & install_mshr.data(i)
+    })
+    val install_meta = WireInit(0.U.asTypeOf(new MetaEntry))
+    install_meta.valid := true.B
+    install_meta.dirty := install_mshr.st_mask.map(_.orR).reduce(_ || _)
+    install_meta.pft := install_mshr.prefetch
+    install_meta.tag := line_tag(install_mshr.line)
+
+    val task_valid = state === sWORK && content_valid && !install && !ld_wakeup
+    val hit_task = task_valid && cacheable && hit
+    val miss_task = task_valid && cacheable && !hit
+    val mmio_task = task_valid && !cacheable && !is_pft
+
+    // a prefetch never waits: it is dropped unless it can take an MSHR at once
+    val evict_dirty = meta.valid && meta.dirty
+    val do_merge = miss_task && match_any && !is_pft
+    val do_alloc = miss_task && !match_any && Mux(is_pft, free_spare, free_any) && !way_busy && !wb_conflict && !(evict_dirty && wb_valid)
+    val pft_drop = task_valid && is_pft && !do_alloc
+    val mshr_sel = Mux(match_any, match_idx, free_idx)
+
+    // the first demand hit on a prefetched line clears its mark, a load
+    // answers from sUPDATE like a store
+    val pft_useful = hit_task && !is_pft && meta.pft
+
+    // uncached accesses wait for everything in flight, then go alone
+    val mmio_start = mmio_task && !mshr_busy && !wb_valid
+    val mmio_ar_sent = RegInit(false.B)
+    val mmio_r_done = RegInit(false.B)
+    val mmio_data = RegInit(0.U(XLEN.W))
+    val mmio_done = state === sMMIO && Mux(is_read, mmio_r_done, !wb_valid)
+
+    /* ------------- FSM Ctrl ------------- */
     switch (state) {
         is (sRESET) {
             when (reset_done) {
@@ -270,49 +381,144 @@ class Stage3 extends ErythModule {
             }
         }
         is (sWORK) {
-            when (content_valid && ready_to_write) {
+            when (install) {
+                state := sSETTLE
+            }.elsewhen(hit_task && is_write || do_alloc || pft_useful) {
                 state := sUPDATE
+            }.elsewhen(mmio_start) {
+                state := sMMIO
             }
         }
         is (sUPDATE) {
             state := sWORK
         }
+        is (sSETTLE) {
+            state := sWORK
+        }
+        is (sMMIO) {
+            when (mmio_done) {
+                state := sWORK
+            }
+        }
     }
 
-    // Read FSM
-    val sIDLE_R :: sREQ_R :: sRECV_R :: sFINISH_R :: Nil = Enum(4)
-    val state_r = RegInit(sIDLE_R)
+    /* ------------- MSHR Alloc & Merge ------------- */
+    when (do_alloc) {
+        mshr(free_idx).valid := true.B
+        mshr(free_idx).line := line
+        mshr(free_idx).way := way
+        mshr(free_idx).prefetch := is_pft
+        mshr(free_idx).issued := false.B
+        mshr(free_idx).refilled := false.B
+        mshr(free_idx).st_mask := 0.U.asTypeOf(mshr(free_idx).st_mask)
+        mshr_ptr(free_idx) := 0.U
+    }
 
-    switch (state_r) {
-        is (sIDLE_R) {
-            when (RegNext(in.fire) && (!hit && cacheable || !cacheable && is_read) && content_valid) {
-                state_r := sREQ_R
-            }
+    when ((do_alloc || do_merge) && is_write) {
+        val old_mask = Mux(do_alloc, 0.U, mshr(mshr_sel).st_mask(word_offset))
+        val old_data = mshr(mshr_sel).st_data(word_offset)
+        mshr(mshr_sel).st_data(word_offset) := MaskExpand(in.bits.mask) & in.bits.data | MaskExpand(~in.bits.mask) & old_data
+        mshr(mshr_sel).st_mask(word_offset) := old_mask | in.bits.mask
+    }
+
+    // a demand miss on a prefetch in flight: late, but the refill is shared
+    val pft_late = do_merge && mshr(match_idx).prefetch
+    when (pft_late) {
+        mshr(match_idx).prefetch := false.B
+    }
+
+    when (ld_wakeup) {
+        ld_wait(wake_id).valid := false.B
+    }
+
+    for (w <- ld_wait) {
+        when (install && w.valid && !w.refilled && w.mshr === install_idx) {
+            w.refilled := true.B
+            w.data := install_line(w.word)
         }
-        is (sREQ_R) {
-            when (axi.ar.fire) {
-                state_r := sRECV_R
-            }
+    }
+
+    assert(!((do_alloc || do_merge) && is_read && ld_wait(in.bits.id).valid), "DCache: a load slot waits twice")
+    when ((do_alloc || do_merge) && is_read) {
+        ld_wait(in.bits.id).valid := true.B
+        ld_wait(in.bits.id).mshr := mshr_sel
+        ld_wait(in.bits.id).word := word_offset
+        ld_wait(in.bits.id).refilled := false.B
+    }
+
+    when (install) {
+        mshr(install_idx).valid := false.B
+    }
+
+    when (in.fire) {
+        fix_valid := false.B
+    }.elsewhen(install && content_valid && cacheable && line_idx(install_mshr.line) === set_idx) {
+        when (install_mshr.line === line) {
+            fix_valid := true.B
+            fix_hit := true.B
+            fix_way := install_mshr.way
+            fix_meta := install_meta
+        }.elsewhen(!hit && way === install_mshr.way) {
+            fix_valid := true.B
+            fix_hit := false.B
+            fix_way := way
+            fix_meta := install_meta
         }
-        is (sRECV_R) {
-            when (axi.r.fire && axi.r.bits.last) {
-                state_r := sFINISH_R
-            }
+    }
+
+    /* ------------- READ ------------- */
+    val ar_vec = VecInit(mshr.map(m => m.valid && !m.issued))
+    val ar_idx = PriorityEncoder(ar_vec)
+    val mmio_ar = state === sMMIO && is_read && !mmio_ar_sent
+
+    axi.ar.valid := ar_vec.asUInt.orR || mmio_ar
+    axi.ar.bits := 0.U.asTypeOf(axi.ar.bits)
+    axi.ar.bits.id := Mux(mmio_ar, nMSHR.U, ar_idx)
+    axi.ar.bits.addr := Mux(mmio_ar,
+                    in.bits.addr,
+                    Cat(mshr(ar_idx).line, 0.U(log2Ceil(CachelineSize).W))
+                )
+    axi.ar.bits.len := Mux(mmio_ar, 0.U, (CachelineSize / 4 - 1).U)
+    axi.ar.bits.size := "b010".U
+
+    when (axi.ar.fire) {
+        when (mmio_ar) {
+            mmio_ar_sent := true.B
+        }.otherwise {
+            mshr(ar_idx).issued := true.B
         }
-        is (sFINISH_R) {
-            when (out.valid) {
-                state_r := sIDLE_R
+    }
+
+    // refills come back in any order, each beat goes to the MSHR of its id
+    val r_mmio = axi.r.bits.id === nMSHR.U
+    val r_idx = axi.r.bits.id(log2Ceil(nMSHR) - 1, 0)
+
+    axi.r.ready := true.B
+    when (axi.r.fire) {
+        when (r_mmio) {
+            mmio_data := axi.r.bits.data
+            mmio_r_done := axi.r.bits.last
+        }.otherwise {
+            mshr(r_idx).data(mshr_ptr(r_idx)) := axi.r.bits.data
+            mshr_ptr(r_idx) := mshr_ptr(r_idx) + 1.U
+            when (axi.r.bits.last) {
+                mshr(r_idx).refilled := true.B
             }
         }
     }
 
-    // Write FSM
-    val sIDLE_W :: sREQ_W :: sRECV_W :: sFINISH_W :: Nil = Enum(4)
+    when (mmio_done) {
+        mmio_ar_sent := false.B
+        mmio_r_done := false.B
+    }
+
+    /* ------------- WRITE ------------- */
+    val sIDLE_W :: sREQ_W :: sRECV_W :: Nil = Enum(3)
     val state_w = RegInit(sIDLE_W)
 
     switch (state_w) {
         is (sIDLE_W) {
-            when (RegNext(in.fire) && (!hit && dirty && cacheable || !cacheable && is_write) && content_valid) {
+            when (wb_valid) {
                 state_w := sREQ_W
             }
         }
@@ -323,127 +529,68 @@ class Stage3 extends ErythModule {
         }
         is (sRECV_W) {
             when (axi.b.fire) {
-                state_w := Mux(wr_last, sFINISH_W, sREQ_W)
-            }
-        }
-        is (sFINISH_W) {
-            when (out.valid) {
-                state_w := sIDLE_W
+                state_w := Mux(wb_last, sIDLE_W, sREQ_W)
             }
         }
     }
 
-    /* ------------- READ ------------- */
-    val recv_data_vec = RegInit(VecInit(Seq.fill(CachelineSize / 4)(0.U(XLEN.W))))
-
-    val ar_addr = RegInit(0.U(XLEN.W))
-    when (RegNext(in.fire)) {
-        ar_addr := Mux(cacheable,
-                    get_cacheline_addr(in.bits.addr),
-                    in.bits.addr
-                )
-    }
-
-    val ar_len = RegInit(0.U(AXI4Params.lenBits.W))
-    when (RegNext(in.fire)) {
-        ar_len := Mux(cacheable,
-                    (CachelineSize / 4 - 1).U,
-                    0.U
-                )
-    }
-
-    val r_ptr = RegInit(0.U(log2Ceil(CachelineSize / 4).W))
-    when (axi.ar.fire) {
-        r_ptr := 0.U
-    }.elsewhen (axi.r.fire) {
-        r_ptr := r_ptr + 1.U
-    }
-
-    axi.ar.valid := state_r === sREQ_R
-    axi.ar.bits := 0.U.asTypeOf(axi.ar.bits)
-    axi.ar.bits.addr := ar_addr
-    axi.ar.bits.len := ar_len
-    axi.ar.bits.size := "b010".U
-
-    axi.r.ready := state_r === sRECV_R
-    when (axi.r.fire) {
-        recv_data_vec(r_ptr) := axi.r.bits.data
-    }
-
-    /* ------------- WRITE ------------- */
-    val aw_addr = RegInit(0.U(XLEN.W))
-    when (RegNext(in.fire)) {
-        aw_addr := Mux(cacheable,
-                    Cat(meta.tag, set_idx, 0.U(log2Ceil(CachelineSize).W)),
-                    get_cacheline_addr(in.bits.addr)
-                )
+    when (do_alloc && evict_dirty) {
+        wb_valid := true.B
+        wb_cacheable := true.B
+        wb_addr := Cat(meta.tag, set_idx, 0.U(log2Ceil(CachelineSize).W))
+        wb_data := cacheline
+        wb_strb := "b1111".U
+        wb_ptr := 0.U
+    }.elsewhen(mmio_start && is_write) {
+        wb_valid := true.B
+        wb_cacheable := false.B
+        wb_addr := get_cacheline_addr(in.bits.addr)
+        wb_data(0) := in.bits.data
+        wb_strb := in.bits.mask
+        wb_ptr := 0.U
     }.elsewhen(axi.b.fire) {
-        aw_addr := aw_addr + 4.U
-    }
-
-    val w_len = RegInit(0.U(AXI4Params.lenBits.W))
-    when (RegNext(in.fire)) {
-        w_len := Mux(cacheable,
-                    (CachelineSize / 4).U,
-                    0.U
-                )
-    }
-
-    val w_ptr = RegInit(0.U(log2Ceil(CachelineSize / 4).W))
-    when (RegNext(in.fire)) {
-        w_ptr := 0.U
-    }.elsewhen (axi.b.fire) {
-        w_ptr := w_ptr + 1.U
+        wb_addr := wb_addr + 4.U
+        wb_ptr := wb_ptr + 1.U
+        when (wb_last) {
+            wb_valid := false.B
+        }
     }
 
     axi.aw.valid := state_w === sREQ_W
     axi.aw.bits := 0.U.asTypeOf(axi.aw.bits)
-    axi.aw.bits.addr := aw_addr
+    axi.aw.bits.addr := wb_addr
     axi.aw.bits.size := "b010".U
 
     axi.w.valid := state_w === sREQ_W
     axi.w.bits := 0.U.asTypeOf(axi.w.bits)
-    axi.w.bits.data := Mux(cacheable, cacheline(w_ptr), in.bits.data)
-    axi.w.bits.strb := Mux(cacheable, "b1111".U, in.bits.mask)
+    axi.w.bits.data := wb_data(wb_ptr)
+    axi.w.bits.strb := wb_strb
 
     axi.b.ready := state_w === sRECV_W
 
-    wr_last := Mux(cacheable, w_ptr === (CachelineSize / 4 - 1).U, true.B)
-
     /* ------------- Response to Core & Stage Control ------------- */
-    val offset = get_cacheline_offset(in.bits.addr)
-    val word_offset = offset(log2Ceil(CachelineSize) - 1, 2)
-
-    val hit_ready = hit
-    val hit_data = cacheline(word_offset)
-
-    val miss_ready = !hit && state_r === sFINISH_R && (!meta.dirty || state_w === sFINISH_W)
-    val miss_data = recv_data_vec(word_offset)
+    val rd_hit_rsp = hit_task && is_read && !pft_useful
+    val merge_wr_rsp = do_merge && is_write
+    val update_rsp = state === sUPDATE && (is_write || is_read && hit)
 
-    val mmio_ready = !cacheable && (is_read && state_r === sFINISH_R || is_write && state_w === sFINISH_W)
-    val mmio_data = recv_data_vec(0)
-
-    ready_to_write := hit_ready && is_write || miss_ready || mmio_ready
-    out.valid := content_valid && (state === sWORK && hit_ready && is_read || state === sUPDATE)
+    // a wakeup only comes after an install, which holds the task back
+    assert(!(ld_wakeup && (rd_hit_rsp || merge_wr_rsp || update_rsp || mmio_done)), "DCache: two responses in one cycle")
 
+    out.valid := ld_wakeup || rd_hit_rsp || merge_wr_rsp || update_rsp || mmio_done
     out.bits.data := MuxCase(0.U, List(
-        hit_ready -> hit_data,
-        miss_ready -> miss_data,
-        mmio_ready -> mmio_data
+        ld_wakeup -> ld_wait(wake_id).data,
+        (rd_hit_rsp || update_rsp) -> cacheline(word_offset),
+        mmio_done -> mmio_data
     ))
-    out.bits.cmd := in.bits.cmd
+    out.bits.cmd := Mux(ld_wakeup, DCacheCMD.READ, in.bits.cmd)
+    out.bits.id := Mux(ld_wakeup, wake_id, in.bits.id)
 
-    in.ready := (!content_valid || out.valid) && state =/= sRESET
+    // never take a new task while the meta is written, Stage2 only sees
+    // the write through the forward of the next cycle
+    val task_done = rd_hit_rsp || do_merge || state === sUPDATE || mmio_done || pft_drop
+    in.ready := state =/= sRESET && !meta_wr_req.valid && (!content_valid || task_done)
 
     /* ------------- Write Meta & Cacheline ------------- */
-    val (meta_wr_req, data_wr_req) = (io.meta_wr_req, io.data_wr_req)
-
-    // Meta
-    val new_meta = WireInit(0.U.asTypeOf(new MetaEntry))
-    new_meta.valid := true.B
-    new_meta.dirty := Mux(is_write, true.B, meta.dirty)
-    new_meta.tag := get_tag(in.bits.addr)
-
     // reset
     val reset_idx = RegInit(0.U(log2Ceil(sets).W))
     val reset_way = RegInit(0.U(log2Ceil(ways).W))
@@ -456,46 +603,77 @@ class Stage3 extends ErythModule {
     }
     reset_done := reset_idx === (sets - 1).U && reset_way === (ways - 1).U
 
-    meta_wr_req.valid := state === sRESET || state === sWORK && ready_to_write && cacheable
-    meta_wr_req.bits.idx := Mux(state === sRESET, reset_idx, get_idx(in.bits.addr))
-    meta_wr_req.bits.way := Mux(state === sRESET, reset_way, in.bits.hit_or_evict_way)
-    meta_wr_req.bits.meta := Mux(state === sRESET, 0.U.asTypeOf(new MetaEntry), new_meta)
+    val wr_hit = hit_task && is_write
+
+    // Meta: a store hit dirties the line, an allocation takes the victim out
+    val new_meta = WireInit(0.U.asTypeOf(new MetaEntry))
+    new_meta.valid := true.B
+    new_meta.dirty := true.B
+    new_meta.tag := get_tag(in.bits.addr)
+
+    val used_meta = WireInit(meta)
+    used_meta.pft := false.B
+
+    meta_wr_req.valid := state === sRESET || install || wr_hit || do_alloc || pft_useful && is_read
+    meta_wr_req.bits.idx := MuxCase(set_idx, List(
+        (state === sRESET) -> reset_idx,
+        install -> line_idx(install_mshr.line)
+    ))
+    meta_wr_req.bits.way := MuxCase(way, List(
+        (state === sRESET) -> reset_way,
+        install -> install_mshr.way
+    ))
+    meta_wr_req.bits.meta := MuxCase(0.U.asTypeOf(new MetaEntry), List(
+        install -> install_meta,
+        wr_hit -> new_meta,
+        pft_useful -> used_meta
+    ))
 
     // Data
-    val new_cacheline = WireInit(0.U.asTypeOf(Vec(CachelineSize / 4, UInt(XLEN.W))))
-    val new_data = MaskExpand(in.bits.mask) & in.bits.data | MaskExpand(~in.bits.mask) & Mux(in.bits.hit, cacheline(word_offset), recv_data_vec(word_offset))
-
-    for (i <- 0 until CachelineSize / 4) {
-        new_cacheline(i) := Mux(i.U === word_offset, 
-            new_data,
-            Mux(in.bits.hit, cacheline(i), recv_data_vec(i))
-        )
-    }
+    val new_cacheline = WireInit(cacheline)
+    new_cacheline(word_offset) := MaskExpand(in.bits.mask) & in.bits.data | MaskExpand(~in.bits.mask) & cacheline(word_offset)
 
-    data_wr_req.valid := state === sWORK && ready_to_write && cacheable
-    data_wr_req.bits.idx := get_idx(in.bits.addr)
-    data_wr_req.bits.way := in.bits.hit_or_evict_way
-    data_wr_req.bits.data := new_cacheline
+    data_wr_req.valid := install || wr_hit
+    data_wr_req.bits.idx := Mux(install, line_idx(install_mshr.line), set_idx)
+    data_wr_req.bits.way := Mux(install, install_mshr.way, way)
+    data_wr_req.bits.data := Mux(install, install_line, new_cacheline)
 
     /* ------------- Forward ------------- */
-    io.forward.valid := out.valid
-    io.forward.bits.fwd_meta := new_meta
-    io.forward.bits.fwd_way := in.bits.hit_or_evict_way
-    io.forward.bits.fwd_idx := get_idx(in.bits.addr)
+    io.forward.valid := RegNext(meta_wr_req.valid, false.B)
+    io.forward.bits.fwd_meta := RegNext(meta_wr_req.bits.meta)
+    io.forward.bits.fwd_idx := RegNext(meta_wr_req.bits.idx)
+    io.forward.bits.fwd_way := RegNext(meta_wr_req.bits.way)
 
     /* ---------------- Performance ----------------  */
-    PerfCount("dcache_miss_penalty_tot", content_valid && !hit && cacheable && !out.valid)
+    PerfCount("dcache_miss_penalty_tot", PopCount(ld_wait_valid))
+    PerfCount("dcache_load_wait_busy", ld_wait_valid.asUInt.orR)
+    PerfCount("dcache_load_miss", (do_alloc || do_merge) && is_read)
+    PerfCount("dcache_mshr_occupancy", PopCount(mshr_valid))
+    PerfCount("dcache_mshr_busy", mshr_busy)
+    PerfCount("dcache_mshr_alloc", do_alloc && !is_pft)
+    PerfCount("dcache_mshr_merge", do_merge)
+    PerfCount("dcache_mshr_full", miss_task && !match_any && !free_any && !is_pft)
+    PerfCount("dcache_hit_under_miss", hit_task && mshr_busy && !is_pft)
+    PerfCount("dcache_miss_under_miss", do_alloc && mshr_busy && !is_pft)
+
+    PerfCount("dcache_pft_issued", do_alloc && is_pft)
+    PerfCount("dcache_pft_redundant", pft_drop && (hit || match_any))
+    PerfCount("dcache_pft_nomshr", pft_drop && cacheable && !hit && !match_any)
+    PerfCount("dcache_pft_useful", pft_useful)
+    PerfCount("dcache_pft_late", pft_late)
+    PerfCount("dcache_pft_unused", do_alloc && meta.valid && meta.pft)
 }
 
 class SimpleDCache extends ErythModule {
     val io = IO(new Bundle {
         val req = Flipped(DecoupledIO(new DCacheReq))
         val rsp = ValidIO(new DCacheResp)
+        val pft_hint = Flipped(ValidIO(new LoadPftHint))
 
         val axi = new AXI4
     })
 
-    println(s"DCache: sets = ${sets}, ways = ${ways}, cacheline = ${CachelineSize} bytes, tot = ${sets * ways * CachelineSize} bytes")
+    println(s"DCache: sets = ${sets}, ways = ${ways}, cacheline = ${CachelineSize} bytes, tot = ${sets * ways * CachelineSize} bytes, mshrs = ${nMSHR}")
 
     val (req, rsp) = (io.req, io.rsp)
     val axi = io.axi
@@ -506,7 +684,19 @@ class SimpleDCache extends ErythModule {
     val meta_array = Module(new MetaArray)
     val data_array = Module(new DataArray)
 
-    s1.io.in <> req
+    // demand accesses first, prefetches fill the idle cycles
+    val prefetcher = Module(new Prefetcher)
+    prefetcher.io.pft_hint <> io.pft_hint
+
+    val req_arb = Module(new Arbiter(new DCacheReq, 2))
+    req_arb.io.in(0) <> req
+    req_arb.io.in(1).valid := prefetcher.io.pft_req.valid
+    req_arb.io.in(1).bits := 0.U.asTypeOf(new DCacheReq)
+    req_arb.io.in(1).bits.addr := prefetcher.io.pft_req.bits
+    req_arb.io.in(1).bits.cmd := DCacheCMD.PREFETCH
+    prefetcher.io.pft_req.ready := req_arb.io.in(1).ready
+
+    s1.io.in <> req_arb.io.out
     s1.io.meta_rd_req <> meta_array.io.rd_req
     StageConnect(s1.io.out, s2.io.in)
 
@@ -520,4 +710,4 @@ class SimpleDCache extends ErythModule {
     s3.io.data_wr_req <> data_array.io.wr_req
     s3.io.out <> rsp
     s3.io.axi <> axi
-}
\ No newline at end of file
+}
@@ -5,7 +5,7 @@ import chisel3.util._
 import erythrina.ErythModule
 import erythrina.backend.InstExInfo
 import bus.axi4._
-import utils.{MaskExpand, LookupTree, SignExt, ZeroExt}
+import utils.{MaskExpand, LookupTree, SignExt, ZeroExt, PerfCount}
 import erythrina.backend.fu.{LDUop, EXUInfo}
 import erythrina.frontend.FuType
 import erythrina.memblock.StoreFwdBundle
@@ -13,12 +13,14 @@ import erythrina.backend.rob.ROBPtr
 import erythrina.backend.Redirect
 import erythrina.AddrSpace
 import erythrina.memblock.dcache._
+import erythrina.memblock.dcache.DCacheParams.nLoadSlot
 
 class LDU extends ErythModule {
     val io = IO(new Bundle {
         val req = Flipped(DecoupledIO(new InstExInfo))
         val dcache_req = DecoupledIO(new DCacheReq)
         val dcache_resp = Flipped(ValidIO(new DCacheResp))
+        val pft_hint = ValidIO(new LoadPftHint)     // trains the DCache prefetcher
 
         val st_fwd_query = ValidIO(new StoreFwdBundle)
         val st_fwd_result = Input(new StoreFwdBundle)
@@ -39,68 +41,84 @@ class LDU extends ErythModule {
     val (dcache_req, dcache_resp) = (io.dcache_req, io.dcache_resp)
     val redirect = io.redirect
 
-    val req_addr_err = Wire(Bool())
-
-    val sIDLE :: sREQ :: sRECV :: sDROP :: sERR :: Nil = Enum(5)
-    val state = RegInit(sIDLE)
-
-    switch (state) {
-        is (sIDLE) {
-            when (req.fire && !redirect.valid) {
-                state := sREQ
-            }
-        }
-        is (sREQ) {
-            when (redirect.valid) {
-                state := sIDLE
-            }.elsewhen(dcache_req.fire && !req_addr_err) {
-                state := sRECV
-            }.elsewhen(req_addr_err) {
-                state := sERR
-            }
-        }
-        is (sRECV) {
-            when (dcache_resp.valid && dcache_resp.bits.cmd === DCacheCMD.READ) {
-                state := sIDLE
-            }.elsewhen(redirect.valid) {
-                state := sDROP
-            }
-        }
-        is (sDROP) {
-            when (dcache_resp.valid && dcache_resp.bits.cmd === DCacheCMD.READ) {
-                state := sIDLE
-            }
-        }
-        is (sERR) {
-            state := sIDLE
-        }
-    }
-
-    req.ready := state === sIDLE
-
-    // sREQ
-    val req_task = RegEnable(req.bits, 0.U.asTypeOf(new InstExInfo), req.fire)
+    require(nLoadSlot >= 1, "LDU needs at least one load slot")
+
+    /*
+        A load is held here until the DCache takes it, then waits in a slot
+        for its response. The DCache answers hits at once and misses when
+        their refill is installed, so responses come back out of order and
+        are matched by slot id. A slot flushed by a redirect is only freed
+        once its response is back, its id can't be reused before.
+    */
+    val sFREE :: sRECV :: sDROP :: Nil = Enum(3)
+    val slot_state = RegInit(VecInit(Seq.fill(nLoadSlot)(sFREE)))
+    val slot_task = RegInit(VecInit(Seq.fill(nLoadSlot)(0.U.asTypeOf(new InstExInfo))))
+
+    val free_vec = VecInit(slot_state.map(_ === sFREE))
+    val free_any = free_vec.asUInt.orR
+    val free_idx = PriorityEncoder(free_vec)
+
+    val rsp_valid = dcache_resp.valid && dcache_resp.bits.cmd === DCacheCMD.READ
+    val rsp_id = dcache_resp.bits.id
+
+    // Req
+    val req_valid = RegInit(false.B)
+    val req_task = RegInit(0.U.asTypeOf(new InstExInfo))
     val addr = (req_task.src1 + req_task.src2)
 
     val req_addr = Cat(addr(XLEN - 1, 2), 0.U(2.W))
-    req_addr_err := !AddrSpace.in_addr_space(req_addr)
+    val req_addr_err = !AddrSpace.in_addr_space(req_addr)
 
-    dcache_req.valid := state === sREQ && !redirect.valid && !req_addr_err
+    dcache_req.valid := req_valid && !req_addr_err && free_any && !redirect.valid
     dcache_req.bits := 0.U.asTypeOf(new DCacheReq)
     dcache_req.bits.cmd := DCacheCMD.READ
     dcache_req.bits.addr := req_addr
+    dcache_req.bits.id := free_idx
+
+    io.pft_hint.valid := dcache_req.fire
+    io.pft_hint.bits.pc := req_task.pc
+    io.pft_hint.bits.addr := req_addr
 
     val req_out_task = WireInit(req_task)
     req_out_task.addr := addr
     req_out_task.exception.exceptions.load_access_fault := req_addr_err
 
-    // sRECV
-    val recv_task = RegEnable(req_out_task, 0.U.asTypeOf(new InstExInfo), dcache_req.fire)
+    // a faulting load commits straight from here when no response needs the port
+    val err_cmt = req_valid && req_addr_err && !rsp_valid && !redirect.valid
+
+    req.ready := !req_valid || dcache_req.fire || err_cmt
+
+    when (redirect.valid) {
+        req_valid := false.B
+    }.elsewhen(req.fire) {
+        req_valid := true.B
+        req_task := req.bits
+    }.elsewhen(dcache_req.fire || err_cmt) {
+        req_valid := false.B
+    }
+
+    // Slots
+    when (dcache_req.fire) {
+        slot_state(free_idx) := sRECV
+        slot_task(free_idx) := req_out_task
+    }
+
+    for (i <- 0 until nLoadSlot) {
+        when (rsp_valid && rsp_id === i.U) {
+            slot_state(i) := sFREE
+        }.elsewhen(redirect.valid && slot_state(i) === sRECV) {
+            slot_state(i) := sDROP
+        }
+    }
+
+    // Resp
+    val recv_task = slot_task(rsp_id)
+    val recv_cmt = rsp_valid && slot_state(rsp_id) === sRECV && !redirect.valid
 
     val recv_addr = recv_task.addr
 
     val (fwd_query, fwd_result) = (io.st_fwd_query, io.st_fwd_result)
-    fwd_query.valid := state === sRECV && !redirect.valid
+    fwd_query.valid := rsp_valid && !redirect.valid
     fwd_query.bits := 0.U.asTypeOf(new StoreFwdBundle)
     fwd_query.bits.addr := Cat(recv_addr(XLEN - 1, 2), 0.U(2.W))
     fwd_query.bits.robPtr := recv_task.robPtr
@@ -164,16 +182,14 @@ class LDU extends ErythModule {
     recv_res_blk.addr := Cat(recv_addr(XLEN - 1, 2), 0.U(2.W))
     recv_res_blk.state.finished := true.B
 
-    // sERR
-    val err_task = RegEnable(req_out_task, 0.U.asTypeOf(new InstExInfo), state === sREQ && req_addr_err)
-    val err_res_blk = WireInit(err_task)
-    err_res_blk.addr := Cat(err_task.addr(XLEN - 1, 2), 0.U(2.W))
+    val err_res_blk = WireInit(req_out_task)
+    err_res_blk.addr := Cat(addr(XLEN - 1, 2), 0.U(2.W))
     err_res_blk.state.finished := true.B
     err_res_blk.exception.exceptions.load_access_fault := true.B
 
     // Commit
-    io.ldu_cmt.valid := (dcache_resp.valid && dcache_resp.bits.cmd === DCacheCMD.READ && state === sRECV || state === sERR) && !redirect.valid
-    io.ldu_cmt.bits := Mux(state === sRECV, recv_res_blk, err_res_blk)
+    io.ldu_cmt.valid := recv_cmt || err_cmt
+    io.ldu_cmt.bits := Mux(recv_cmt, recv_res_blk, err_res_blk)
     
     io.rf_write.valid := io.ldu_cmt.valid && io.ldu_cmt.bits.rf_wen
     io.rf_write.bits.addr := io.ldu_cmt.bits.p_rd
@@ -189,4 +205,8 @@ class LDU extends ErythModule {
 
     exu_info.busy := false.B
     exu_info.fu_type_vec := handler_vec.asUInt
+
+    /* ---------------- Performance ----------------  */
+    PerfCount("ldu_inflight", PopCount(slot_state.map(_ =/= sFREE)))
+    PerfCount("ldu_slot_full", req_valid && !req_addr_err && !free_any)
 }
\ No newline at end of file
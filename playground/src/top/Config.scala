@@ -12,6 +12,20 @@ object Config {
 
     var useGHR = false
 
+    var CoreFreqMHz = 1         // CLINT mtime counts microseconds at this clock
+
     var useICachePft = true
-    var useFTQPft = false
+    var useDCachePft = false
+    var useFTQPft = true
+    var FTQPftAhead = 8         // blocks ahead of the one being fetched
+    var FTQFilterSize = 4       // recently prefetched lines the FTQFilter drops
+
+    // core sizes, set by Elaborate --param before elaboration
+    var FTQSize = 16
+    var ROBSize = 64
+    var LoadQueSize = 8
+    var StoreQueSize = 8
+
+    // PerfTop shrinks the caches to 1KB unless --param sets their sets
+    var shrinkPerfCaches = true
 }
\ No newline at end of file
@@ -31,8 +31,10 @@ class SimTop extends Module {
 class PerfTop extends Module {
     Config.isTiming = true
 
-    ICacheParams.sets = 1024 / (ICacheParams.ways * ICacheParams.CachelineSize)
-    DCacheParams.sets = 1024 / (DCacheParams.ways * DCacheParams.CachelineSize)
+    if (Config.shrinkPerfCaches) {
+        ICacheParams.sets = 1024 / (ICacheParams.ways * ICacheParams.CachelineSize)
+        DCacheParams.sets = 1024 / (DCacheParams.ways * DCacheParams.CachelineSize)
+    }
 
     val io = IO(new AXI4)
 
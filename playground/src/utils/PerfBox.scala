@@ -9,6 +9,8 @@ import utils.PerfHelper.tapOrGet
 
 class PerfCtrlIO extends Bundle {
     val clean = Bool()
+    val enable = Bool()
+    val dump = Bool()
 }
 
 object PerfHelper {
@@ -32,15 +34,17 @@ object PerfCount {
                 val perf_event = tapOrGet(event)
                 if (perfCounters.exists(_._1 == name)) {
                     val value = perfCounters.find(_._1 == name).get._2
-                    value := Mux(perf_ctrl.clean, 0.U, value + perf_event)
+                    value := Mux(perf_ctrl.clean, 0.U, Mux(perf_ctrl.enable, value + perf_event, value))
                 }
                 else {
                     val value = RegInit(0.U(64.W))
                     perfCounters += ((name, value))
-                    value := Mux(perf_ctrl.clean, 0.U, value + perf_event)
+                    value := Mux(perf_ctrl.clean, 0.U, Mux(perf_ctrl.enable, value + perf_event, value))
                 }
         }
     }
+    def counters = perfCounters.toSeq
+
     def print = {
         perfCounters.foreach{
             case (name, value) =>
@@ -75,14 +79,63 @@ class PerfCtrlHelper extends BlackBox with HasBlackBoxInline {
     setInline("PerfCtrlHelper.v",
         s"""
         |module PerfCtrlHelper(
-        |    output logic perf_ctrl_clean
+        |    output logic perf_ctrl_clean,
+        |    output logic perf_ctrl_enable,
+        |    output logic perf_ctrl_dump
         |);
         |   export "DPI-C" task set_perf_ctrl_clean;
+        |   export "DPI-C" task set_perf_ctrl_enable;
+        |   export "DPI-C" task set_perf_ctrl_dump;
+        |
+        |   initial perf_ctrl_enable = 1'b1;
+        |   initial perf_ctrl_dump = 1'b0;
         |
         |   task set_perf_ctrl_clean(input logic clean);
         |          perf_ctrl_clean = clean;
         |   endtask
         |
+        |   task set_perf_ctrl_enable(input logic enable);
+        |          perf_ctrl_enable = enable;
+        |   endtask
+        |
+        |   task set_perf_ctrl_dump(input logic dump);
+        |          perf_ctrl_dump = dump;
+        |   endtask
+        |
+        |endmodule
+        """.stripMargin)
+}
+
+// Hands every counter to the emulator on cycles with perf_ctrl.dump set,
+// the snapshot behind --telemetry
+class PerfSampler(names: Seq[String]) extends BlackBox with HasBlackBoxInline {
+    val io = IO(new Bundle {
+        val clock = Input(Clock())
+        val en = Input(Bool())
+        val values = Input(Vec(names.length, UInt(64.W)))
+    })
+
+    val portString = names.indices.map(i => s"    input [63:0] values_${i}").mkString(",\n")
+    val sampleString = names.zipWithIndex.map{
+        case (name, i) =>
+            s"""            perf_sample(${i}, "${name}", values_${i});"""
+    }.mkString("\n")
+
+    setInline("PerfSampler.v",
+        s"""
+        |module PerfSampler(
+        |    input clock,
+        |    input en,
+        """.stripMargin + portString + s"""
+        |);
+        |   import "DPI-C" function void perf_sample(input int idx, input string name, input longint value);
+        |
+        |   always @(posedge clock) begin
+        |       if (en) begin
+        """.stripMargin + sampleString + s"""
+        |       end
+        |   end
+        |
         |endmodule
         """.stripMargin)
 }
@@ -93,6 +146,14 @@ class PerfBox extends Module {
     val perf_ctrl = perf_ctrl_helper.io.perf_ctrl
     PerfCount.collect(perf_ctrl)
 
+    val counters = PerfCount.counters
+    if (counters.nonEmpty) {
+        val perf_sampler = Module(new PerfSampler(counters.map(_._1)))
+        perf_sampler.io.clock := clock
+        perf_sampler.io.en := perf_ctrl.dump
+        perf_sampler.io.values := VecInit(counters.map(_._2))
+    }
+
     when (PerfDumpTrigger.is_triggered) {
         PerfCount.print
     }
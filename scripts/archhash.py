@@ -0,0 +1,110 @@
+"""
+    Arch State Hash Bisection
+    Usage: python3 archhash.py compare A.log B.log
+           python3 archhash.py bisect [-o OUTDIR] SIM_A SIM_B A.log B.log IMAGE [emulator args...]
+
+    The logs come from `VSimTop --hash-stream N`, one "<instrs> <cycles> <hash>"
+    line per N committed instructions. compare reports the first interval
+    whose hashes differ. bisect reruns only up to the end of that interval
+    on both builds with --trace-from, and prints the first differing commit.
+"""
+
+import argparse
+import os
+import subprocess
+import sys
+
+NPC_HOME = os.environ.get("NPC_HOME", os.path.dirname(os.path.dirname(os.path.abspath(__file__))))
+
+
+def read_hashes(path):
+    hashes = []
+    with open(path, "r") as f:
+        for line in f:
+            fields = line.split()
+            if len(fields) == 3:
+                hashes.append((int(fields[0]), int(fields[1]), fields[2]))
+    return hashes
+
+
+def first_divergence(a, b):
+    """Return (begin, end) instrs of the first differing interval, or None."""
+    begin = 0
+    for ha, hb in zip(a, b):
+        if ha[0] != hb[0] or ha[2] != hb[2]:
+            return begin, max(ha[0], hb[0])
+        begin = ha[0]
+    if len(a) != len(b):
+        # one run stopped earlier, its last line is a partial interval
+        longer = a if len(a) > len(b) else b
+        return begin, longer[min(len(a), len(b))][0]
+    return None
+
+
+def compare(path_a, path_b):
+    a, b = read_hashes(path_a), read_hashes(path_b)
+    res = first_divergence(a, b)
+    if res is None:
+        print(f"Identical over {len(a)} intervals, {a[-1][0] if a else 0} instrs")
+    else:
+        print(f"First divergence in instrs [{res[0]}, {res[1]})")
+    return res
+
+
+def rerun(sim, image, outdir, begin, end, extra):
+    os.makedirs(outdir, exist_ok=True)
+    cmd = [sim, image, "-o", outdir, "-i", str(end), "--trace-from", str(begin)] + extra
+    print(" ".join(cmd))
+    with open(os.path.join(outdir, "stdout.log"), "w") as out, \
+         open(os.path.join(outdir, "stderr.log"), "w") as err:
+        subprocess.run(cmd, cwd=outdir, stdout=out, stderr=err)
+    with open(os.path.join(outdir, "trace-window.log"), "r") as f:
+        return f.readlines()
+
+
+def bisect(args):
+    res = compare(args.log_a, args.log_b)
+    if res is None:
+        return 0
+    begin, end = res
+    image = os.path.abspath(args.image)
+    trace_a = rerun(os.path.abspath(args.sim_a), image, os.path.join(args.outdir, "a"), begin, end, args.extra)
+    trace_b = rerun(os.path.abspath(args.sim_b), image, os.path.join(args.outdir, "b"), begin, end, args.extra)
+
+    for la, lb in zip(trace_a, trace_b):
+        if la != lb:
+            print(f"A: {la.rstrip()}")
+            print(f"B: {lb.rstrip()}")
+            return 1
+    if len(trace_a) != len(trace_b):
+        print(f"Same commits until one run stops: A has {len(trace_a)}, B has {len(trace_b)}")
+    else:
+        print("Traces agree, the divergence is past the rerun window")
+    return 1
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Find where two runs' arch state diverges")
+    sub = parser.add_subparsers(dest="cmd", required=True)
+
+    p = sub.add_parser("compare")
+    p.add_argument("log_a")
+    p.add_argument("log_b")
+
+    p = sub.add_parser("bisect")
+    p.add_argument("-o", "--outdir", default=os.path.join(NPC_HOME, "build", "archhash"))
+    p.add_argument("sim_a")
+    p.add_argument("sim_b")
+    p.add_argument("log_a")
+    p.add_argument("log_b")
+    p.add_argument("image")
+    p.add_argument("extra", nargs=argparse.REMAINDER)
+
+    args = parser.parse_args()
+    if args.cmd == "compare":
+        sys.exit(0 if compare(args.log_a, args.log_b) is None else 1)
+    sys.exit(bisect(args))
+
+
+if __name__ == "__main__":
+    main()
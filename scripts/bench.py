@@ -0,0 +1,68 @@
+"""
+    Simulator Speed Benchmark
+    Usage: python3 bench.py --img IMAGE [--arg ARGS] [-n RUNS] [-o OUTDIR] NAME=SIM...
+
+    Runs every simulator build on the same image and reports host time and
+    simulated cycles per second, with the speedup over the first build. The
+    result is appended to OUTDIR/bench.txt, tagged with the git revision.
+"""
+
+import argparse
+import os
+import re
+import shlex
+import subprocess
+import time
+
+cycle_pattern = r"Total Cycles:\s*(\d+), Total Instrs:\s*(\d+)"
+
+
+def run_once(sim, img, args, outdir):
+    os.makedirs(outdir, exist_ok=True)
+    cmd = [sim, img, "-o", outdir] + args
+    start = time.time()
+    with open(os.path.join(outdir, "stdout.log"), "w") as out, \
+         open(os.path.join(outdir, "stderr.log"), "w") as err:
+        subprocess.run(cmd, cwd=outdir, stdout=out, stderr=err, check=True)
+    elapsed = time.time() - start
+    with open(os.path.join(outdir, "stdout.log"), "r", errors="replace") as f:
+        match = re.search(cycle_pattern, f.read())
+    cycles = int(match.group(1)) if match else 0
+    return elapsed, cycles
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Compare simulator build speed")
+    parser.add_argument("sims", nargs="+", help="NAME=PATH of each build")
+    parser.add_argument("--img", required=True)
+    parser.add_argument("--arg", default="")
+    parser.add_argument("-n", "--runs", type=int, default=3, help="best of RUNS")
+    parser.add_argument("-o", "--outdir", default="build/bench")
+    args = parser.parse_args()
+
+    img = os.path.abspath(args.img)
+    extra = shlex.split(args.arg)
+    results = []
+    for spec in args.sims:
+        name, sim = spec.split("=", 1)
+        best = None
+        for i in range(args.runs):
+            res = run_once(os.path.abspath(sim), img, extra, os.path.abspath(os.path.join(args.outdir, name)))
+            if best is None or res[0] < best[0]:
+                best = res
+        results.append((name, best[0], best[1]))
+
+    rev = subprocess.run(["git", "rev-parse", "--short", "HEAD"], capture_output=True, text=True).stdout.strip()
+    lines = [f"# {time.strftime('%Y-%m-%d %H:%M:%S')} {rev} {os.path.basename(img)} {args.arg}"]
+    base = results[0][1]
+    for name, elapsed, cycles in results:
+        khz = cycles / elapsed / 1000 if elapsed else 0
+        lines.append(f"{name:<8} {elapsed:>8.2f}s {cycles:>12} cycles {khz:>10.2f} KHz  x{base / elapsed:.2f}")
+
+    print("\n".join(lines))
+    with open(os.path.join(args.outdir, "bench.txt"), "a") as f:
+        f.write("\n".join(lines) + "\n")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,394 @@
+"""
+    Microarchitecture Characterization Kernels
+    Usage: python3 kernels.py gen [-o OUTDIR] [NAME...]
+           python3 kernels.py check [-o OUTDIR]
+
+    gen assembles small RV32IM kernels, each stressing one mechanism of the
+    core, into OUTDIR/<name>.bin together with a regress.py manifest
+    OUTDIR/kernels.list and the expected bounds OUTDIR/expect.json. The
+    measured loop of every kernel sits between the ROI markers, so the IPC
+    and PerfBox counters cover the loop alone.
+
+    check reads OUTDIR/run/<name>/{stdout,stderr}.log written by
+        python3 regress.py -o OUTDIR/run OUTDIR/kernels.list
+    and compares IPC and counters (per loop iteration) against the bounds.
+
+    The bounds follow from the default core: 2-wide decode, EXU0/EXU1 ALUs,
+    one pipelined MUL, an iterative DIV, 4 loads in flight, 64-entry BTB
+    indexed by pc[7:2] with a TAGE direction predictor and a 16-entry RAS,
+    64KB ICache and DCache. Retune them with the core.
+"""
+
+import argparse
+import json
+import os
+import random
+import re
+import sys
+
+NPC_HOME = os.environ.get("NPC_HOME", os.path.dirname(os.path.dirname(os.path.abspath(__file__))))
+
+MEMBASE = 0x80000000
+ROI_BEGIN = 0x00102013  # slti x0, x0, 1, see emulator/include/isa.h
+ROI_END = 0x00202013    # slti x0, x0, 2
+
+ipc_pattern = r"IPC:\s*([\d.]+)"
+counter_pattern = r"^(\w+):\s*(\d+)$"
+
+ABI = ["zero", "ra", "sp", "gp", "tp", "t0", "t1", "t2", "s0", "s1",
+       "a0", "a1", "a2", "a3", "a4", "a5", "a6", "a7",
+       "s2", "s3", "s4", "s5", "s6", "s7", "s8", "s9", "s10", "s11",
+       "t3", "t4", "t5", "t6"]
+REG = {name: i for i, name in enumerate(ABI)}
+
+
+class Asm:
+    """Just enough of an RV32IM assembler, branch targets are labels."""
+
+    def __init__(self, base=MEMBASE):
+        self.base = base
+        self.words = []
+        self.labels = {}
+        self.fixups = []
+        self.nlabel = 0
+
+    @property
+    def pc(self):
+        return self.base + 4 * len(self.words)
+
+    def new_label(self, hint):
+        self.nlabel += 1
+        return f"{hint}_{self.nlabel}"
+
+    def label(self, name):
+        assert name not in self.labels, name
+        self.labels[name] = self.pc
+
+    def word(self, w):
+        self.words.append(w & 0xffffffff)
+
+    def align(self, nbytes):
+        while self.pc % nbytes:
+            self.addi("zero", "zero", 0)
+
+    def pad(self, addr):
+        while self.pc < addr:
+            self.word(0)
+
+    # formats
+    def r_type(self, op, f3, f7, rd, rs1, rs2):
+        self.word(f7 << 25 | REG[rs2] << 20 | REG[rs1] << 15 | f3 << 12 | REG[rd] << 7 | op)
+
+    def i_type(self, op, f3, rd, rs1, imm):
+        assert -2048 <= imm < 2048, imm
+        self.word((imm & 0xfff) << 20 | REG[rs1] << 15 | f3 << 12 | REG[rd] << 7 | op)
+
+    def s_type(self, f3, rs2, rs1, imm):
+        assert -2048 <= imm < 2048, imm
+        self.word((imm >> 5 & 0x7f) << 25 | REG[rs2] << 20 | REG[rs1] << 15 | f3 << 12 | (imm & 0x1f) << 7 | 0x23)
+
+    @staticmethod
+    def b_imm(off):
+        assert -4096 <= off < 4096 and off % 2 == 0, off
+        return (off >> 12 & 1) << 31 | (off >> 5 & 0x3f) << 25 | (off >> 1 & 0xf) << 8 | (off >> 11 & 1) << 7
+
+    @staticmethod
+    def j_imm(off):
+        assert -(1 << 20) <= off < (1 << 20) and off % 2 == 0, off
+        return (off >> 20 & 1) << 31 | (off >> 1 & 0x3ff) << 21 | (off >> 11 & 1) << 20 | (off >> 12 & 0xff) << 12
+
+    # instructions
+    def addi(self, rd, rs1, imm): self.i_type(0x13, 0, rd, rs1, imm)
+    def andi(self, rd, rs1, imm): self.i_type(0x13, 7, rd, rs1, imm)
+    def slli(self, rd, rs1, sh): self.i_type(0x13, 1, rd, rs1, sh)
+    def srli(self, rd, rs1, sh): self.i_type(0x13, 5, rd, rs1, sh)
+    def add(self, rd, rs1, rs2): self.r_type(0x33, 0, 0x00, rd, rs1, rs2)
+    def xor(self, rd, rs1, rs2): self.r_type(0x33, 4, 0x00, rd, rs1, rs2)
+    def mul(self, rd, rs1, rs2): self.r_type(0x33, 0, 0x01, rd, rs1, rs2)
+    def divu(self, rd, rs1, rs2): self.r_type(0x33, 5, 0x01, rd, rs1, rs2)
+    def lw(self, rd, rs1, imm): self.i_type(0x03, 2, rd, rs1, imm)
+    def sw(self, rs2, rs1, imm): self.s_type(2, rs2, rs1, imm)
+    def jalr(self, rd, rs1, imm): self.i_type(0x67, 0, rd, rs1, imm)
+    def ret(self): self.jalr("zero", "ra", 0)
+    def ebreak(self): self.word(0x00100073)
+
+    def lui(self, rd, imm20):
+        self.word((imm20 & 0xfffff) << 12 | REG[rd] << 7 | 0x37)
+
+    def li(self, rd, val):
+        val &= 0xffffffff
+        lo = val & 0xfff
+        lo = lo - 0x1000 if lo >= 0x800 else lo
+        hi = (val - lo) >> 12 & 0xfffff
+        if hi:
+            self.lui(rd, hi)
+            if lo:
+                self.addi(rd, rd, lo)
+        else:
+            self.addi(rd, "zero", lo)
+
+    def branch(self, f3, rs1, rs2, target):
+        self.fixups.append((len(self.words), "b", target))
+        self.word(REG[rs2] << 20 | REG[rs1] << 15 | f3 << 12 | 0x63)
+
+    def beq(self, rs1, rs2, target): self.branch(0, rs1, rs2, target)
+    def bne(self, rs1, rs2, target): self.branch(1, rs1, rs2, target)
+
+    def jal(self, rd, target):
+        self.fixups.append((len(self.words), "j", target))
+        self.word(REG[rd] << 7 | 0x6f)
+
+    def roi_begin(self): self.word(ROI_BEGIN)
+    def roi_end(self): self.word(ROI_END)
+
+    def exit(self):
+        self.li("a0", 0)
+        self.ebreak()
+
+    def loop(self, iters, body, counter="s1"):
+        top = self.new_label("loop")
+        self.li(counter, iters)
+        self.label(top)
+        body()
+        self.addi(counter, counter, -1)
+        self.bne(counter, "zero", top)
+
+    def finish(self):
+        for idx, kind, target in self.fixups:
+            off = self.labels[target] - (self.base + 4 * idx)
+            self.words[idx] |= self.b_imm(off) if kind == "b" else self.j_imm(off)
+        return b"".join(w.to_bytes(4, "little") for w in self.words)
+
+
+def program(iters, body, setup=None):
+    """setup, then <iters> loops of body between the ROI markers, then good trap"""
+    a = Asm()
+    if setup:
+        setup(a)
+    a.roi_begin()
+    a.loop(iters, lambda: body(a))
+    a.roi_end()
+    a.exit()
+    return a
+
+
+# ---------------------------------------------------------------- kernels
+
+def alu_chain(iters):
+    # one dependency chain: bound by the 1-cycle ALU latency
+    return program(iters, lambda a: [a.addi("t0", "t0", 1) for _ in range(32)])
+
+
+def alu_ilp(iters):
+    # four independent chains over the two ALU ports
+    def body(a):
+        for _ in range(8):
+            for r in ("t0", "t1", "t2", "t3"):
+                a.addi(r, r, 1)
+    return program(iters, body)
+
+
+def mul_tput(iters):
+    # four independent chains of MUL, only EXU1 multiplies
+    def setup(a):
+        a.li("a1", 3)
+        for r in ("t0", "t1", "t2", "t3"):
+            a.li(r, 1)
+    def body(a):
+        for _ in range(8):
+            for r in ("t0", "t1", "t2", "t3"):
+                a.mul(r, r, "a1")
+    return program(iters, body, setup)
+
+
+def div_lat(iters):
+    # independent DIVs still queue on the single iterative divider
+    def setup(a):
+        a.li("a1", 0x7fffffff)
+        a.li("a2", 7)
+    def body(a):
+        for r in ("t0", "t1", "t2", "t3", "t4", "t5", "t6", "s0"):
+            a.divu(r, "a1", "a2")
+    return program(iters, body, setup)
+
+
+PTR_NODES = 4096    # 64B apart: 256KB, four times the DCache
+PTR_STRIDE = 64
+
+def ptr_chase(iters):
+    # one random cycle through all nodes, every load waits for the last
+    order = list(range(PTR_NODES))
+    random.Random(1234).shuffle(order)
+    data = MEMBASE + 0x10000
+    a = program(iters, lambda a: [a.lw("a0", "a0", 0) for _ in range(8)],
+                lambda a: a.li("a0", data + order[0] * PTR_STRIDE))
+    assert a.pc <= data
+    a.pad(data)
+    nodes = [0] * PTR_NODES
+    for k in range(PTR_NODES):
+        nodes[order[k]] = data + order[(k + 1) % PTR_NODES] * PTR_STRIDE
+    for nxt in nodes:
+        a.word(nxt)
+        a.pad(a.pc + PTR_STRIDE - 4)
+    return a
+
+
+def st_ld_fwd(iters):
+    # every load reads the store just before it, through StoreFwdUnit
+    def body(a):
+        for _ in range(8):
+            a.sw("t0", "sp", 0)
+            a.lw("t0", "sp", 0)
+            a.addi("t0", "t0", 1)
+    return program(iters, body, lambda a: a.li("sp", MEMBASE + 0x10000))
+
+
+def br_random(iters):
+    # xorshift32 decides the branch, no history helps
+    def body(a):
+        skip = a.new_label("skip")
+        a.slli("t0", "a0", 13)
+        a.xor("a0", "a0", "t0")
+        a.srli("t0", "a0", 17)
+        a.xor("a0", "a0", "t0")
+        a.slli("t0", "a0", 5)
+        a.xor("a0", "a0", "t0")
+        a.andi("t1", "a0", 1)
+        a.beq("t1", "zero", skip)
+        a.addi("t2", "t2", 1)
+        a.label(skip)
+    return program(iters, body, lambda a: a.li("a0", 0x12345678))
+
+
+BTB_ALIAS = 8
+
+def btb_alias(iters):
+    # taken branches 256B apart share one BTB entry and evict each other
+    def body(a):
+        start = a.pc
+        for i in range(BTB_ALIAS):
+            nxt = a.new_label("alias")
+            a.beq("zero", "zero", nxt)
+            a.pad(start + 256 * (i + 1))
+            a.label(nxt)
+    return program(iters, body)
+
+
+def call_ret(iters):
+    # two call sites of one function, its return alternates targets, which
+    # a BTB alone gets wrong every time and the RAS gets right
+    def body(a):
+        a.jal("ra", "func")
+        a.addi("t1", "t1", 1)
+        a.jal("ra", "func")
+        a.addi("t2", "t2", 1)
+    a = program(iters, body)
+    a.label("func")
+    a.addi("t0", "t0", 1)
+    a.ret()
+    return a
+
+
+IC_BLOCKS = 2048    # one 64B line each: 128KB, twice the ICache
+
+def icache_thrash(iters):
+    # line-sized blocks chained by jal in random order, beyond the ICache
+    # and out of reach of the next-line prefetcher
+    order = list(range(IC_BLOCKS))
+    random.Random(5678).shuffle(order)
+    succ = {order[k]: f"blk{order[k + 1]}" for k in range(IC_BLOCKS - 1)}
+    succ[order[-1]] = "ret"
+
+    def body(a):
+        a.jal("ra", f"blk{order[0]}")
+
+    a = program(iters, body)
+    a.align(64)
+    for i in range(IC_BLOCKS):
+        a.label(f"blk{i}")
+        for _ in range(15):
+            a.addi("t0", "t0", 1)
+        a.jal("zero", succ[i])
+    a.label("ret")
+    a.ret()
+    return a
+
+
+# name: (builder, iterations, bounds), counters are per iteration
+KERNELS = {
+    "alu_chain":     (alu_chain, 2000, {"ipc": (0.7, 1.05)}),
+    "alu_ilp":       (alu_ilp, 2000, {"ipc": (1.2, 2.0)}),
+    "mul_tput":      (mul_tput, 1000, {"ipc": (0.6, 1.05)}),
+    "div_lat":       (div_lat, 200, {"ipc": (0.015, 0.08)}),
+    "ptr_chase":     (ptr_chase, PTR_NODES * 2 // 8, {"ipc": (0.0, 0.2), "dcache_miss": (6.0, 8.0)}),
+    "st_ld_fwd":     (st_ld_fwd, 1000, {"ipc": (0.1, 1.5), "dcache_miss": (0.0, 0.1),
+                                        "redirect_store2load": (0.0, 1.0)}),
+    "br_random":     (br_random, 4000, {"bpu_wrong_br": (0.3, 0.75)}),
+    "btb_alias":     (btb_alias, 500, {"bpu_wrong_br": (BTB_ALIAS - 2, BTB_ALIAS + 1)}),
+    "call_ret":      (call_ret, 2000, {"bpu_wrong_ret": (0.0, 0.1), "bpu_correct_ret": (1.9, 2.1)}),
+    "icache_thrash": (icache_thrash, 4, {"ipc": (0.0, 1.0), "icache_miss": (IC_BLOCKS * 0.75, IC_BLOCKS + 8)}),
+}
+
+
+def gen(args):
+    os.makedirs(args.outdir, exist_ok=True)
+    names = args.names or list(KERNELS)
+    expect = {}
+    with open(os.path.join(args.outdir, "kernels.list"), "w") as manifest:
+        manifest.write("# <name> <image> [emulator args...], generated by kernels.py\n")
+        for name in names:
+            builder, iters, bounds = KERNELS[name]
+            a = builder(iters)
+            image = os.path.abspath(os.path.join(args.outdir, f"{name}.bin"))
+            with open(image, "wb") as f:
+                f.write(a.finish())
+            manifest.write(f"{name:<16} {image} -d builtin\n")
+            expect[name] = {"iters": iters, "bounds": bounds}
+            print(f"{name:<16} {len(a.words) * 4:>8} bytes")
+    with open(os.path.join(args.outdir, "expect.json"), "w") as f:
+        json.dump(expect, f, indent=2)
+
+
+def check(args):
+    with open(os.path.join(args.outdir, "expect.json")) as f:
+        expect = json.load(f)
+    failed = 0
+    print(f"{'Kernel':<16} {'Metric':<20} {'Value':>10} {'Bound':>20}")
+    print("-" * 72)
+    for name, exp in expect.items():
+        run_dir = os.path.join(args.outdir, "run", name)
+        try:
+            with open(os.path.join(run_dir, "stdout.log"), errors="replace") as f:
+                match = re.search(ipc_pattern, f.read())
+            with open(os.path.join(run_dir, "stderr.log"), errors="replace") as f:
+                counters = {k: int(v) for k, v in re.findall(counter_pattern, f.read(), re.M)}
+        except OSError:
+            print(f"{name:<16} {'-':<20} {'no log':>10}")
+            failed += 1
+            continue
+        values = {"ipc": float(match.group(1)) if match else None}
+        for metric in exp["bounds"]:
+            if metric != "ipc":
+                values[metric] = counters[metric] / exp["iters"] if metric in counters else None
+        for metric, (lo, hi) in exp["bounds"].items():
+            v = values[metric]
+            ok = v is not None and lo <= v <= hi
+            failed += not ok
+            shown = f"{v:.4f}" if v is not None else "-"
+            print(f"{name:<16} {metric:<20} {shown:>10} {f'[{lo}, {hi}]':>20}  {'OK' if ok else 'FAIL'}")
+    print("-" * 72)
+    print(f"Out of bound: {failed}")
+    sys.exit(1 if failed else 0)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Generate and check characterization kernels")
+    parser.add_argument("cmd", choices=["gen", "check"])
+    parser.add_argument("names", nargs="*", help="kernels to generate, all by default")
+    parser.add_argument("-o", "--outdir", default=os.path.join(NPC_HOME, "build", "kernels"))
+    args = parser.parse_args()
+    gen(args) if args.cmd == "gen" else check(args)
+
+
+if __name__ == "__main__":
+    main()
@@ -19,5 +19,10 @@ perf: $(PERF_VERILOG_SRC)
 
 opt: $(PERF_VERILOG_SRC)
 	@yosys ./scripts/perf.ys > $(BUILD_DIR)/yosys.log
-	
-.PHONY: perf run-micro
\ No newline at end of file
+
+# e.g. make sweep SWEEP_ARG="-p ROBSize=32,64 -p BTBSize=32,64,128 --area opt"
+SWEEP_ARG ?= -p ROBSize=32,64
+sweep:
+	DIFF_SO=$(DIFF_SO) python3 $(NPC_HOME)/scripts/sweep.py $(SWEEP_ARG) -m $(REGRESS_LIST) -o $(BUILD_DIR)/sweep
+
+.PHONY: perf run-micro sweep
\ No newline at end of file
@@ -0,0 +1,147 @@
+"""
+    Parallel Regression Runner
+    Usage: python3 regress.py [-j JOBS] [-t TIMEOUT] [-o OUTDIR] [--sim SIM] MANIFEST
+
+    Each non-empty manifest line describes one job:
+        <name> <image> [emulator args...]
+    Lines starting with '#' are comments. Environment variables such as
+    $NPC_HOME or $DIFF_SO are expanded, an unset one stops the run. Every
+    job runs in its own directory OUTDIR/<name>, with stdout.log, stderr.log,
+    waveform and trace kept apart.
+"""
+
+import argparse
+import json
+import os
+import re
+import shlex
+import signal
+import subprocess
+import sys
+import time
+from concurrent.futures import ThreadPoolExecutor
+
+NPC_HOME = os.environ.get("NPC_HOME", os.path.dirname(os.path.dirname(os.path.abspath(__file__))))
+
+trap_pattern = r"Hit \S*(Good|Bad|Break|Interrupt|Unknown)\S* Trap"
+ipc_pattern = r"IPC:\s*([\d.]+)"
+cycle_pattern = r"Total Cycles:\s*(\d+), Total Instrs:\s*(\d+)"
+error_pattern = r"\[Error\].*"
+
+
+def parse_manifest(path):
+    jobs = []
+    names = set()
+    # $NPC_HOME defaults to this checkout, like NPC_HOME above
+    os.environ.setdefault("NPC_HOME", NPC_HOME)
+    with open(path, "r") as f:
+        for lineno, line in enumerate(f, 1):
+            line = line.strip()
+            if not line or line.startswith("#"):
+                continue
+            line = os.path.expandvars(line)
+            unset = re.search(r"\$\{?\w+\}?", line)
+            if unset:
+                sys.exit(f"{path}:{lineno}: {unset.group(0)} is not set")
+            fields = shlex.split(line)
+            if len(fields) < 2:
+                sys.exit(f"{path}:{lineno}: expect '<name> <image> [args...]'")
+            name, image, args = fields[0], fields[1], fields[2:]
+            if name in names:
+                sys.exit(f"{path}:{lineno}: duplicate job name '{name}'")
+            names.add(name)
+            jobs.append({"name": name, "image": os.path.abspath(image), "args": args})
+    return jobs
+
+
+def run_job(job, sim, outdir, timeout):
+    job_dir = os.path.abspath(os.path.join(outdir, job["name"]))
+    os.makedirs(os.path.join(job_dir, "build"), exist_ok=True)
+
+    cmd = [sim, job["image"], "-o", job_dir] + job["args"]
+    result = {"name": job["name"], "cmd": " ".join(cmd), "trap": "Unknown",
+              "ipc": None, "cycles": None, "instrs": None, "signature": ""}
+
+    start = time.time()
+    with open(os.path.join(job_dir, "stdout.log"), "w") as out, \
+         open(os.path.join(job_dir, "stderr.log"), "w") as err:
+        # own process group, so a timeout also takes down LightSSS (-f) children
+        proc = subprocess.Popen(cmd, cwd=job_dir, stdout=out, stderr=err, start_new_session=True)
+        try:
+            result["returncode"] = proc.wait(timeout=timeout)
+        except subprocess.TimeoutExpired:
+            os.killpg(proc.pid, signal.SIGKILL)
+            proc.wait()
+            result["trap"] = "Timeout"
+            result["returncode"] = None
+    result["time"] = time.time() - start
+
+    with open(os.path.join(job_dir, "stdout.log"), "r", errors="replace") as f:
+        log = f.read()
+
+    if result["trap"] != "Timeout":
+        match = re.search(trap_pattern, log)
+        if match:
+            result["trap"] = match.group(1)
+    match = re.search(cycle_pattern, log)
+    if match:
+        result["cycles"] = int(match.group(1))
+        result["instrs"] = int(match.group(2))
+    match = re.search(ipc_pattern, log)
+    if match:
+        result["ipc"] = float(match.group(1))
+    match = re.search(error_pattern, log)
+    if match:
+        result["signature"] = match.group(0)
+    elif result["trap"] == "Timeout":
+        result["signature"] = f"host timeout after {timeout}s"
+
+    result["pass"] = result["trap"] in ("Good", "Break") and result["returncode"] == 0
+    return result
+
+
+def print_summary(results, f):
+    f.write(f"{'Name':<24} {'Trap':<10} {'IPC':>8} {'Cycles':>12} {'Time(s)':>8}  Signature\n")
+    f.write("-" * 80 + "\n")
+    for r in results:
+        ipc = f"{r['ipc']:.5f}" if r["ipc"] is not None else "-"
+        cycles = str(r["cycles"]) if r["cycles"] is not None else "-"
+        f.write(f"{r['name']:<24} {r['trap']:<10} {ipc:>8} {cycles:>12} {r['time']:>8.1f}  {r['signature']}\n")
+    f.write("-" * 80 + "\n")
+    passed = sum(r["pass"] for r in results)
+    f.write(f"Passed: {passed}/{len(results)}\n")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Run emulator jobs concurrently")
+    parser.add_argument("manifest")
+    parser.add_argument("-j", "--jobs", type=int, default=os.cpu_count())
+    parser.add_argument("-t", "--timeout", type=int, default=3600, help="per-job timeout in seconds")
+    parser.add_argument("-o", "--outdir", default=os.path.join(NPC_HOME, "build", "regress"))
+    parser.add_argument("--sim", default=os.path.join(NPC_HOME, "build", "obj_dir", "SimTop", "VSimTop"))
+    args = parser.parse_args()
+
+    jobs = parse_manifest(args.manifest)
+    sim = os.path.abspath(args.sim)
+    os.makedirs(args.outdir, exist_ok=True)
+
+    print(f"Running {len(jobs)} jobs with {args.jobs} workers, results in {args.outdir}")
+    with ThreadPoolExecutor(max_workers=args.jobs) as pool:
+        futures = [pool.submit(run_job, job, sim, args.outdir, args.timeout) for job in jobs]
+        results = []
+        for future in futures:
+            r = future.result()
+            print(f"[{'PASS' if r['pass'] else 'FAIL'}] {r['name']}")
+            results.append(r)
+
+    print_summary(results, sys.stdout)
+    with open(os.path.join(args.outdir, "summary.txt"), "w") as f:
+        print_summary(results, f)
+    with open(os.path.join(args.outdir, "summary.json"), "w") as f:
+        json.dump(results, f, indent=2)
+
+    sys.exit(0 if all(r["pass"] for r in results) else 1)
+
+
+if __name__ == "__main__":
+    main()
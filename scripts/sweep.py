@@ -0,0 +1,231 @@
+"""
+    Microarchitecture Parameter Sweep
+    Usage: python3 sweep.py -p NAME=V1,V2 [-p ...] [-m MANIFEST] [-j JOBS] [--area opt|sta] [-o OUTDIR]
+
+    Every point of the grid is elaborated with Elaborate --param into its own
+    build directory OUTDIR/<point>, then the points are verilated in parallel
+    and run the regress.py manifest. IPC is the geometric mean over the jobs,
+    top-down shares are taken from the counters summed over their stderr.log.
+
+    With --area, PerfTop of every point also goes through yosys:
+        opt  synth + ltp + stat as in make opt: cell count and logic depth
+        sta  make perf with yosys-sta: chip area and timing
+    The points on the Pareto front of IPC against cost are starred in
+    OUTDIR/sweep.txt, the full results are in OUTDIR/sweep.json.
+"""
+
+import argparse
+import itertools
+import json
+import math
+import os
+import re
+import shutil
+import subprocess
+import sys
+from concurrent.futures import ThreadPoolExecutor
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from regress import NPC_HOME, parse_manifest, run_job
+
+topdown_pattern = r"topdown_(\w+):\s*(\d+)"
+cells_pattern = r"Number of cells:\s*(\d+)"
+depth_pattern = r"Longest topological path in \S+ \(length=(\d+)\)"
+chip_area_pattern = r"Chip area for (?:top )?module\s+'?\\?PerfTop'?:\s*([\d.]+)"
+freq_pattern = r"(?i)freq\S*\s*[:=|]?\s*([\d.]+)\s*MHz"
+
+
+def parse_grid(specs):
+    names, values = [], []
+    for spec in specs:
+        name, vals = spec.split("=", 1)
+        names.append(name)
+        values.append(vals.split(","))
+    points = []
+    for combo in itertools.product(*values):
+        params = dict(zip(names, combo))
+        tag = "-".join(f"{k}{v}" for k, v in params.items()) or "base"
+        points.append({"name": tag, "params": params})
+    return points
+
+
+def make(point, target, log):
+    elab = " ".join(f"--param {k}={v}" for k, v in point["params"].items())
+    cmd = ["make", "-C", NPC_HOME, f"BUILD_DIR={point['dir']}", f"ELAB_ARGS={elab}", target]
+    with open(log, "a") as f:
+        f.write("$ " + " ".join(cmd) + "\n")
+        f.flush()
+        return subprocess.run(cmd, stdout=f, stderr=subprocess.STDOUT).returncode == 0
+
+
+def prepare_dir(point):
+    # rebuild everything when the point was last built with other params
+    stamp = os.path.join(point["dir"], "params.json")
+    if os.path.exists(stamp):
+        with open(stamp) as f:
+            if json.load(f) == point["params"]:
+                return
+        for sub in ("rtl_sim", "rtl_perf", "obj_dir"):
+            shutil.rmtree(os.path.join(point["dir"], sub), ignore_errors=True)
+    os.makedirs(point["dir"], exist_ok=True)
+    with open(stamp, "w") as f:
+        json.dump(point["params"], f)
+
+
+def elaborate(point, area):
+    # one at a time, concurrent mill runs fight over the out/ directory
+    log = os.path.join(point["dir"], "build.log")
+    ok = make(point, os.path.join(point["dir"], "rtl_sim", "SimTop.sv"), log)
+    if ok and area:
+        ok = make(point, os.path.join(point["dir"], "rtl_perf", "PerfTop.sv"), log)
+    return ok
+
+
+def synth_opt(point):
+    sv = os.path.join(point["dir"], "rtl_perf", "PerfTop.sv")
+    ys = os.path.join(point["dir"], "area.ys")
+    with open(ys, "w") as f:
+        f.write(f"read_verilog -sv {sv}\nhierarchy -top PerfTop\nsynth -flatten -top PerfTop\nltp -noff\nstat\n")
+    log = os.path.join(point["dir"], "yosys.log")
+    with open(log, "w") as f:
+        subprocess.run(["yosys", ys], stdout=f, stderr=subprocess.STDOUT)
+    with open(log, errors="replace") as f:
+        text = f.read()
+    cells = re.findall(cells_pattern, text)
+    depth = re.search(depth_pattern, text)
+    return {"cost": int(cells[-1]) if cells else None,
+            "depth": int(depth.group(1)) if depth else None}
+
+
+def synth_sta(point):
+    make(point, "perf", os.path.join(point["dir"], "build.log"))
+    res = {"cost": None, "freq": None}
+    for root, _, files in os.walk(point["dir"]):
+        for name in files:
+            if not name.endswith((".txt", ".rpt", ".log")):
+                continue
+            with open(os.path.join(root, name), errors="replace") as f:
+                text = f.read()
+            match = re.search(chip_area_pattern, text)
+            if match:
+                res["cost"] = float(match.group(1))
+            match = re.search(freq_pattern, text)
+            if match and name.endswith(".rpt"):
+                res["freq"] = float(match.group(1))
+    return res
+
+
+def build(point, area):
+    log = os.path.join(point["dir"], "build.log")
+    point["built"] = make(point, "verilate", log)
+    if point["built"] and area == "opt":
+        point.update(synth_opt(point))
+    elif point["built"] and area == "sta":
+        point.update(synth_sta(point))
+    return point
+
+
+def collect(point, results):
+    passed = [r for r in results if r["pass"] and r["ipc"]]
+    point["jobs"] = {r["name"]: r["ipc"] for r in results}
+    point["pass"] = len(passed) == len(results)
+    point["ipc"] = math.exp(sum(math.log(r["ipc"]) for r in passed) / len(passed)) if passed else None
+
+    # same definitions as topdown.py, on the counters of all jobs together
+    topdown = {}
+    for r in results:
+        path = os.path.join(point["dir"], "run", r["name"], "stderr.log")
+        if not os.path.exists(path):
+            continue
+        with open(path, errors="replace") as f:
+            for key, value in re.findall(topdown_pattern, f.read()):
+                topdown[key] = topdown.get(key, 0) + int(value)
+    slots = topdown.get("TotalSlots", 0)
+    if slots:
+        fe = topdown["FetchBubbles"] / slots
+        bad = (topdown["SlotsIssued"] - topdown["SlotsRetired"]) / slots
+        ret = topdown["SlotsRetired"] / slots
+        point["topdown"] = {"FrontendBound": fe, "BadSpeculation": bad,
+                            "Retiring": ret, "BackendBound": 1 - fe - bad - ret}
+
+
+def mark_pareto(points):
+    # higher IPC and lower cost both win, points without either are left out
+    valid = [p for p in points if p.get("ipc") and p.get("cost") is not None]
+    for p in valid:
+        p["pareto"] = not any(q is not p and q["ipc"] >= p["ipc"] and q["cost"] <= p["cost"] and
+                              (q["ipc"] > p["ipc"] or q["cost"] < p["cost"]) for q in valid)
+
+
+def print_table(points, area, f):
+    f.write(f"{'Point':<40} {'IPC':>8} {'Cost':>12} {'Timing':>8}  {'FE':>6} {'Bad':>6} {'Ret':>6} {'BE':>6}\n")
+    f.write("-" * 100 + "\n")
+    key = (lambda p: p["cost"]) if area else (lambda p: -p["ipc"])
+    ranked = sorted([p for p in points if p.get("ipc") and (not area or p.get("cost") is not None)], key=key)
+    for p in ranked + [p for p in points if p not in ranked]:
+        mark = "*" if p.get("pareto") else " "
+        ipc = f"{p['ipc']:.5f}" if p.get("ipc") else "-"
+        cost = f"{p['cost']:.0f}" if p.get("cost") is not None else "-"
+        timing = p.get("depth") or p.get("freq") or "-"
+        td = p.get("topdown")
+        shares = " ".join(f"{td[k]:>6.1%}" for k in ("FrontendBound", "BadSpeculation", "Retiring", "BackendBound")) \
+            if td else "     -      -      -      -"
+        status = "" if p.get("pass") else "  (failed)"
+        f.write(f"{mark}{p['name']:<39} {ipc:>8} {cost:>12} {timing:>8}  {shares}{status}\n")
+    f.write("-" * 100 + "\n")
+    if area == "opt":
+        f.write("Cost: yosys cells of PerfTop, Timing: logic depth\n")
+    elif area == "sta":
+        f.write("Cost: chip area of PerfTop, Timing: MHz from yosys-sta\n")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Sweep core parameters")
+    parser.add_argument("-p", "--param", action="append", default=[], help="NAME=V1,V2,... of Elaborate --param")
+    parser.add_argument("-m", "--manifest", default=os.path.join(NPC_HOME, "scripts", "regress.list"))
+    parser.add_argument("-j", "--jobs", type=int, default=os.cpu_count(), help="concurrent emulator runs")
+    parser.add_argument("-b", "--build-jobs", type=int, default=max(1, os.cpu_count() // 4),
+                        help="concurrent verilator builds, each uses 4 threads")
+    parser.add_argument("-t", "--timeout", type=int, default=3600, help="per-job timeout in seconds")
+    parser.add_argument("--area", choices=["opt", "sta"], help="also synthesize PerfTop of every point")
+    parser.add_argument("-o", "--outdir", default=os.path.join(NPC_HOME, "build", "sweep"))
+    args = parser.parse_args()
+
+    points = parse_grid(args.param)
+    jobs = parse_manifest(args.manifest)
+    outdir = os.path.abspath(args.outdir)
+    for p in points:
+        p["dir"] = os.path.join(outdir, p["name"])
+        prepare_dir(p)
+
+    print(f"Sweeping {len(points)} points x {len(jobs)} jobs, results in {outdir}")
+    for p in points:
+        p["elaborated"] = elaborate(p, args.area)
+        print(f"[{'ELAB' if p['elaborated'] else 'FAIL'}] {p['name']}")
+    ready = [p for p in points if p["elaborated"]]
+
+    with ThreadPoolExecutor(max_workers=args.build_jobs) as pool:
+        for p in pool.map(lambda p: build(p, args.area), ready):
+            print(f"[{'BUILD' if p['built'] else 'FAIL'}] {p['name']}")
+    ready = [p for p in ready if p["built"]]
+
+    with ThreadPoolExecutor(max_workers=args.jobs) as pool:
+        futures = {}
+        for p in ready:
+            sim = os.path.join(p["dir"], "obj_dir", "SimTop", "VSimTop")
+            run_dir = os.path.join(p["dir"], "run")
+            futures[p["name"]] = [pool.submit(run_job, job, sim, run_dir, args.timeout) for job in jobs]
+        for p in ready:
+            collect(p, [f.result() for f in futures[p["name"]]])
+            print(f"[{'PASS' if p['pass'] else 'FAIL'}] {p['name']}")
+
+    mark_pareto(points)
+    print_table(points, args.area, sys.stdout)
+    with open(os.path.join(outdir, "sweep.txt"), "w") as f:
+        print_table(points, args.area, f)
+    with open(os.path.join(outdir, "sweep.json"), "w") as f:
+        json.dump(points, f, indent=2)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,119 @@
+"""
+    Live Telemetry Monitor
+    Usage: python3 telemon.py [-n SECS] [-c REGEX] [--once] [--json] [PAGE...]
+
+    Shows the pages published by emulators run with --telemetry <cycles>,
+    /dev/shm/erythrina-* by default, refreshed every SECS like top. -c also
+    lists the PerfBox counters whose names match REGEX. --once prints a
+    single snapshot, --json makes it machine readable for scrapers.
+
+    Layout of the page: emulator/include/telemetry.h
+"""
+
+import argparse
+import glob
+import json
+import mmap
+import os
+import re
+import struct
+import sys
+import time
+
+TELEMETRY_MAGIC = 0x4d4c4554
+TELEMETRY_VERSION = 1
+TELEMETRY_NAME_LEN = 48
+
+header_fmt = "<IIIIQ256sQQdddQIIQ"
+counter_fmt = f"<{TELEMETRY_NAME_LEN}sQ"
+header_size = struct.calcsize(header_fmt)
+counter_size = struct.calcsize(counter_fmt)
+seq_offset = 16
+
+states = ["Run", "Good", "Bad", "Break", "Interrupt"]
+
+
+def read_page(path, tries=100):
+    """Consistent copy of a page, None when it is gone or not ready"""
+    try:
+        with open(path, "rb") as f:
+            mm = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+    except (OSError, ValueError):
+        return None
+    with mm:
+        for _ in range(tries):
+            seq = struct.unpack_from("<Q", mm, seq_offset)[0]
+            if seq & 1:
+                continue
+            data = mm[:]
+            if struct.unpack_from("<Q", mm, seq_offset)[0] == seq:
+                break
+        else:
+            return None
+
+    fields = struct.unpack_from(header_fmt, data)
+    magic, version, size, pid = fields[:4]
+    if magic != TELEMETRY_MAGIC or version != TELEMETRY_VERSION or size > len(data):
+        return None
+    page = dict(zip(["seq", "image", "cycles", "instrs", "ipc", "ipc_window", "kips",
+                     "host_ms", "state", "ncounters", "counter_cycles"], fields[4:]))
+    page["path"] = path
+    page["pid"] = pid
+    page["image"] = page["image"].split(b"\0", 1)[0].decode(errors="replace")
+    page["state"] = states[page["state"]] if page["state"] < len(states) else str(page["state"])
+    page["alive"] = os.path.exists(f"/proc/{pid}")
+    counters = {}
+    for i in range(page["ncounters"]):
+        name, value = struct.unpack_from(counter_fmt, data, header_size + i * counter_size)
+        counters[name.split(b"\0", 1)[0].decode(errors="replace")] = value
+    page["counters"] = counters
+    return page
+
+
+def render(pages, pattern):
+    lines = [f"{'PID':>8} {'State':<9} {'Cycles':>14} {'Instrs':>14} {'IPC':>7} {'IPC(win)':>8} "
+             f"{'KIPS':>9} {'Up(s)':>8}  Image"]
+    for p in pages:
+        state = p["state"] if p["alive"] else "Gone"
+        lines.append(f"{p['pid']:>8} {state:<9} {p['cycles']:>14} {p['instrs']:>14} {p['ipc']:>7.4f} "
+                     f"{p['ipc_window']:>8.4f} {p['kips']:>9.2f} {p['host_ms'] / 1000:>8.1f}  "
+                     f"{os.path.basename(p['image'])}")
+        if pattern:
+            for name, value in p["counters"].items():
+                if re.search(pattern, name):
+                    lines.append(f"{'':>10}{name}: {value}")
+            if p["counters"]:
+                lines.append(f"{'':>10}(counters at cycle {p['counter_cycles']})")
+    return "\n".join(lines)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Watch emulator telemetry pages")
+    parser.add_argument("pages", nargs="*", help="page files, /dev/shm/erythrina-* by default")
+    parser.add_argument("-n", "--interval", type=float, default=1.0, help="refresh period in seconds")
+    parser.add_argument("-c", "--counters", metavar="REGEX", help="also show matching PerfBox counters")
+    parser.add_argument("--once", action="store_true", help="print one snapshot and exit")
+    parser.add_argument("--json", action="store_true", help="print the snapshot as JSON, implies --once")
+    args = parser.parse_args()
+
+    while True:
+        paths = args.pages or sorted(glob.glob("/dev/shm/erythrina-*"))
+        pages = [p for p in map(read_page, paths) if p]
+        if args.json:
+            json.dump(pages, sys.stdout, indent=2)
+            print()
+            return
+        if args.once:
+            print(render(pages, args.counters))
+            return
+        sys.stdout.write("\033[H\033[J" + time.strftime("%H:%M:%S") + f"  {len(pages)} emulators\n")
+        sys.stdout.write(render(pages, args.counters) + "\n")
+        sys.stdout.flush()
+        try:
+            time.sleep(args.interval)
+        except KeyboardInterrupt:
+            return
+
+
+if __name__ == "__main__":
+    main()
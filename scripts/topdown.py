@@ -26,6 +26,9 @@ icache_data = {}
 dcache_pattern = r"dcache_(\w+):\s*(\d+)"
 dcache_data = {}
 
+dram_pattern = r"dram_(\w+):\s*(\d+)"
+dram_data = {}
+
 with open(topdown_file, "r") as f:
     lines = f.readlines()
     topdown = {}
@@ -50,6 +53,13 @@ with open(topdown_file, "r") as f:
             value = int(match.group(2))
             dcache_data[key] = value
 
+        # Get DRAM data
+        match = re.search(dram_pattern, line)
+        if match:
+            key = match.group(1)
+            value = int(match.group(2))
+            dram_data[key] = value
+
         # Get BPU data
         match = re.search(bpu_pattern, line)
         if match:
@@ -76,16 +86,68 @@ with open(topdown_file, "r") as f:
 # Proccess Icache Data
 icache_data["HitRate"] = (icache_data["hit"] / (icache_data["hit"] + icache_data["miss"]))
 icache_data["MissPenalty"] = (icache_data["miss_penalty_tot"] / icache_data["miss"])
+# FTQ prefetches: lines brought in ahead of fetch, how far ahead they were sent,
+# and the demand misses still left (compare FrontendBound_Miss with useFTQPft off)
+ftq_pft_req = icache_data.get("pft_ftq_req", 0)
+icache_data["PftFTQAhead"] = icache_data.get("pft_ftq_ahead_tot", 0) / ftq_pft_req if ftq_pft_req else 0
+icache_data["PftFTQFiltered"] = icache_data.get("pft_ftq_filtered", 0) / (ftq_pft_req + icache_data.get("pft_ftq_filtered", 0)) if ftq_pft_req else 0
+ftq_pft_lookup = icache_data.get("pft_ftq_miss", 0) + icache_data.get("pft_ftq_hit", 0)
+icache_data["PftMissRate"] = icache_data.get("pft_ftq_miss", 0) / ftq_pft_lookup if ftq_pft_lookup else 0
 
 # Proccess DCache Data
 dcache_data["HitRate"] = (dcache_data["hit"] / (dcache_data["hit"] + dcache_data["miss"]))
-dcache_data["MissPenalty"] = (dcache_data["miss_penalty_tot"] / dcache_data["miss"])
+# cycles a load waits for its refill, stores retire into the MSHRs at once
+load_miss = dcache_data.get("load_miss", dcache_data["miss"])
+dcache_data["MissPenalty"] = (dcache_data["miss_penalty_tot"] / load_miss) if load_miss else 0
+# loads waiting for refills at the same time, while any is
+load_wait_busy = dcache_data.get("load_wait_busy", 0)
+dcache_data["LoadMLP"] = dcache_data["miss_penalty_tot"] / load_wait_busy if load_wait_busy else 0
+mshr_reqs = dcache_data.get("mshr_alloc", 0) + dcache_data.get("mshr_merge", 0)
+dcache_data["MSHRMergeRate"] = dcache_data.get("mshr_merge", 0) / mshr_reqs if mshr_reqs else 0
+# average MSHRs in use while any is
+mshr_busy = dcache_data.get("mshr_busy", 0)
+dcache_data["MSHROccupancy"] = dcache_data.get("mshr_occupancy", 0) / mshr_busy if mshr_busy else 0
+# prefetches: accuracy over the lines brought in, coverage over the misses left,
+# timeliness over the useful ones (a late one still had a demand miss waiting)
+pft_issued = dcache_data.get("pft_issued", 0)
+pft_useful = dcache_data.get("pft_useful", 0)
+pft_late = dcache_data.get("pft_late", 0)
+dcache_data["PftAccuracy"] = (pft_useful + pft_late) / pft_issued if pft_issued else 0
+dcache_data["PftCoverage"] = (pft_useful + pft_late) / (pft_useful + dcache_data["miss"]) if pft_useful + dcache_data["miss"] else 0
+dcache_data["PftTimeliness"] = pft_useful / (pft_useful + pft_late) if pft_useful + pft_late else 0
+
+# Proccess DRAM Data
+dram_res = {}
+if dram_data.get("cycles", 0) > 0:
+    cycles = dram_data["cycles"]
+    reqs = 0
+    for d in ("read", "write"):
+        n = dram_data[f"{d}_reqs"]
+        reqs += n
+        dram_res[f"{d}_QueueLatency"] = dram_data[f"{d}_queue_tot"] / n if n else 0
+        dram_res[f"{d}_ServiceLatency"] = dram_data[f"{d}_service_tot"] / n if n else 0
+        dram_res[f"{d}_Occupancy"] = dram_data[f"{d}_service_tot"] / cycles
+    dram_res["RowHitRate"] = dram_data["row_hits"] / reqs if reqs else 0
+    bank_busy = [v for k, v in dram_data.items() if re.match(r"bank\d+_busy", k)]
+    dram_res["BankUtilMax"] = max(bank_busy) / cycles if bank_busy else 0
+    rank_busy = {k: v for k, v in dram_data.items() if re.match(r"rank\d+_busy", k)}
+    for k, v in rank_busy.items():
+        dram_res[f"{k.split('_')[0]}_Util"] = v / cycles
 
 # Proccess BPU Data
-if (bpu_data["correct"]["exu"] + bpu_data["wrong"]["exu"] == 0):
-    bpu_data["CorrectRate"] = 0
-else:
-    bpu_data["CorrectRate"] = (bpu_data["correct"]["exu"] / (bpu_data["correct"]["exu"] + bpu_data["wrong"]["exu"]))
+def correct_rate(correct, wrong):
+    return correct / (correct + wrong) if correct + wrong else 0
+
+bpu_data["CorrectRate"] = correct_rate(bpu_data["correct"]["exu"], bpu_data["wrong"]["exu"])
+bpu_data["CondCorrectRate"] = correct_rate(bpu_data["correct"].get("br", 0), bpu_data["wrong"].get("br", 0))
+bpu_data["RetCorrectRate"] = correct_rate(bpu_data["correct"].get("ret", 0), bpu_data["wrong"].get("ret", 0))
+
+# TAGE providers, as seen when the committed branches train it
+tage_res = {}
+for key, value in bpu_data.items():
+    if re.match(r"tage_(base|t\d+)$", key):
+        tage_res[key[len("tage_"):]] = (value.get("correct", 0), value.get("wrong", 0))
+tage_total = sum(c + w for c, w in tage_res.values())
 
 
 with open(topdown_res_file, "w") as f:
@@ -97,17 +159,54 @@ with open(topdown_res_file, "w") as f:
     f.write("ICache Data\n")
     f.write(f"HitRate: {icache_data['HitRate']:.2%}\n")
     f.write(f"MissPenalty: {icache_data['MissPenalty']:.2f}\n")
+    if ftq_pft_req:
+        f.write(f"FetchMissBubbles: {topdown['FetchMissBubbles']}, LateCycles: {icache_data.get('pft_late_cycles', 0)}\n")
+        f.write(f"PftFTQAhead: {icache_data['PftFTQAhead']:.2f}\n")
+        f.write(f"PftFTQFiltered: {icache_data['PftFTQFiltered']:.2%}\n")
+        f.write(f"PftMissRate: {icache_data['PftMissRate']:.2%}\n")
 
     f.write("-"*40 + "\n")
 
     f.write("DCache Data\n")
     f.write(f"HitRate: {dcache_data['HitRate']:.2%}\n")
     f.write(f"MissPenalty: {dcache_data['MissPenalty']:.2f}\n")
+    f.write(f"MSHRMergeRate: {dcache_data['MSHRMergeRate']:.2%}\n")
+    f.write(f"LoadMLP: {dcache_data['LoadMLP']:.2f}\n")
+    f.write(f"MSHROccupancy: {dcache_data['MSHROccupancy']:.2f}\n")
+    if pft_issued:
+        f.write(f"PftAccuracy: {dcache_data['PftAccuracy']:.2%}\n")
+        f.write(f"PftCoverage: {dcache_data['PftCoverage']:.2%}\n")
+        f.write(f"PftTimeliness: {dcache_data['PftTimeliness']:.2%}\n")
 
     f.write("-"*40 + "\n")
 
+    if dram_res:
+        f.write("DRAM Data\n")
+        for d in ("read", "write"):
+            f.write(f"{d} QueueLatency: {dram_res[d + '_QueueLatency']:.2f}, "
+                    f"ServiceLatency: {dram_res[d + '_ServiceLatency']:.2f}, "
+                    f"Occupancy: {dram_res[d + '_Occupancy']:.2f}\n")
+        f.write(f"RowHitRate: {dram_res['RowHitRate']:.2%}\n")
+        f.write(f"BankUtilMax: {dram_res['BankUtilMax']:.2%}\n")
+        for k, v in dram_res.items():
+            if k.startswith("rank"):
+                f.write(f"{k}: {v:.2%}\n")
+
+        f.write("-"*40 + "\n")
+
     f.write("BPU Data\n")
     f.write(f"CorrectRate: {bpu_data['CorrectRate']:.2%}\n")
+    f.write(f"CondCorrectRate: {bpu_data['CondCorrectRate']:.2%}\n")
+    f.write(f"RetCorrectRate: {bpu_data['RetCorrectRate']:.2%}\n")
+    for key, (c, w) in sorted(tage_res.items()):
+        f.write(f"TAGE {key} Provided: {(c + w) / tage_total if tage_total else 0:.2%}, "
+                f"CorrectRate: {correct_rate(c, w):.2%}\n")
+    if "tage_alloc" in bpu_data:
+        f.write(f"TAGE AllocFail: {bpu_data['tage_alloc'].get('fail', 0)}, "
+                f"AllocSucc: {bpu_data['tage_alloc'].get('succ', 0)}\n")
+    if "ras" in bpu_data:
+        f.write(f"RAS Push: {bpu_data['ras'].get('push', 0)}, Pop: {bpu_data['ras'].get('pop', 0)}, "
+                f"Restore: {bpu_data['ras'].get('restore', 0)}, Recover: {bpu_data['ras'].get('recover', 0)}\n")
 
     
 print(f"Writing topdown result to {topdown_res_file}")
\ No newline at end of file
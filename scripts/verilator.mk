@@ -17,7 +17,7 @@ LLVM_LFLG = $(shell llvm-config-14 --libs)
 
 CFLG += -I$(EMU_DIR)/include ${LLVM_CFLG} -I$(DRAMSIM_HOME)/src\
 		-DDRAMSIM3_CONFIG=\\\"$(DRAMSIM_HOME)/configs/XiangShan.ini\\\" -DDRAMSIM3_OUTDIR=\\\"$(BUILD_DIR)\\\"
-LFLG += ${LLVM_LFLG}
+LFLG += ${LLVM_LFLG} -lrt
 VFLG += --exe -cc --trace-fst -O3 --build -j 4 -CFLAGS "${CFLG}" -LDFLAGS "${LFLG}" --autoflush
 
 ifeq ($(TOP_NAME), SimTop)
@@ -32,6 +32,43 @@ $(SIM_TARGET): $(SIM_VERILOG_SRC) $(EMU_CSRC)
 	$(VERILATOR) $(VFLG) --Mdir $(OBJ_DIR) --top-module $(TOP_NAME) $(VSRCS) $(EMU_CSRC) $(DRAM_SRC)
 
 verilate: $(SIM_TARGET)
+
+debug: $(SIM_TARGET)
+
+# Fast model for performance runs: no tracing, fast X handling, LTO, and
+# PGO trained on microbench-test. The instrumented and final builds share
+# FAST_OBJ_DIR so the profile matches the objects by path.
+FAST_OBJ_DIR = $(BUILD_DIR)/obj_dir/$(TOP_NAME)-fast
+FAST_TARGET = $(FAST_OBJ_DIR)/V$(TOP_NAME)
+PGO_DIR = $(BUILD_DIR)/pgo
+PGO_IMG ?= $(NPC_HOME)/ready-to-run/microbench-riscv32-npc-test.bin
+PGO_ARG ?= -d builtin
+
+FAST_VFLG = --exe -cc -O3 --x-assign fast --x-initial fast --build -j 4
+FAST_CFLG = $(CFLG) -O3 -flto=auto
+FAST_LFLG = $(LFLG) -O3 -flto=auto
+PGO_GEN_FLG = -fprofile-generate=$(PGO_DIR) -fprofile-update=atomic
+PGO_USE_FLG = -fprofile-use=$(PGO_DIR) -fprofile-partial-training -Wno-missing-profile
+
+$(FAST_TARGET): $(SIM_VERILOG_SRC) $(EMU_CSRC)
+	rm -rf $(FAST_OBJ_DIR) $(PGO_DIR)
+	mkdir -p $(FAST_OBJ_DIR) $(PGO_DIR)
+	$(VERILATOR) $(FAST_VFLG) -CFLAGS "$(FAST_CFLG) $(PGO_GEN_FLG)" -LDFLAGS "$(FAST_LFLG) $(PGO_GEN_FLG)" \
+		--Mdir $(FAST_OBJ_DIR) --top-module $(TOP_NAME) $(VSRCS) $(EMU_CSRC) $(DRAM_SRC)
+	cd $(PGO_DIR) && $(FAST_TARGET) $(PGO_IMG) $(PGO_ARG) -o $(PGO_DIR) > train.log 2>&1
+	find $(FAST_OBJ_DIR) -name "*.o" -or -name "*.a" | xargs rm -f
+	rm -f $(FAST_TARGET)
+	$(VERILATOR) $(FAST_VFLG) -CFLAGS "$(FAST_CFLG) $(PGO_USE_FLG)" -LDFLAGS "$(FAST_LFLG) $(PGO_USE_FLG)" \
+		--Mdir $(FAST_OBJ_DIR) --top-module $(TOP_NAME) $(VSRCS) $(EMU_CSRC) $(DRAM_SRC)
+
+fast: $(FAST_TARGET)
+
+BENCH_IMG ?= $(PERF_IMG)
+BENCH_ARG ?= -d builtin
+
+bench: $(SIM_TARGET) $(FAST_TARGET)
+	python3 $(NPC_HOME)/scripts/bench.py --img $(BENCH_IMG) --arg="$(BENCH_ARG)" \
+		-o $(BUILD_DIR)/bench debug=$(SIM_TARGET) fast=$(FAST_TARGET)
 	
 sim: $(SIM_TARGET)
 	$(call git_commit, "sim RTL") # DO NOT REMOVE THIS LINE!!!
@@ -40,7 +77,54 @@ sim: $(SIM_TARGET)
 topdown:
 	@python3 $(NPC_HOME)/scripts/topdown.py
 
+REGRESS_LIST ?= $(NPC_HOME)/scripts/regress.list
+REGRESS_JOBS ?= $(shell nproc)
+
+regress: $(SIM_TARGET)
+	DIFF_SO=$(DIFF_SO) python3 $(NPC_HOME)/scripts/regress.py -j $(REGRESS_JOBS) --sim $(SIM_TARGET) \
+		-o $(BUILD_DIR)/regress $(REGRESS_LIST)
+
+# Targeted kernels with expected IPC and counter bounds, see scripts/kernels.py
+KERNEL_DIR = $(BUILD_DIR)/kernels
+
+kernels: $(SIM_TARGET)
+	python3 $(NPC_HOME)/scripts/kernels.py gen -o $(KERNEL_DIR)
+	-python3 $(NPC_HOME)/scripts/regress.py -j $(REGRESS_JOBS) --sim $(SIM_TARGET) \
+		-o $(KERNEL_DIR)/run $(KERNEL_DIR)/kernels.list
+	python3 $(NPC_HOME)/scripts/kernels.py check -o $(KERNEL_DIR)
+
+# Offline DRAM model runs on a trace from --mem-trace
+MEMREPLAY = $(BUILD_DIR)/memreplay
+MEMREPLAY_SRC = $(NPC_HOME)/tools/memreplay.cpp
+
+$(MEMREPLAY): $(MEMREPLAY_SRC) $(EMU_DIR)/include/memtrace.h
+	mkdir -p $(BUILD_DIR)
+	$(CXX) -O2 -std=c++17 -I$(EMU_DIR)/include -I$(DRAMSIM_HOME)/src \
+		-DDRAMSIM3_CONFIG=\"$(DRAMSIM_HOME)/configs/XiangShan.ini\" -o $@ $(MEMREPLAY_SRC) $(DRAM_SRC)
+
+memreplay: $(MEMREPLAY)
+
+# BTB/ICache/DCache models on a trace from --commit-trace
+UARCHSIM = $(BUILD_DIR)/uarchsim
+UARCHSIM_SRC = $(NPC_HOME)/tools/uarchsim.cpp
+
+$(UARCHSIM): $(UARCHSIM_SRC) $(EMU_DIR)/include/cmttrace.h
+	mkdir -p $(BUILD_DIR)
+	$(CXX) -O2 -std=c++17 -I$(EMU_DIR)/include -o $@ $(UARCHSIM_SRC) -lpthread
+
+uarchsim: $(UARCHSIM)
+
+# Instruction mix, dependency distances and ideal IPC of a --commit-trace
+CMTSTAT = $(BUILD_DIR)/cmtstat
+CMTSTAT_SRC = $(NPC_HOME)/tools/cmtstat.cpp
+
+$(CMTSTAT): $(CMTSTAT_SRC) $(EMU_DIR)/include/cmttrace.h
+	mkdir -p $(BUILD_DIR)
+	$(CXX) -O2 -std=c++17 -I$(EMU_DIR)/include -o $@ $(CMTSTAT_SRC)
+
+cmtstat: $(CMTSTAT)
+
 wave:
 	$(GTKWAVE) -r .gtkwaverc waveform
 
-.PHONY: verilate
\ No newline at end of file
+.PHONY: verilate regress kernels debug fast bench memreplay uarchsim cmtstat
\ No newline at end of file
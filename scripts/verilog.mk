@@ -5,6 +5,9 @@ RTL_PERF_DIR = $(BUILD_DIR)/rtl_perf
 
 SCALA_SRC = $(shell find $(PRJ)/src -name "*.scala")
 
+# --param Name=Value overrides of the core sizes, see scripts/sweep.py
+ELAB_ARGS ?=
+
 SIM_VERILOG_SRC = $(RTL_SIM_DIR)/SimTop.sv
 PERF_VERILOG_SRC = $(RTL_PERF_DIR)/PerfTop.sv
 
@@ -12,7 +15,7 @@ $(SIM_VERILOG_SRC): $(SCALA_SRC)
 	@echo "Generating Verilog files..."
 	$(call git_commit, "generate verilog")
 	mkdir -p $(RTL_SIM_DIR)
-	mill -i $(PRJ).runMain Elaborate --target-dir $(RTL_SIM_DIR)
+	mill -i $(PRJ).runMain Elaborate --target-dir $(RTL_SIM_DIR) $(ELAB_ARGS)
 	sed -i '/firrtl_black_box_resource_files.f/, $$d' $@
 	@echo "Verilog files generated in $(RTL_SIM_DIR)"
 
@@ -20,7 +23,7 @@ $(PERF_VERILOG_SRC): $(SCALA_SRC)
 	@echo "Generating Verilog files..."
 	$(call git_commit, "generate verilog")
 	mkdir -p $(RTL_PERF_DIR)
-	mill -i $(PRJ).runMain Elaborate --target-dir $(RTL_PERF_DIR) --perf
+	mill -i $(PRJ).runMain Elaborate --target-dir $(RTL_PERF_DIR) --perf $(ELAB_ARGS)
 	sed -i '/firrtl_black_box_resource_files.f/, $$d' $@
 	@echo "Verilog files generated in $(RTL_PERF_DIR)"
 
@@ -0,0 +1,414 @@
+// Commit stream analysis: instruction mix per FuType, register dependency
+// distances, load-to-use distances, and the IPC an ideal core with this
+// core's widths, ports and latencies would reach on the same stream.
+//
+// The input is a --commit-trace file, or a fifo the emulator writes while
+// running. The ideal core has a perfect frontend and caches: instructions
+// enter the window DecodeWidth per cycle, issue when their sources and
+// port are ready, and retire in order CommitWidth per cycle. Comparing its
+// IPC with the achieved one shows the headroom; the issue-limit breakdown
+// shows whether width, dependencies or long-latency units bound it.
+
+#include "cmttrace.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <getopt.h>
+#include <unordered_map>
+#include <vector>
+
+// erythrina/Parameters.scala
+#define DECODE_WIDTH    2
+#define COMMIT_WIDTH    5
+#define ROB_SIZE        64
+
+enum FuType { FU_ALU, FU_BRU, FU_MUL, FU_DIV, FU_LDU, FU_STU, FU_CSR, FU_NUM };
+static const char *fu_name[FU_NUM] = {"alu", "bru", "mul", "div", "ldu", "stu", "csr"};
+
+// Execution latency in cycles. MUL is the 3-stage pipeline of Multiplier,
+// DIV the 33-bit iterative DivCore plus its FSM, LDU a DCache hit through
+// the 3-stage pipeline; DIV takes one request at a time, the LDU one a
+// cycle with its load slots never running out on hits.
+struct Latency {
+    int lat[FU_NUM] = {1, 1, 3, 35, 5, 1, 1};
+};
+
+struct DecInst {
+    FuType fu;
+    int rs1;        // -1 when not read
+    int rs2;
+    int rd;         // -1 when not written
+};
+
+static DecInst decode(uint32_t inst) {
+    uint32_t opcode = inst & 0x7f;
+    uint32_t funct3 = (inst >> 12) & 0x7;
+    uint32_t funct7 = inst >> 25;
+    int rd = (inst >> 7) & 0x1f;
+    int rs1 = (inst >> 15) & 0x1f;
+    int rs2 = (inst >> 20) & 0x1f;
+
+    DecInst d = {FU_ALU, -1, -1, -1};
+    switch (opcode) {
+    case 0x37: case 0x17:                   // lui, auipc
+        d.rd = rd;
+        break;
+    case 0x6f:                              // jal
+        d.fu = FU_BRU; d.rd = rd;
+        break;
+    case 0x67:                              // jalr
+        d.fu = FU_BRU; d.rs1 = rs1; d.rd = rd;
+        break;
+    case 0x63:                              // branch
+        d.fu = FU_BRU; d.rs1 = rs1; d.rs2 = rs2;
+        break;
+    case 0x03:
+        d.fu = FU_LDU; d.rs1 = rs1; d.rd = rd;
+        break;
+    case 0x23:
+        d.fu = FU_STU; d.rs1 = rs1; d.rs2 = rs2;
+        break;
+    case 0x13:
+        d.rs1 = rs1; d.rd = rd;
+        break;
+    case 0x33:
+        if (funct7 == 0x01) {
+            d.fu = funct3 < 4 ? FU_MUL : FU_DIV;
+        }
+        d.rs1 = rs1; d.rs2 = rs2; d.rd = rd;
+        break;
+    case 0x73:
+        d.fu = FU_CSR;
+        if (funct3 != 0) {
+            d.rs1 = rs1; d.rd = rd;
+        }
+        break;
+    default:
+        break;
+    }
+    // x0 is neither a dependency nor a result
+    if (d.rs1 == 0) d.rs1 = -1;
+    if (d.rs2 == 0) d.rs2 = -1;
+    if (d.rd == 0) d.rd = -1;
+    return d;
+}
+
+/* ------------------------- Distances ------------------------- */
+
+#define DIST_BUCKETS 9
+static const char *dist_name[DIST_BUCKETS] = {"1", "2", "3", "4", "5-8", "9-16", "17-32", "33-64", ">64"};
+
+static int dist_bucket(uint64_t d) {
+    if (d <= 4) return d - 1;
+    if (d <= 8) return 4;
+    if (d <= 16) return 5;
+    if (d <= 32) return 6;
+    if (d <= 64) return 7;
+    return 8;
+}
+
+/* ------------------------- Ideal core ------------------------- */
+
+enum Limit { LIM_WIDTH, LIM_WINDOW, LIM_DEP_ALU, LIM_DEP_LONG, LIM_DEP_LOAD, LIM_DEP_MEM, LIM_PORT, LIM_NUM };
+static const char *limit_name[LIM_NUM] = {
+    "width", "rob window", "alu/bru dependency", "mul/div dependency",
+    "load dependency", "store-to-load", "port conflict"};
+
+// Cycles with each port taken, for the pipelined ports that later
+// instructions can fill out of order
+#define PORT_WINDOW 4096
+struct PortTable {
+    uint64_t stamp[PORT_WINDOW];
+    uint8_t used[PORT_WINDOW];
+
+    bool busy(uint64_t cycle) {
+        uint32_t i = cycle % PORT_WINDOW;
+        return stamp[i] == cycle && used[i];
+    }
+    void take(uint64_t cycle) {
+        uint32_t i = cycle % PORT_WINDOW;
+        stamp[i] = cycle;
+        used[i] = 1;
+    }
+};
+
+struct Analyzer {
+    Latency lat;
+
+    // mix and distances
+    uint64_t n = 0;
+    uint64_t mix[FU_NUM] = {};
+    uint64_t dep_dist[DIST_BUCKETS] = {};
+    uint64_t dep_none = 0;
+    uint64_t l2u_dist[DIST_BUCKETS] = {};
+    uint64_t l2u_unused = 0;
+
+    uint64_t reg_writer[32] = {};       // index + 1 of the last writer
+    FuType reg_fu[32] = {};
+    bool reg_load_used[32] = {};
+
+    // achieved
+    uint32_t first_cycle = 0;
+    uint32_t last_cycle = 0;
+    uint64_t cycles = 0;
+
+    // ideal core
+    uint64_t reg_ready[32] = {};
+    uint64_t df_ready[32] = {};         // unconstrained dataflow
+    uint64_t df_end = 0;
+    std::unordered_map<uint32_t, uint64_t> store_ready;    // word -> data ready, ideal core
+    std::unordered_map<uint32_t, uint64_t> df_store_ready;
+    uint64_t commit_cycle[ROB_SIZE] = {};
+    uint64_t last_commit = 0;
+    int last_commit_num = 0;
+    uint64_t ldu_free = 0;
+    uint64_t stu_free = 0;
+    uint64_t div_free = 0;
+    PortTable exu0 = {};    // ALU, BRU, CSR
+    PortTable exu1 = {};    // ALU, MUL
+    uint64_t limit[LIM_NUM] = {};
+
+    void add_dist(uint64_t *hist, uint64_t d) {
+        hist[dist_bucket(d)]++;
+    }
+
+    void source(int r) {
+        if (r < 0) {
+            return;
+        }
+        if (reg_writer[r] == 0) {
+            dep_none++;
+            return;
+        }
+        uint64_t d = n - (reg_writer[r] - 1);
+        add_dist(dep_dist, d);
+        if (reg_fu[r] == FU_LDU && !reg_load_used[r]) {
+            add_dist(l2u_dist, d);
+            reg_load_used[r] = true;
+        }
+    }
+
+    void record(const CmtTraceRecord *rec) {
+        DecInst d = decode(rec->inst);
+        mix[d.fu]++;
+
+        if (n == 0) {
+            first_cycle = rec->cycle;
+        }
+        else {
+            cycles += (uint32_t)(rec->cycle - last_cycle);
+        }
+        last_cycle = rec->cycle;
+
+        source(d.rs1);
+        source(d.rs2);
+        ideal(d, rec->addr);
+        dataflow(d, rec->addr);
+
+        if (d.rd >= 0) {
+            if (reg_fu[d.rd] == FU_LDU && reg_writer[d.rd] && !reg_load_used[d.rd]) {
+                l2u_unused++;
+            }
+            reg_writer[d.rd] = n + 1;
+            reg_fu[d.rd] = d.fu;
+            reg_load_used[d.rd] = false;
+        }
+        n++;
+    }
+
+    // Only true dependencies and latencies, no widths or ports
+    void dataflow(const DecInst &d, uint32_t addr) {
+        uint64_t t = 0;
+        if (d.rs1 >= 0) t = std::max(t, df_ready[d.rs1]);
+        if (d.rs2 >= 0) t = std::max(t, df_ready[d.rs2]);
+        if (d.fu == FU_LDU) {
+            auto it = df_store_ready.find(addr);
+            if (it != df_store_ready.end()) t = std::max(t, it->second);
+        }
+        uint64_t done = t + lat.lat[d.fu];
+        if (d.rd >= 0) df_ready[d.rd] = done;
+        if (d.fu == FU_STU) df_store_ready[addr] = done;
+        df_end = std::max(df_end, done);
+    }
+
+    uint64_t issue_port(PortTable *port, uint64_t t) {
+        while (port->busy(t)) t++;
+        return t;
+    }
+
+    void ideal(const DecInst &d, uint32_t addr) {
+        // dual decode/rename, and a ROB entry freed by an older commit
+        uint64_t dispatch = n / DECODE_WIDTH;
+        Limit why = LIM_WIDTH;
+        if (n >= ROB_SIZE && commit_cycle[n % ROB_SIZE] > dispatch) {
+            dispatch = commit_cycle[n % ROB_SIZE];
+            why = LIM_WINDOW;
+        }
+
+        uint64_t t = dispatch;
+        int srcs[2] = {d.rs1, d.rs2};
+        for (int r : srcs) {
+            if (r >= 0 && reg_ready[r] > t) {
+                t = reg_ready[r];
+                FuType fu = reg_fu[r];
+                why = fu == FU_LDU ? LIM_DEP_LOAD : (fu == FU_MUL || fu == FU_DIV) ? LIM_DEP_LONG : LIM_DEP_ALU;
+            }
+        }
+        if (d.fu == FU_LDU) {
+            auto it = store_ready.find(addr);
+            if (it != store_ready.end() && it->second > t) {
+                t = it->second;
+                why = LIM_DEP_MEM;
+            }
+        }
+
+        uint64_t ready = t;
+        switch (d.fu) {
+        case FU_BRU: case FU_CSR:
+            t = issue_port(&exu0, t);
+            exu0.take(t);
+            break;
+        case FU_MUL:
+            t = issue_port(&exu1, t);
+            exu1.take(t);
+            break;
+        case FU_ALU: {
+            uint64_t t0 = issue_port(&exu0, t), t1 = issue_port(&exu1, t);
+            t = std::min(t0, t1);
+            (t1 <= t0 ? exu1 : exu0).take(t);
+            break;
+        }
+        case FU_LDU:
+            t = std::max(t, ldu_free);
+            ldu_free = t + 1;
+            break;
+        case FU_STU:
+            t = std::max(t, stu_free);
+            stu_free = t + 1;
+            break;
+        case FU_DIV:
+            t = std::max(t, div_free);
+            div_free = t + lat.lat[FU_DIV];
+            break;
+        default:
+            break;
+        }
+        if (t > ready) {
+            why = LIM_PORT;
+        }
+        limit[why]++;
+
+        uint64_t done = t + lat.lat[d.fu];
+        if (d.rd >= 0) reg_ready[d.rd] = done;
+        if (d.fu == FU_STU) store_ready[addr] = done;
+
+        // in order, CommitWidth per cycle
+        uint64_t c = std::max(done, last_commit);
+        if (c == last_commit && last_commit_num == COMMIT_WIDTH) {
+            c++;
+        }
+        last_commit_num = c == last_commit ? last_commit_num + 1 : 1;
+        last_commit = c;
+        commit_cycle[n % ROB_SIZE] = c;
+    }
+
+    void report() {
+        double achieved = cycles ? (double)n / cycles : 0;
+        double ideal_ipc = (double)n / (last_commit + 1);
+        double df_ipc = df_end ? (double)n / df_end : 0;
+        printf("instrs: %lu, cycles: %lu\n", n, cycles);
+        printf("IPC achieved: %.4lf, ideal core: %.4lf, dataflow limit: %.4lf, width limit: %d\n",
+            achieved, ideal_ipc, df_ipc, DECODE_WIDTH);
+        printf("headroom: %.1lf%% of the ideal core\n", ideal_ipc ? 100 * (1 - achieved / ideal_ipc) : 0.0);
+
+        printf("\n%-8s %12s %8s\n", "fu", "count", "pct");
+        for (int i = 0; i < FU_NUM; i++) {
+            printf("%-8s %12lu %7.2lf%%\n", fu_name[i], mix[i], n ? 100.0 * mix[i] / n : 0.0);
+        }
+
+        uint64_t deps = dep_none, l2u = l2u_unused;
+        for (int i = 0; i < DIST_BUCKETS; i++) {
+            deps += dep_dist[i];
+            l2u += l2u_dist[i];
+        }
+        printf("\n%-8s %12s %8s %12s %8s\n", "distance", "deps", "pct", "load-use", "pct");
+        for (int i = 0; i < DIST_BUCKETS; i++) {
+            printf("%-8s %12lu %7.2lf%% %12lu %7.2lf%%\n", dist_name[i],
+                dep_dist[i], deps ? 100.0 * dep_dist[i] / deps : 0.0,
+                l2u_dist[i], l2u ? 100.0 * l2u_dist[i] / l2u : 0.0);
+        }
+        printf("%-8s %12lu %7.2lf%% %12lu %7.2lf%%\n", "none",
+            dep_none, deps ? 100.0 * dep_none / deps : 0.0,
+            l2u_unused, l2u ? 100.0 * l2u_unused / l2u : 0.0);
+
+        printf("\nideal core issue limited by\n");
+        for (int i = 0; i < LIM_NUM; i++) {
+            printf("%-20s %12lu %7.2lf%%\n", limit_name[i], limit[i], n ? 100.0 * limit[i] / n : 0.0);
+        }
+    }
+};
+
+int main(int argc, char *argv[]) {
+    const char *trace = nullptr;
+    Analyzer *an = new Analyzer();
+
+    const struct option long_options[] = {
+        {"mul-lat", required_argument, NULL, 'm'},
+        {"div-lat", required_argument, NULL, 'd'},
+        {"ld-lat", required_argument, NULL, 'l'},
+        {0, 0, NULL, 0}
+    };
+    int o;
+    while ((o = getopt_long(argc, argv, "-m:d:l:", long_options, NULL)) != -1) {
+        switch (o) {
+            case 'm':
+                an->lat.lat[FU_MUL] = strtol(optarg, NULL, 0);
+                break;
+            case 'd':
+                an->lat.lat[FU_DIV] = strtol(optarg, NULL, 0);
+                break;
+            case 'l':
+                an->lat.lat[FU_LDU] = strtol(optarg, NULL, 0);
+                break;
+            case 1:
+                trace = optarg;
+                break;
+            default:
+                printf("Usage: %s [OPTION...] TRACE\n", argv[0]);
+                printf("\t-m <cycles>          MUL latency, %d by default.\n", Latency().lat[FU_MUL]);
+                printf("\t-d <cycles>          DIV latency, %d by default.\n", Latency().lat[FU_DIV]);
+                printf("\t-l <cycles>          Load hit latency, %d by default.\n", Latency().lat[FU_LDU]);
+                return 0;
+        }
+    }
+    if (trace == nullptr) {
+        printf("[Error] No trace given\n");
+        return 1;
+    }
+
+    // streamed, so TRACE may be a fifo fed by a running emulator
+    FILE *fp = fopen(trace, "rb");
+    if (fp == nullptr) {
+        printf("[Error] Cannot open %s\n", trace);
+        return 1;
+    }
+    CmtTraceHeader header;
+    if (fread(&header, sizeof(header), 1, fp) != 1 ||
+        header.magic != CMTTRACE_MAGIC || header.version != CMTTRACE_VERSION) {
+        printf("[Error] %s is not a commit trace\n", trace);
+        return 1;
+    }
+    std::vector<CmtTraceRecord> buf(1 << 16);
+    size_t got;
+    while ((got = fread(buf.data(), sizeof(CmtTraceRecord), buf.size(), fp)) > 0) {
+        for (size_t i = 0; i < got; i++) {
+            an->record(&buf[i]);
+        }
+    }
+    fclose(fp);
+
+    an->report();
+    delete an;
+    return 0;
+}
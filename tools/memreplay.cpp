@@ -0,0 +1,325 @@
+// Replay a DRAM transaction trace recorded with --mem-trace through a DRAM
+// timing model, without the RTL, and report latency and bandwidth.
+//
+// By default the replay is closed loop like AXI4Memory: a read waits for
+// the previous read of its AXI id (the DCache uses one id per MSHR), writes
+// go one at a time, and the gap the core left between that response and the
+// next request is kept. With --open every request is issued at its recorded
+// cycle, which shows what the model could sustain for a core with more
+// outstanding misses.
+
+#include "memtrace.h"
+#include "cosimulation.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <getopt.h>
+#include <string>
+#include <vector>
+
+#ifndef DRAMSIM3_CONFIG
+#define DRAMSIM3_CONFIG "XiangShan.ini"
+#endif
+
+struct Txn {
+    MemTraceRecord rec;
+    uint64_t issue;     // replayed cycles
+    uint64_t accept;
+    uint64_t done;
+    bool finished;
+};
+
+// Timing model under test, one request in and one response out per call
+class Model {
+public:
+    virtual ~Model() {}
+    virtual bool will_accept(uint32_t addr, bool is_write) = 0;
+    virtual void add(uint32_t addr, bool is_write, Txn *txn) = 0;
+    virtual Txn *response(bool is_write) = 0;
+    virtual void tick() = 0;
+};
+
+class DramsimModel : public Model {
+    CoDRAMsim3 *dram;
+public:
+    DramsimModel(const char *config, const char *outdir) {
+        dram = new ComplexCoDRAMsim3(config, outdir, 0);
+    }
+    ~DramsimModel() {
+        delete dram;
+    }
+    bool will_accept(uint32_t addr, bool is_write) override {
+        return dram->will_accept(addr, is_write);
+    }
+    void add(uint32_t addr, bool is_write, Txn *txn) override {
+        auto req = new CoDRAMRequest();
+        req->address = addr;
+        req->is_write = is_write;
+        req->meta = txn;
+        dram->add_request(req);
+    }
+    Txn *response(bool is_write) override {
+        auto rsp = is_write ? dram->check_write_response() : dram->check_read_response();
+        if (rsp == nullptr) {
+            return nullptr;
+        }
+        Txn *txn = (Txn *)rsp->req->meta;
+        delete rsp;
+        return txn;
+    }
+    void tick() override {
+        dram->tick();
+    }
+};
+
+// Every request takes the same number of cycles, any number in flight
+class FixedModel : public Model {
+    uint64_t latency;
+    uint64_t now = 0;
+    std::deque<std::pair<uint64_t, Txn *>> inflight[2];
+public:
+    FixedModel(uint64_t latency) : latency(latency) {}
+    bool will_accept(uint32_t addr, bool is_write) override {
+        return true;
+    }
+    void add(uint32_t addr, bool is_write, Txn *txn) override {
+        inflight[is_write].push_back({now + latency, txn});
+    }
+    Txn *response(bool is_write) override {
+        auto &q = inflight[is_write];
+        if (q.empty() || q.front().first > now) {
+            return nullptr;
+        }
+        Txn *txn = q.front().second;
+        q.pop_front();
+        return txn;
+    }
+    void tick() override {
+        now++;
+    }
+};
+
+struct ReplayArgs {
+    const char *trace = nullptr;
+    const char *model = "dramsim3";
+    const char *config = DRAMSIM3_CONFIG;
+    const char *outdir = ".";
+    bool open_loop = false;
+    uint64_t bytes = 64;        // per transaction, the DRAMsim3 burst
+    uint64_t freq_mhz = 0;      // 0 for bandwidth in bytes/cycle only
+};
+
+static std::vector<Txn> read_trace(const char *path) {
+    FILE *fp = fopen(path, "rb");
+    if (fp == nullptr) {
+        printf("[Error] Cannot open %s\n", path);
+        exit(1);
+    }
+    MemTraceHeader header;
+    if (fread(&header, sizeof(header), 1, fp) != 1 ||
+        header.magic != MEMTRACE_MAGIC || header.version != MEMTRACE_VERSION) {
+        printf("[Error] %s is not a memory trace\n", path);
+        exit(1);
+    }
+    std::vector<Txn> txns;
+    MemTraceRecord rec;
+    while (fread(&rec, sizeof(rec), 1, fp) == 1) {
+        txns.push_back({rec, 0, 0, 0, false});
+    }
+    fclose(fp);
+
+    // recorded in completion order, replayed in issue order
+    std::stable_sort(txns.begin(), txns.end(), [](const Txn &a, const Txn &b) {
+        return a.rec.cycle < b.rec.cycle;
+    });
+    return txns;
+}
+
+static uint64_t replay(Model *model, std::vector<Txn> &txns, bool open_loop) {
+    std::vector<Txn *> queue[2];
+    for (auto &txn : txns) {
+        queue[txn.rec.is_write].push_back(&txn);
+    }
+
+    size_t head[2] = {0, 0};
+    uint64_t ready[2] = {0, 0};
+    Txn *last[2] = {nullptr, nullptr};
+    // closed loop: the previous read of each AXI id, or the previous write
+    std::vector<Txn *> prev_of[2] = {std::vector<Txn *>(256, nullptr), std::vector<Txn *>(1, nullptr)};
+    size_t done = 0;
+    uint64_t cycle = 0;
+
+    for (; done < txns.size(); cycle++) {
+        for (int w = 0; w < 2; w++) {
+            while (Txn *txn = model->response(w)) {
+                txn->done = cycle;
+                txn->finished = true;
+                done++;
+            }
+
+            if (head[w] == queue[w].size()) {
+                continue;
+            }
+            Txn *txn = queue[w][head[w]];
+            Txn *&prev = prev_of[w][w ? 0 : txn->rec.id];
+            if (open_loop) {
+                ready[w] = txn->rec.cycle;
+            }
+            else if (prev && !prev->finished) {
+                continue;
+            }
+            else if (prev) {
+                // keep the core's think time after the previous response
+                uint64_t prev_done = prev->rec.cycle + prev->rec.latency;
+                uint64_t think = txn->rec.cycle > prev_done ? txn->rec.cycle - prev_done : 0;
+                ready[w] = prev->done + think;
+            }
+            else if (last[w]) {
+                // first on its id, keep the distance to the request before
+                ready[w] = last[w]->issue + (txn->rec.cycle - last[w]->rec.cycle);
+            }
+            else {
+                ready[w] = txn->rec.cycle;
+            }
+
+            if (cycle < ready[w]) {
+                continue;
+            }
+            txn->issue = ready[w];
+            if (model->will_accept(txn->rec.addr, w)) {
+                txn->accept = cycle;
+                model->add(txn->rec.addr, w, txn);
+                prev = txn;
+                last[w] = txn;
+                head[w]++;
+            }
+        }
+        model->tick();
+    }
+    return cycle;
+}
+
+static uint64_t percentile(std::vector<uint64_t> &v, double p) {
+    if (v.empty()) {
+        return 0;
+    }
+    size_t k = std::min(v.size() - 1, (size_t)(v.size() * p));
+    std::nth_element(v.begin(), v.begin() + k, v.end());
+    return v[k];
+}
+
+static void report(const ReplayArgs &args, std::vector<Txn> &txns, uint64_t cycles) {
+    static const char *dir[2] = {"read", "write"};
+    printf("%-6s %10s %10s %10s %8s %8s %8s %10s\n",
+        "", "reqs", "avg_lat", "avg_queue", "p50", "p99", "max", "trace_avg");
+    for (int w = 0; w < 2; w++) {
+        std::vector<uint64_t> lat;
+        uint64_t lat_tot = 0, queue_tot = 0, rec_tot = 0;
+        for (auto &txn : txns) {
+            if (txn.rec.is_write != w) {
+                continue;
+            }
+            lat.push_back(txn.done - txn.issue);
+            lat_tot += txn.done - txn.issue;
+            queue_tot += txn.accept - txn.issue;
+            rec_tot += txn.rec.latency;
+        }
+        size_t n = lat.size();
+        uint64_t max = n ? *std::max_element(lat.begin(), lat.end()) : 0;
+        printf("%-6s %10lu %10.2lf %10.2lf %8lu %8lu %8lu %10.2lf\n", dir[w], n,
+            n ? (double)lat_tot / n : 0.0, n ? (double)queue_tot / n : 0.0,
+            percentile(lat, 0.5), percentile(lat, 0.99), max, n ? (double)rec_tot / n : 0.0);
+    }
+
+    uint64_t trace_cycles = 0;
+    for (auto &txn : txns) {
+        trace_cycles = std::max(trace_cycles, txn.rec.cycle + txn.rec.latency);
+    }
+    double bpc = cycles ? (double)txns.size() * args.bytes / cycles : 0.0;
+    printf("cycles: %lu (trace %lu), bandwidth: %.3lf bytes/cycle", cycles, trace_cycles, bpc);
+    if (args.freq_mhz) {
+        printf(", %.3lf GB/s at %lu MHz", bpc * args.freq_mhz / 1000, args.freq_mhz);
+    }
+    printf("\n");
+}
+
+static ReplayArgs parse_args(int argc, char *argv[]) {
+    ReplayArgs args;
+    const struct option long_options[] = {
+        {"model", required_argument, NULL, 'm'},
+        {"config", required_argument, NULL, 'c'},
+        {"outdir", required_argument, NULL, 'o'},
+        {"open", no_argument, NULL, 'O'},
+        {"bytes", required_argument, NULL, 'b'},
+        {"freq", required_argument, NULL, 'f'},
+        {0, 0, NULL, 0}
+    };
+    int o;
+    while ((o = getopt_long(argc, argv, "-m:c:o:b:f:", long_options, NULL)) != -1) {
+        switch (o) {
+            case 'm':
+                args.model = optarg;
+                break;
+            case 'c':
+                args.config = optarg;
+                break;
+            case 'o':
+                args.outdir = optarg;
+                break;
+            case 'O':
+                args.open_loop = true;
+                break;
+            case 'b':
+                args.bytes = strtoull(optarg, NULL, 0);
+                break;
+            case 'f':
+                args.freq_mhz = strtoull(optarg, NULL, 0);
+                break;
+            case 1:
+                args.trace = optarg;
+                break;
+            default:
+                printf("Usage: %s [OPTION...] TRACE\n", argv[0]);
+                printf("\t-m <model>          dramsim3 (default) or fixed:<cycles>.\n");
+                printf("\t-c <ini>            DRAMsim3 config, %s by default.\n", DRAMSIM3_CONFIG);
+                printf("\t-o <dir>            DRAMsim3 output directory.\n");
+                printf("\t-b <bytes>          Bytes per transaction for bandwidth, 64 by default.\n");
+                printf("\t-f <mhz>            Also report bandwidth in GB/s at <mhz>.\n");
+                printf("\t--open              Issue every request at its recorded cycle.\n");
+                exit(0);
+        }
+    }
+    if (args.trace == nullptr) {
+        printf("[Error] No trace given\n");
+        exit(1);
+    }
+    return args;
+}
+
+int main(int argc, char *argv[]) {
+    ReplayArgs args = parse_args(argc, argv);
+    std::vector<Txn> txns = read_trace(args.trace);
+
+    Model *model;
+    if (strcmp(args.model, "dramsim3") == 0) {
+        model = new DramsimModel(args.config, args.outdir);
+    }
+    else if (strncmp(args.model, "fixed:", 6) == 0) {
+        model = new FixedModel(strtoull(args.model + 6, NULL, 0));
+    }
+    else {
+        printf("[Error] Unknown model %s\n", args.model);
+        return 1;
+    }
+
+    printf("[Info] Replay %lu transactions of %s on %s, %s loop\n", txns.size(), args.trace,
+        strcmp(args.model, "dramsim3") == 0 ? args.config : args.model,
+        args.open_loop ? "open" : "closed");
+    uint64_t cycles = replay(model, txns, args.open_loop);
+    report(args, txns, cycles);
+    delete model;
+    return 0;
+}
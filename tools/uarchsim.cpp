@@ -0,0 +1,842 @@
+// Trace-driven models of the branch predictor, ICache and DCache, run on a
+// commit stream recorded with --commit-trace. Each -c gives one configuration;
+// all of them replay the same trace on their own thread, so sizing sweeps take
+// seconds instead of one verilator build per point.
+//
+// The structures use the RTL indexing, tags, training and replacement: the
+// BTB, TAGE and RAS (frontend/bpu), the ICache main and next-line prefetch
+// pipes (frontend/icache) and the DCache hit/evict rules (memblock/dcache),
+// all with the tree PLRU of utils/Replacement.scala. What differs:
+//  - lookups and training happen in commit order, so wrong-path fetches,
+//    the train queue delay and RAS repair are not seen;
+//  - the BTB and TAGE index with the committed history, not the
+//    speculative ghr the BPU keeps at fetch;
+//  - the FTQ prefetcher and the DCache stride/stream prefetcher are not
+//    modelled, nor are MSHR merging and refill timing.
+// Counters differ from the RTL by these effects. Bubbles are estimated from
+// the miss and redirect counts with per-event penalties, taken from an RTL
+// run with --calib when available.
+
+#include "cmttrace.h"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <getopt.h>
+#include <map>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// erythrina/Parameters.scala and top/Top.scala
+#define FETCH_WIDTH     2
+#define CACHE_BASE      0x80000000u
+#define CACHE_END       0x88000000u
+
+static inline bool is_cacheable(uint32_t addr) {
+    return addr >= CACHE_BASE && addr < CACHE_END;
+}
+
+static inline int log2i(uint32_t x) {
+    return 31 - __builtin_clz(x);
+}
+
+/* ------------------------- PLRU ------------------------- */
+
+// utils/Replacement.scala: n - 1 state bits per set, the top bit says which
+// half holds the oldest way (1 for the right half, ways n/2 and up)
+struct PLRU {
+    int n;
+    std::vector<uint32_t> state;
+
+    void init(int sets, int ways) {
+        n = ways;
+        state.assign(sets, 0);
+    }
+
+    static uint32_t next_state(uint32_t st, uint32_t way, int n) {
+        if (n == 2) {
+            return !(way & 1);
+        }
+        int w = n / 2 - 1;
+        uint32_t mask = (1u << w) - 1;
+        bool touch_left = !((way >> (log2i(n) - 1)) & 1);
+        uint32_t left = (st >> w) & mask;
+        uint32_t right = st & mask;
+        uint32_t sub = way & (n / 2 - 1);
+        if (touch_left) {
+            left = next_state(left, sub, n / 2);
+        }
+        else {
+            right = next_state(right, sub, n / 2);
+        }
+        return (uint32_t)touch_left << (2 * w) | left << w | right;
+    }
+
+    static uint32_t oldest(uint32_t st, int n) {
+        if (n == 2) {
+            return st & 1;
+        }
+        int w = n / 2 - 1;
+        uint32_t mask = (1u << w) - 1;
+        uint32_t top = (st >> (2 * w)) & 1;
+        uint32_t sub = top ? (st & mask) : ((st >> w) & mask);
+        return top << log2i(n / 2) | oldest(sub, n / 2);
+    }
+
+    void touch(uint32_t set, uint32_t way) {
+        state[set] = next_state(state[set], way, n);
+    }
+
+    uint32_t victim(uint32_t set) {
+        return oldest(state[set], n);
+    }
+};
+
+/* ------------------------- Cache ------------------------- */
+
+struct CacheParams {
+    int sets = 256;
+    int ways = 4;
+    int line = 64;
+};
+
+struct CacheLine {
+    bool valid;
+    bool dirty;
+    bool pft;           // filled by the prefetcher and not used yet
+    uint32_t tag;
+};
+
+struct Cache {
+    CacheParams p;
+    std::vector<CacheLine> lines;
+    PLRU plru;
+
+    void init(const CacheParams &params) {
+        p = params;
+        lines.assign(p.sets * p.ways, CacheLine{});
+        plru.init(p.sets, p.ways);
+    }
+
+    uint32_t idx(uint32_t addr) {
+        return (addr >> log2i(p.line)) & (p.sets - 1);
+    }
+
+    uint32_t tag(uint32_t addr) {
+        return addr >> (log2i(p.line) + log2i(p.sets));
+    }
+
+    CacheLine *way(uint32_t set, uint32_t w) {
+        return &lines[set * p.ways + w];
+    }
+
+    // first matching way, as PriorityEncoder in the RTL
+    int lookup(uint32_t addr) {
+        uint32_t set = idx(addr), t = tag(addr);
+        for (int w = 0; w < p.ways; w++) {
+            CacheLine *l = way(set, w);
+            if (l->valid && l->tag == t) {
+                return w;
+            }
+        }
+        return -1;
+    }
+};
+
+/* ------------------------- BTB ------------------------- */
+
+// BrType in frontend/bpu/BTB.scala, from the RISC-V return address hints
+enum BrType { BR_COND, BR_JUMP, BR_CALL, BR_RET };
+
+static inline bool is_link(uint32_t r) {
+    return r == 1 || r == 5;
+}
+
+static BrType br_type(uint32_t inst) {
+    uint32_t opcode = inst & 0x7f;
+    uint32_t rd = (inst >> 7) & 0x1f;
+    uint32_t rs1 = (inst >> 15) & 0x1f;
+    bool is_jmp = opcode == 0x6f || opcode == 0x67;
+    if (is_jmp && is_link(rd)) return BR_CALL;
+    if (opcode == 0x67 && is_link(rs1)) return BR_RET;
+    if (is_jmp) return BR_JUMP;
+    return BR_COND;
+}
+
+struct BTBEntry {
+    bool valid;
+    BrType type;
+    uint32_t tag;
+    uint32_t target;
+};
+
+struct BTBRsp {
+    bool hit;
+    BrType type;
+    uint32_t target;
+};
+
+// frontend/bpu/BTB.scala: where the branches are, their type and target;
+// conditional directions come from the TAGE
+struct BTB {
+    int size;
+    bool use_ghr;
+    std::vector<BTBEntry> entries;
+
+    void init(int btb_size, bool ghr_enable) {
+        size = btb_size;
+        use_ghr = ghr_enable;
+        entries.assign(size, BTBEntry{});
+    }
+
+    uint32_t idx(uint32_t pc, uint32_t g) {
+        return ((use_ghr ? pc ^ g : pc) >> 2) & (size - 1);
+    }
+
+    uint32_t tag(uint32_t pc, uint32_t g) {
+        return (use_ghr ? pc ^ g : pc) >> (log2i(size) + 2);
+    }
+
+    BTBRsp lookup(uint32_t pc, uint32_t g) {
+        BTBEntry *e = &entries[idx(pc, g)];
+        BTBRsp rsp;
+        rsp.hit = e->valid && e->tag == tag(pc, g);
+        rsp.type = e->type;
+        rsp.target = e->target;
+        return rsp;
+    }
+
+    // one BPUTrainInfo out of the train queue; a branch allocated while
+    // not taken learns its target once it is taken
+    void train(bool hit, uint32_t pc, uint32_t target, bool taken, BrType type, uint32_t g) {
+        BTBEntry *e = &entries[idx(pc, g)];
+        if (!hit || taken) {
+            e->target = target;
+        }
+        if (!hit) {
+            e->tag = tag(pc, g);
+            e->type = type;
+            e->valid = true;
+        }
+    }
+};
+
+/* ------------------------- TAGE ------------------------- */
+
+struct TageEntry {
+    bool valid;
+    uint32_t tag;
+    uint8_t ctr;        // 3 bits, taken from 4
+    uint8_t u;          // 2 bits
+};
+
+// frontend/bpu/Tage.scala, with the default BPUParmams tables
+struct Tage {
+    static const int TAG_BITS = 8;
+    struct Table { int size; int len; std::vector<TageEntry> e; };
+
+    std::vector<uint8_t> base;      // 2 bits, taken from 2
+    std::vector<Table> tables;
+
+    uint64_t alloc_fail = 0;
+
+    void init(int base_size) {
+        base.assign(base_size, 1);
+        tables.clear();
+        for (auto t : {std::make_pair(128, 8), std::make_pair(128, 16), std::make_pair(128, 32)}) {
+            tables.push_back(Table{t.first, t.second, std::vector<TageEntry>(t.first, TageEntry{})});
+        }
+    }
+
+    // xor the newest len bits of history down to width bits
+    static uint32_t fold(uint32_t hist, int len, int width) {
+        uint32_t res = 0;
+        for (int i = 0; i < len; i += width) {
+            int hi = std::min(i + width, len);
+            res ^= (uint32_t)(((uint64_t)hist >> i) & ((1ull << (hi - i)) - 1));
+        }
+        return res;
+    }
+
+    uint32_t idx(int t, uint32_t pc, uint32_t g) {
+        int w = log2i(tables[t].size);
+        return ((pc >> 2) ^ fold(g, tables[t].len, w)) & (tables[t].size - 1);
+    }
+
+    uint32_t tag(int t, uint32_t pc, uint32_t g) {
+        int w = log2i(tables[t].size);
+        int len = tables[t].len;
+        return ((pc >> (w + 2)) ^ fold(g, len, TAG_BITS) ^ (fold(g, len, TAG_BITS - 1) << 1)) & ((1u << TAG_BITS) - 1);
+    }
+
+    // the longest matching table provides, the next one is the alternate
+    struct Lookup {
+        int provider = -1;
+        int alt = -1;
+        bool base_taken;
+        bool taken;
+        bool alt_taken;
+    };
+
+    Lookup lookup(uint32_t pc, uint32_t g) {
+        Lookup l;
+        l.base_taken = base[(pc >> 2) & (base.size() - 1)] >> 1;
+        for (int t = 0; t < (int)tables.size(); t++) {
+            TageEntry *e = &tables[t].e[idx(t, pc, g)];
+            if (e->valid && e->tag == tag(t, pc, g)) {
+                l.alt = l.provider;
+                l.provider = t;
+            }
+        }
+        l.alt_taken = l.alt >= 0 ? tables[l.alt].e[idx(l.alt, pc, g)].ctr >> 2 : l.base_taken;
+        l.taken = l.provider >= 0 ? tables[l.provider].e[idx(l.provider, pc, g)].ctr >> 2 : l.base_taken;
+        return l;
+    }
+
+    bool predict(uint32_t pc, uint32_t g) {
+        return lookup(pc, g).taken;
+    }
+
+    void update(uint32_t pc, uint32_t g, bool taken) {
+        Lookup l = lookup(pc, g);
+        auto sat = [](uint8_t &c, bool up, int max) { c = up ? std::min(c + 1, max) : std::max(c - 1, 0); };
+
+        if (l.provider >= 0) {
+            TageEntry *e = &tables[l.provider].e[idx(l.provider, pc, g)];
+            bool provider_taken = e->ctr >> 2;
+            sat(e->ctr, taken, 7);
+            if (provider_taken != l.alt_taken) {
+                sat(e->u, provider_taken == taken, 3);
+            }
+        }
+        else {
+            sat(base[(pc >> 2) & (base.size() - 1)], taken, 3);
+        }
+
+        // allocate in the shortest longer table with a useless entry
+        if (l.taken == taken || l.provider == (int)tables.size() - 1) {
+            return;
+        }
+        for (int t = l.provider + 1; t < (int)tables.size(); t++) {
+            TageEntry *e = &tables[t].e[idx(t, pc, g)];
+            if (e->u == 0) {
+                *e = TageEntry{true, tag(t, pc, g), (uint8_t)(taken ? 4 : 3), 0};
+                return;
+            }
+        }
+        alloc_fail++;
+        for (int t = l.provider + 1; t < (int)tables.size(); t++) {
+            TageEntry *e = &tables[t].e[idx(t, pc, g)];
+            sat(e->u, false, 3);
+        }
+    }
+};
+
+/* ------------------------- RAS ------------------------- */
+
+// frontend/bpu/RAS.scala, circular; in commit order the speculative stack
+// is the committed one
+struct RAS {
+    std::vector<uint32_t> stack;
+    uint32_t sp = 0;
+
+    void init(int size) {
+        stack.assign(std::max(size, 1), 0);
+        sp = 0;
+    }
+
+    uint32_t top() {
+        return stack[sp];
+    }
+
+    void commit(BrType type, uint32_t pc) {
+        uint32_t mask = stack.size() - 1;
+        if (type == BR_CALL) {
+            sp = (sp + 1) & mask;
+            stack[sp] = pc + 4;
+        }
+        else if (type == BR_RET) {
+            sp = (sp - 1) & mask;
+        }
+    }
+};
+
+/* ------------------------- Config ------------------------- */
+
+struct SimConfig {
+    std::string name = "default";
+    int btb_size = 64;
+    bool use_ghr = false;
+    int tage_base = 512;
+    int ras_size = 16;          // 0 for no RAS
+    CacheParams icache;
+    bool ic_pft = true;
+    CacheParams dcache;
+};
+
+struct SimStats {
+    uint64_t insts = 0;
+    uint64_t brus = 0;
+    uint64_t bpu_wrong_exu = 0;
+    uint64_t bpu_wrong_br = 0;
+    uint64_t bpu_wrong_jal = 0;
+    uint64_t bpu_wrong_ret = 0;
+    uint64_t bpu_wrong_idu = 0;
+    uint64_t btb_replace = 0;
+    uint64_t tage_alloc_fail = 0;
+    uint64_t icache_hit = 0;
+    uint64_t icache_miss = 0;
+    uint64_t icache_nc = 0;
+    uint64_t icache_pft = 0;        // lines filled by the prefetcher
+    uint64_t icache_pft_used = 0;
+    uint64_t dcache_hit = 0;
+    uint64_t dcache_miss = 0;
+    uint64_t dcache_mmio = 0;
+    uint64_t dcache_wb = 0;
+};
+
+// Average cost of each event, in cycles
+struct Penalty {
+    double icache_miss = 20;
+    double dcache_miss = 20;
+    double redirect = 4;
+    double idu_redirect = 2;
+};
+
+static bool parse_config(const char *spec, SimConfig *cfg) {
+    cfg->name = spec;
+    std::string s = spec;
+    size_t pos = 0;
+    while (pos < s.size()) {
+        size_t end = s.find(',', pos);
+        if (end == std::string::npos) {
+            end = s.size();
+        }
+        std::string kv = s.substr(pos, end - pos);
+        pos = end + 1;
+        size_t eq = kv.find('=');
+        if (eq == std::string::npos) {
+            return false;
+        }
+        std::string key = kv.substr(0, eq);
+        int val = strtol(kv.c_str() + eq + 1, NULL, 0);
+        if (key == "btb") cfg->btb_size = val;
+        else if (key == "ghr") cfg->use_ghr = val;
+        else if (key == "tage_base") cfg->tage_base = val;
+        else if (key == "ras") cfg->ras_size = val;
+        else if (key == "ic_sets") cfg->icache.sets = val;
+        else if (key == "ic_ways") cfg->icache.ways = val;
+        else if (key == "ic_line") cfg->icache.line = val;
+        else if (key == "ic_pft") cfg->ic_pft = val;
+        else if (key == "dc_sets") cfg->dcache.sets = val;
+        else if (key == "dc_ways") cfg->dcache.ways = val;
+        else if (key == "dc_line") cfg->dcache.line = val;
+        else return false;
+    }
+
+    auto pow2 = [](int x, int min) { return x >= min && (x & (x - 1)) == 0; };
+    return pow2(cfg->btb_size, 1) && pow2(cfg->tage_base, 1) && (cfg->ras_size == 0 || pow2(cfg->ras_size, 2)) &&
+        pow2(cfg->icache.sets, 1) && pow2(cfg->icache.ways, 2) && pow2(cfg->icache.line, 8) &&
+        pow2(cfg->dcache.sets, 1) && pow2(cfg->dcache.ways, 2) && pow2(cfg->dcache.line, 8);
+}
+
+/* ------------------------- Models ------------------------- */
+
+class Simulator {
+    const SimConfig &cfg;
+    BTB btb;
+    Tage tage;
+    RAS ras;
+    uint32_t ghr = 0;   // conditional branch history, as arch_ghr in the BPU
+    Cache ic;
+    Cache dc;
+
+public:
+    SimStats st;
+
+    Simulator(const SimConfig &cfg) : cfg(cfg) {
+        btb.init(cfg.btb_size, cfg.use_ghr);
+        tage.init(cfg.tage_base);
+        ras.init(cfg.ras_size);
+        ic.init(cfg.icache);
+        dc.init(cfg.dcache);
+    }
+
+    // Fetcher refill: the oldest way, which then becomes the newest
+    int ic_fill(uint32_t addr, bool pft) {
+        uint32_t set = ic.idx(addr);
+        uint32_t w = ic.plru.victim(set);
+        *ic.way(set, w) = CacheLine{true, false, pft, ic.tag(addr)};
+        ic.plru.touch(set, w);
+        return w;
+    }
+
+    // MainPipe, one access per fetch block
+    void fetch(uint32_t addr) {
+        if (!is_cacheable(addr)) {
+            st.icache_nc++;
+            return;
+        }
+        int w = ic.lookup(addr);
+        if (w >= 0) {
+            st.icache_hit++;
+            CacheLine *l = ic.way(ic.idx(addr), w);
+            if (l->pft) {
+                st.icache_pft_used++;
+                l->pft = false;
+            }
+            ic.plru.touch(ic.idx(addr), w);
+            return;
+        }
+        st.icache_miss++;
+        ic_fill(addr, false);
+
+        // NxtPrefetcher, checked by PrefetchPipe without touching the PLRU
+        uint32_t next = (addr & ~(uint32_t)(ic.p.line - 1)) + ic.p.line;
+        if (cfg.ic_pft && is_cacheable(next) && ic.lookup(next) < 0) {
+            st.icache_pft++;
+            ic_fill(next, true);
+        }
+    }
+
+    // SimpleDCache Stage2/Stage3. A miss takes an MSHR and the refill is
+    // installed dirty when a store merged into it (install_meta.dirty, the
+    // OR of its st_mask); with one access at a time only the missing
+    // access itself can be that store.
+    void mem_access(uint32_t addr, bool is_write) {
+        if (!is_cacheable(addr)) {
+            st.dcache_mmio++;
+            return;
+        }
+        uint32_t set = dc.idx(addr);
+        int w = dc.lookup(addr);
+        if (w >= 0) {
+            st.dcache_hit++;
+            dc.plru.touch(set, w);
+            if (is_write) {
+                dc.way(set, w)->dirty = true;
+            }
+            return;
+        }
+        st.dcache_miss++;
+        uint32_t victim = dc.plru.victim(set);
+        CacheLine *l = dc.way(set, victim);
+        if (l->valid && l->dirty) {
+            st.dcache_wb++;
+        }
+        dc.plru.touch(set, victim);
+        *l = CacheLine{true, is_write, false, dc.tag(addr)};
+    }
+
+    // BPU lookup at fetch, IDU check at decode, EXU check and ROB training
+    // at commit, all against the committed next pc
+    void branch(uint32_t pc, uint32_t inst, uint32_t npc) {
+        uint32_t opcode = inst & 0x7f;
+        bool is_br = opcode == 0x63;
+        bool is_jal = opcode == 0x6f;
+        bool is_jalr = opcode == 0x67;
+        if (!(is_br || is_jal || is_jalr)) {
+            return;
+        }
+        st.brus++;
+        BrType type = br_type(inst);
+        BTBRsp rsp = btb.lookup(pc, ghr);
+
+        // jumps are always taken, conditional branches as the TAGE says,
+        // returns go to the RAS top
+        bool pred_taken = rsp.hit && (rsp.type != BR_COND || tage.predict(pc, ghr));
+        uint32_t pred_target = rsp.type == BR_RET && cfg.ras_size ? ras.top() : rsp.target;
+        bool taken = !is_br || npc != pc + 4;
+        uint32_t pred_npc = pred_taken ? pred_target : pc + 4;
+
+        // Decoder: jal and jalr with rs1 = x0 have a known target
+        uint32_t rs1 = (inst >> 15) & 0x1f;
+        if (is_jal || (is_jalr && rs1 == 0)) {
+            uint32_t target = npc;
+            if (!pred_taken || pred_target != target) {
+                st.bpu_wrong_idu++;
+                st.btb_replace += !rsp.hit;
+                btb.train(rsp.hit, pc, target, true, type, ghr);
+            }
+        }
+
+        if (pred_npc != npc) {
+            st.bpu_wrong_exu++;
+            if (is_br) {
+                st.bpu_wrong_br++;
+            }
+            else {
+                st.bpu_wrong_jal++;
+            }
+            st.bpu_wrong_ret += type == BR_RET;
+        }
+        st.btb_replace += !rsp.hit;
+        btb.train(rsp.hit, pc, npc, taken, type, ghr);
+        if (type == BR_COND) {
+            tage.update(pc, ghr, taken);
+            ghr = ghr << 1 | taken;
+        }
+        if (cfg.ras_size) {
+            ras.commit(type, pc);
+        }
+        st.tage_alloc_fail = tage.alloc_fail;
+    }
+
+    void run(const CmtTraceRecord *recs, size_t n) {
+        uint32_t blk_line = 0;
+        int blk_num = 0;
+        bool blk_end = true;
+        int ic_shift = log2i(cfg.icache.line);
+
+        for (size_t i = 0; i < n; i++) {
+            const CmtTraceRecord *r = &recs[i];
+            uint32_t npc = i + 1 < n ? recs[i + 1].pc : r->pc + 4;
+            st.insts++;
+
+            // fetch blocks: FetchWidth instructions in one line, cut at taken
+            if (blk_end || blk_num == FETCH_WIDTH || (r->pc >> ic_shift) != blk_line) {
+                fetch(r->pc);
+                blk_line = r->pc >> ic_shift;
+                blk_num = 0;
+            }
+            blk_num++;
+            blk_end = npc != r->pc + 4;
+
+            if (i + 1 < n) {
+                branch(r->pc, r->inst, npc);
+            }
+
+            uint32_t opcode = r->inst & 0x7f;
+            if (opcode == 0x03 || opcode == 0x23) {
+                mem_access(r->addr, opcode == 0x23);
+            }
+        }
+    }
+};
+
+/* ------------------------- Report ------------------------- */
+
+typedef std::map<std::string, uint64_t> PerfMap;
+
+// "name: value" lines of the PerfBox dump, see scripts/topdown.py
+static PerfMap read_perf(const char *path) {
+    PerfMap perf;
+    FILE *fp = fopen(path, "r");
+    if (fp == nullptr) {
+        printf("[Error] Cannot open %s\n", path);
+        exit(1);
+    }
+    char line[256], name[128];
+    unsigned long val;
+    while (fgets(line, sizeof(line), fp)) {
+        if (sscanf(line, "%127[A-Za-z0-9_]: %lu", name, &val) == 2) {
+            perf[name] = val;
+        }
+    }
+    fclose(fp);
+    return perf;
+}
+
+static void calibrate(const PerfMap &perf, Penalty *pen) {
+    auto get = [&](const char *name) -> double {
+        auto it = perf.find(name);
+        return it == perf.end() ? 0 : it->second;
+    };
+    if (get("icache_miss")) {
+        pen->icache_miss = get("icache_miss_penalty_tot") / get("icache_miss");
+    }
+    if (get("dcache_miss")) {
+        pen->dcache_miss = get("dcache_miss_penalty_tot") / get("dcache_miss");
+    }
+    double redirects = get("redirect_mispred") + get("redirect_store2load") + get("redirect_ret") + get("bpu_wrong_idu");
+    if (redirects) {
+        pen->redirect = get("topdown_RedirectResteerBubbles") / FETCH_WIDTH / redirects;
+    }
+}
+
+static double ratio(uint64_t a, uint64_t b) {
+    return b ? (double)a / b : 0.0;
+}
+
+static void print_header() {
+    printf("%-36s %10s %9s %9s %9s %10s %9s %9s %12s %12s %12s\n", "config",
+        "brus", "wrong_exu", "wrong_idu", "mispred%", "ic_access", "ic_hit%", "dc_hit%",
+        "fetch_bub", "resteer_bub", "dc_stall");
+}
+
+static void print_row(const char *name, const SimStats &st, const Penalty &pen) {
+    uint64_t ic_access = st.icache_hit + st.icache_miss;
+    uint64_t dc_access = st.dcache_hit + st.dcache_miss;
+    double fetch_bub = st.icache_miss * pen.icache_miss * FETCH_WIDTH;
+    double resteer_bub = (st.bpu_wrong_exu * pen.redirect + st.bpu_wrong_idu * pen.idu_redirect) * FETCH_WIDTH;
+    double dc_stall = st.dcache_miss * pen.dcache_miss;
+    printf("%-36s %10lu %9lu %9lu %9.3lf %10lu %9.3lf %9.3lf %12.0lf %12.0lf %12.0lf\n", name,
+        st.brus, st.bpu_wrong_exu, st.bpu_wrong_idu, 100 * ratio(st.bpu_wrong_exu, st.brus),
+        ic_access, 100 * ratio(st.icache_hit, ic_access), 100 * ratio(st.dcache_hit, dc_access),
+        fetch_bub, resteer_bub, dc_stall);
+}
+
+static void print_detail(const SimConfig &cfg, const SimStats &st) {
+    printf("%s: btb_replace %lu, wrong_br %lu, wrong_jal %lu, wrong_ret %lu, tage_alloc_fail %lu, ic_miss %lu, ic_nc %lu, "
+        "ic_pft %lu (used %lu), dc_miss %lu, dc_mmio %lu, dc_wb %lu\n",
+        cfg.name.c_str(), st.btb_replace, st.bpu_wrong_br, st.bpu_wrong_jal, st.bpu_wrong_ret, st.tage_alloc_fail,
+        st.icache_miss, st.icache_nc, st.icache_pft, st.icache_pft_used,
+        st.dcache_miss, st.dcache_mmio, st.dcache_wb);
+}
+
+// RTL counters of the run the trace came from, same columns
+static SimStats perf_stats(const PerfMap &perf) {
+    auto get = [&](const char *name) -> uint64_t {
+        auto it = perf.find(name);
+        return it == perf.end() ? 0 : it->second;
+    };
+    SimStats st;
+    st.brus = get("bpu_correct_exu") + get("bpu_wrong_exu");
+    st.bpu_wrong_exu = get("bpu_wrong_exu");
+    st.bpu_wrong_br = get("bpu_wrong_br");
+    st.bpu_wrong_jal = get("bpu_wrong_jal");
+    st.bpu_wrong_ret = get("bpu_wrong_ret");
+    st.tage_alloc_fail = get("bpu_tage_alloc_fail");
+    st.bpu_wrong_idu = get("bpu_wrong_idu");
+    st.icache_hit = get("icache_hit");
+    st.icache_miss = get("icache_miss");
+    st.icache_nc = get("icache_nc");
+    st.dcache_hit = get("dcache_hit");
+    st.dcache_miss = get("dcache_miss");
+    st.dcache_mmio = get("dcache_mmio");
+    return st;
+}
+
+/* ------------------------- Main ------------------------- */
+
+static const CmtTraceRecord *map_trace(const char *path, size_t *n) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        printf("[Error] Cannot open %s\n", path);
+        exit(1);
+    }
+    struct stat sb;
+    fstat(fd, &sb);
+    if ((size_t)sb.st_size < sizeof(CmtTraceHeader)) {
+        printf("[Error] %s is not a commit trace\n", path);
+        exit(1);
+    }
+    void *p = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    assert(p != MAP_FAILED);
+    close(fd);
+
+    const CmtTraceHeader *header = (const CmtTraceHeader *)p;
+    if (header->magic != CMTTRACE_MAGIC || header->version != CMTTRACE_VERSION) {
+        printf("[Error] %s is not a commit trace\n", path);
+        exit(1);
+    }
+    *n = (sb.st_size - sizeof(CmtTraceHeader)) / sizeof(CmtTraceRecord);
+    return (const CmtTraceRecord *)(header + 1);
+}
+
+int main(int argc, char *argv[]) {
+    std::vector<SimConfig> cfgs;
+    const char *trace = nullptr;
+    const char *calib = nullptr;
+    int jobs = std::thread::hardware_concurrency();
+    bool detail = false;
+
+    const struct option long_options[] = {
+        {"config", required_argument, NULL, 'c'},
+        {"calib", required_argument, NULL, 'r'},
+        {"jobs", required_argument, NULL, 'j'},
+        {"detail", no_argument, NULL, 'v'},
+        {0, 0, NULL, 0}
+    };
+    int o;
+    while ((o = getopt_long(argc, argv, "-c:r:j:v", long_options, NULL)) != -1) {
+        switch (o) {
+            case 'c': {
+                SimConfig cfg;
+                if (!parse_config(optarg, &cfg)) {
+                    printf("[Error] Bad config %s\n", optarg);
+                    return 1;
+                }
+                cfgs.push_back(cfg);
+                break;
+            }
+            case 'r':
+                calib = optarg;
+                break;
+            case 'j':
+                jobs = strtol(optarg, NULL, 0);
+                break;
+            case 'v':
+                detail = true;
+                break;
+            case 1:
+                trace = optarg;
+                break;
+            default:
+                printf("Usage: %s [OPTION...] TRACE\n", argv[0]);
+                printf("\t-c <k=v,...>         Add a config, keys btb ghr tage_base ras ic_sets ic_ways ic_line\n");
+                printf("\t                     ic_pft dc_sets dc_ways dc_line, RTL defaults for the rest.\n");
+                printf("\t-r <stderr.log>      Take penalties from an RTL run and print its counters.\n");
+                printf("\t-j <jobs>            Run configs on <jobs> threads.\n");
+                printf("\t-v                   Print every counter of each config.\n");
+                return 0;
+        }
+    }
+    if (trace == nullptr) {
+        printf("[Error] No trace given\n");
+        return 1;
+    }
+    if (cfgs.empty()) {
+        cfgs.push_back(SimConfig());
+    }
+
+    size_t n;
+    const CmtTraceRecord *recs = map_trace(trace, &n);
+
+    Penalty pen;
+    PerfMap perf;
+    if (calib) {
+        perf = read_perf(calib);
+        calibrate(perf, &pen);
+    }
+    printf("[Info] %lu instrs, %lu configs, penalty: icache %.1lf, dcache %.1lf, redirect %.1lf cycles\n",
+        n, cfgs.size(), pen.icache_miss, pen.dcache_miss, pen.redirect);
+
+    std::vector<SimStats> stats(cfgs.size());
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> workers;
+    for (int j = 0; j < std::max(1, std::min<int>(jobs, cfgs.size())); j++) {
+        workers.emplace_back([&] {
+            size_t i;
+            while ((i = next++) < cfgs.size()) {
+                Simulator sim(cfgs[i]);
+                sim.run(recs, n);
+                stats[i] = sim.st;
+            }
+        });
+    }
+    for (auto &w : workers) {
+        w.join();
+    }
+
+    print_header();
+    if (calib) {
+        print_row("rtl", perf_stats(perf), pen);
+    }
+    for (size_t i = 0; i < cfgs.size(); i++) {
+        print_row(cfgs[i].name.c_str(), stats[i], pen);
+    }
+    if (detail) {
+        for (size_t i = 0; i < cfgs.size(); i++) {
+            print_detail(cfgs[i], stats[i]);
+        }
+    }
+    return 0;
+}